@@ -21,6 +21,7 @@
  * details.
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include <fstream>
@@ -69,6 +70,12 @@ public:
     gen_no_skeleton_ = false;
     gen_no_constructors_ = false;
     gen_private_optional_ = false;
+    gen_string_views_ = false;
+    gen_field_masks_ = false;
+    gen_reuse_objects_ = false;
+    gen_pmr_ = false;
+    gen_serialized_size_ = false;
+    string_view_struct_ = nullptr;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -98,11 +105,30 @@ public:
         gen_no_constructors_ = true;
       } else if ( iter->first.compare("private_optional") == 0) {
         gen_private_optional_ = true;
+      } else if ( iter->first.compare("string_views") == 0) {
+        gen_string_views_ = true;
+      } else if ( iter->first.compare("field_masks") == 0) {
+        gen_field_masks_ = true;
+      } else if ( iter->first.compare("reuse_objects") == 0) {
+        gen_reuse_objects_ = true;
+      } else if ( iter->first.compare("pmr") == 0) {
+        gen_pmr_ = true;
+      } else if ( iter->first.compare("serialized_size") == 0) {
+        gen_serialized_size_ = true;
+      } else if ( iter->first.compare("containers") == 0) {
+        gen_containers_ = iter->second;
+        if (gen_containers_ != "flat" && gen_containers_ != "unordered") {
+          throw "cpp:containers must be 'flat' or 'unordered'";
+        }
       } else {
         throw "unknown option cpp:" + iter->first;
       }
     }
 
+    if (gen_pmr_ && gen_reuse_objects_) {
+      throw "cpp:pmr and cpp:reuse_objects cannot be combined";
+    }
+
     out_dir_base_ = "gen-cpp";
   }
 
@@ -156,6 +182,8 @@ public:
   void generate_copy_constructor(std::ostream& out, t_struct* tstruct, bool is_exception);
   void generate_move_constructor(std::ostream& out, t_struct* tstruct, bool is_exception);
   void generate_default_constructor(std::ostream& out, t_struct* tstruct, bool is_exception);
+  void generate_struct_clear(std::ostream& out, t_struct* tstruct);
+  void generate_allocator_constructors(std::ostream& out, t_struct* tstruct);
   void generate_constructor_helper(std::ostream& out,
                                    t_struct* tstruct,
                                    bool is_excpetion,
@@ -164,7 +192,10 @@ public:
   void generate_equality_operator(std::ostream& out, t_struct* tstruct);
   void generate_move_assignment_operator(std::ostream& out, t_struct* tstruct);
   void generate_assignment_helper(std::ostream& out, t_struct* tstruct, bool is_move);
-  void generate_struct_reader(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_struct_reader(std::ostream& out,
+                              t_struct* tstruct,
+                              bool pointers = false,
+                              bool masked = false);
   void generate_struct_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
@@ -235,6 +266,10 @@ public:
 
   void generate_serialize_list_element(std::ostream& out, t_list* tlist, std::string iter);
 
+  void generate_struct_serialized_size(std::ostream& out, t_struct* tstruct, bool result = false);
+  void generate_serialized_size_field(std::ostream& out, t_field* tfield, std::string prefix);
+  void generate_serialized_size_container(std::ostream& out, t_type* ttype, std::string prefix);
+
   void generate_function_call(ostream& out,
                               t_function* tfunction,
                               string target,
@@ -279,6 +314,215 @@ public:
 
   bool is_reference(t_field* tfield) { return tfield->get_reference(); }
 
+  /**
+   * Structs whose string and binary fields are generated as std::string_view,
+   * either because of the "string_views" option or the "cpp.string_views"
+   * struct annotation.  Such structs are read-only views into the buffer
+   * they were deserialized from.
+   */
+  bool is_string_view_struct(t_struct* tstruct) const {
+    return gen_string_views_
+           || (tstruct->annotations_.find("cpp.string_views") != tstruct->annotations_.end());
+  }
+
+  /**
+   * True if tfield is a struct or exception member annotated with
+   * (cpp.lazy), which is held in a TLazyField and only decoded on access.
+   */
+  bool is_lazy_field(t_field* tfield) {
+    if (is_reference(tfield)
+        || tfield->annotations_.find("cpp.lazy") == tfield->annotations_.end()) {
+      return false;
+    }
+    t_type* ttype = get_true_type(tfield->get_type());
+    return ttype->is_struct() || ttype->is_xception();
+  }
+
+  /**
+   * True if tfield is a plain string or binary member of the string_view
+   * struct currently being generated.  Container elements keep owning
+   * std::string storage.
+   */
+  bool is_string_view_field(t_field* tfield) {
+    if (string_view_struct_ == nullptr || is_reference(tfield)) {
+      return false;
+    }
+    const vector<t_field*>& members = string_view_struct_->get_members();
+    if (std::find(members.begin(), members.end(), tfield) == members.end()) {
+      return false;
+    }
+    t_type* ttype = tfield->get_type();
+    if (ttype->annotations_.find("cpp.type") != ttype->annotations_.end()) {
+      return false;
+    }
+    ttype = get_true_type(ttype);
+    return ttype->is_base_type()
+           && ((t_base_type*)ttype)->get_base() == t_base_type::TYPE_STRING;
+  }
+
+  /**
+   * Namespace of the standard containers generated for thrift containers.
+   */
+  std::string container_prefix() const { return gen_pmr_ ? "std::pmr::" : "std::"; }
+
+  /**
+   * Kind of container generated for a map or set type: "flat", "unordered"
+   * or empty for std::map/std::set.  The cpp.containers annotation ("flat",
+   * "unordered" or "ordered") overrides the containers option.  Unordered
+   * containers need a hashable key, other keys stay ordered.
+   */
+  std::string container_kind(t_type* ttype) {
+    if (!ttype->is_map() && !ttype->is_set()) {
+      return "";
+    }
+    std::string kind = gen_containers_;
+    std::map<string, std::vector<string>>::iterator it = ttype->annotations_.find("cpp.containers");
+    if (it != ttype->annotations_.end() && !it->second.empty()) {
+      kind = it->second.back();
+      if (kind == "ordered") {
+        kind = "";
+      } else if (kind != "flat" && kind != "unordered") {
+        throw "cpp.containers must be 'flat', 'unordered' or 'ordered', not '" + kind + "'";
+      }
+    }
+    if (kind == "unordered") {
+      if (container_keys_.count(ttype) != 0) {
+        return "";
+      }
+      t_type* key = ttype->is_map() ? ((t_map*)ttype)->get_key_type()
+                                    : ((t_set*)ttype)->get_elem_type();
+      if (key->annotations_.find("cpp.type") != key->annotations_.end()) {
+        return "";
+      }
+      key = get_true_type(key);
+      if (!key->is_enum() && (!key->is_base_type() || key->is_uuid()
+                              || key->annotations_.find("cpp.type") != key->annotations_.end())) {
+        return "";
+      }
+    }
+    return kind;
+  }
+
+  /**
+   * Records the containers used as map keys or set elements, which are
+   * compared with operator< and so are never generated unordered.
+   */
+  void collect_container_keys(t_type* ttype, bool is_key) {
+    if (is_key) {
+      container_keys_.insert(ttype);
+      container_keys_.insert(get_true_type(ttype));
+    }
+    if (ttype->is_typedef()) {
+      collect_container_keys(((t_typedef*)ttype)->get_type(), is_key);
+    } else if (ttype->is_map()) {
+      collect_container_keys(((t_map*)ttype)->get_key_type(), true);
+      collect_container_keys(((t_map*)ttype)->get_val_type(), is_key);
+    } else if (ttype->is_set()) {
+      collect_container_keys(((t_set*)ttype)->get_elem_type(), true);
+    } else if (ttype->is_list()) {
+      collect_container_keys(((t_list*)ttype)->get_elem_type(), is_key);
+    }
+  }
+
+  /**
+   * True if any type of the program is generated as a TFlatMap, TFlatSet or
+   * unordered container.
+   */
+  bool uses_container_kinds(t_type* ttype) {
+    if (ttype->is_typedef()) {
+      return uses_container_kinds(((t_typedef*)ttype)->get_type());
+    }
+    if (ttype->is_map()) {
+      return !container_kind(ttype).empty() || uses_container_kinds(((t_map*)ttype)->get_key_type())
+             || uses_container_kinds(((t_map*)ttype)->get_val_type());
+    }
+    if (ttype->is_set()) {
+      return !container_kind(ttype).empty() || uses_container_kinds(((t_set*)ttype)->get_elem_type());
+    }
+    if (ttype->is_list()) {
+      return uses_container_kinds(((t_list*)ttype)->get_elem_type());
+    }
+    return false;
+  }
+
+  /**
+   * True if ttype is generated as a std::pmr::string, which the protocols
+   * read and write through readStringAs() etc.
+   */
+  bool is_pmr_string(t_type* ttype) {
+    if (!gen_pmr_ || ttype->annotations_.find("cpp.type") != ttype->annotations_.end()) {
+      return false;
+    }
+    ttype = get_true_type(ttype);
+    return ttype->is_string() && ttype->annotations_.find("cpp.type") == ttype->annotations_.end();
+  }
+
+  /**
+   * True if a member or local of this type takes the allocator of its
+   * enclosing object in cpp:pmr mode.
+   */
+  bool is_allocator_aware(t_type* ttype) {
+    if (!gen_pmr_ || ttype->annotations_.find("cpp.type") != ttype->annotations_.end()) {
+      return false;
+    }
+    ttype = get_true_type(ttype);
+    if (ttype->is_container()) {
+      return !((t_container*)ttype)->has_cpp_name();
+    }
+    return is_pmr_string(ttype) || ttype->is_struct() || ttype->is_xception();
+  }
+
+  bool is_allocator_aware(t_field* tfield) {
+    return !is_reference(tfield) && !is_lazy_field(tfield) && !is_string_view_field(tfield)
+           && is_allocator_aware(tfield->get_type());
+  }
+
+  /**
+   * Declares a temporary that is read and then added to container, sharing
+   * the container's allocator in cpp:pmr mode.
+   */
+  std::string declare_element(t_field* tfield, const std::string& container) {
+    std::string decl = declare_field(tfield);
+    if (is_allocator_aware(tfield)) {
+      decl.insert(decl.size() - 1, "(" + container + ".get_allocator())");
+    }
+    return decl;
+  }
+
+  /**
+   * Returns the suffix of the protocol's bulk array methods (readI32Array()
+   * etc.) that can read or write a list of this element type in one call,
+   * or an empty string if the elements have to be handled one at a time.
+   */
+  std::string bulk_array_type(t_list* tlist) {
+    if (tlist->has_cpp_name()) {
+      return "";
+    }
+    t_type* etype = tlist->get_elem_type();
+    if (etype->annotations_.find("cpp.type") != etype->annotations_.end()) {
+      return "";
+    }
+    etype = get_true_type(etype);
+    if (!etype->is_base_type()
+        || etype->annotations_.find("cpp.type") != etype->annotations_.end()) {
+      return "";
+    }
+    switch (((t_base_type*)etype)->get_base()) {
+    case t_base_type::TYPE_I8:
+      return "Byte";
+    case t_base_type::TYPE_I16:
+      return "I16";
+    case t_base_type::TYPE_I32:
+      return "I32";
+    case t_base_type::TYPE_I64:
+      return "I64";
+    case t_base_type::TYPE_DOUBLE:
+      return "Double";
+    default:
+      return "";
+    }
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -402,6 +646,50 @@ private:
    */
   bool gen_private_optional_;
 
+  /**
+   * True if we should generate std::string_view string and binary fields.
+   */
+  bool gen_string_views_;
+
+  /**
+   * True if we should generate read() overloads taking a TFieldMask.
+   */
+  bool gen_field_masks_;
+
+  /**
+   * True if structs get a __clear() method and synchronous processors keep
+   * their args and result objects per thread instead of per call.
+   */
+  bool gen_reuse_objects_;
+
+  /**
+   * True if structs get a serializedSize() method, and processors generated
+   * with templates reserve the size of each reply before writing it.
+   */
+  bool gen_serialized_size_;
+
+  /**
+   * True if strings and containers are std::pmr types, structs are
+   * allocator-aware and synchronous processors read into a per-call arena.
+   */
+  bool gen_pmr_;
+
+  /**
+   * Kind of container generated for map<> and set<>: empty for std::map and
+   * std::set, "flat" or "unordered".  See container_kind().
+   */
+  std::string gen_containers_;
+
+  /**
+   * Containers used as map keys or set elements.  See collect_container_keys().
+   */
+  std::set<t_type*> container_keys_;
+
+  /**
+   * The struct being generated if its string fields are std::string_view.
+   */
+  t_struct* string_view_struct_;
+
   /**
    * True if thrift has member(s)
    */
@@ -422,6 +710,7 @@ private:
   ofstream_with_content_based_conditional_update f_types_;
   ofstream_with_content_based_conditional_update f_types_impl_;
   ofstream_with_content_based_conditional_update f_types_tcc_;
+  std::ostringstream f_types_sizes_;
   ofstream_with_content_based_conditional_update f_header_;
   ofstream_with_content_based_conditional_update f_service_;
   ofstream_with_content_based_conditional_update f_service_tcc_;
@@ -483,6 +772,72 @@ void t_cpp_generator::init_generator() {
   f_types_ << "#include <functional>" << '\n';
   f_types_ << "#include <memory>" << '\n';
 
+  bool uses_string_views = gen_string_views_;
+  const vector<t_struct*>& structs = program_->get_structs();
+  for (auto tstruct : structs) {
+    uses_string_views = uses_string_views || is_string_view_struct(tstruct);
+  }
+  if (uses_string_views) {
+    f_types_ << "#include <string_view>" << '\n';
+  }
+  if (gen_field_masks_) {
+    f_types_ << "#include <thrift/protocol/TFieldMask.h>" << '\n';
+  }
+  if (gen_pmr_) {
+    f_types_ << "#include <memory_resource>" << '\n';
+  }
+
+  vector<t_type*> program_types;
+  for (auto ttypedef : program_->get_typedefs()) {
+    program_types.push_back(ttypedef);
+  }
+  for (auto tstruct : structs) {
+    for (auto tfield : tstruct->get_members()) {
+      program_types.push_back(tfield->get_type());
+    }
+  }
+  for (auto txception : program_->get_xceptions()) {
+    for (auto tfield : txception->get_members()) {
+      program_types.push_back(tfield->get_type());
+    }
+  }
+  for (auto tservice : program_->get_services()) {
+    for (auto tfunction : tservice->get_functions()) {
+      program_types.push_back(tfunction->get_returntype());
+      for (auto tfield : tfunction->get_arglist()->get_members()) {
+        program_types.push_back(tfield->get_type());
+      }
+    }
+  }
+  for (auto tconst : program_->get_consts()) {
+    program_types.push_back(tconst->get_type());
+  }
+  for (auto ttype : program_types) {
+    collect_container_keys(ttype, false);
+  }
+  bool uses_containers = !gen_containers_.empty();
+  for (auto ttype : program_types) {
+    uses_containers = uses_containers || uses_container_kinds(ttype);
+  }
+  if (uses_containers) {
+    f_types_ << "#include <thrift/TContainers.h>" << '\n';
+  }
+
+  bool uses_lazy_fields = false;
+  for (auto tstruct : structs) {
+    for (auto tfield : tstruct->get_members()) {
+      uses_lazy_fields = uses_lazy_fields || is_lazy_field(tfield);
+    }
+  }
+  for (auto txception : program_->get_xceptions()) {
+    for (auto tfield : txception->get_members()) {
+      uses_lazy_fields = uses_lazy_fields || is_lazy_field(tfield);
+    }
+  }
+  if (uses_lazy_fields) {
+    f_types_ << "#include <thrift/protocol/TLazyField.h>" << '\n';
+  }
+
   // Include other Thrift includes
   const vector<t_program*>& includes = program_->get_includes();
   for (auto include : includes) {
@@ -534,6 +889,12 @@ void t_cpp_generator::init_generator() {
  * Closes the output files.
  */
 void t_cpp_generator::close_generator() {
+  // Without templates the serializedSize() templates go at the end of the
+  // header, where every struct they refer to is complete.
+  if (!gen_templates_) {
+    f_types_ << f_types_sizes_.str();
+  }
+
   // Close namespace
   f_types_ << ns_close_ << '\n' << '\n';
   f_types_impl_ << ns_close_ << '\n';
@@ -965,12 +1326,19 @@ void t_cpp_generator::generate_forward_declaration(t_struct* tstruct) {
  * @param tstruct The struct definition
  */
 void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception) {
+  string_view_struct_ = is_string_view_struct(tstruct) ? tstruct : nullptr;
   generate_struct_declaration(f_types_, tstruct, is_exception, false, true, true, true, true);
   generate_struct_definition(f_types_impl_, f_types_impl_, tstruct, true, true, false);
 
   std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
   generate_struct_reader(out, tstruct);
+  if (gen_field_masks_) {
+    generate_struct_reader(out, tstruct, false, true);
+  }
   generate_struct_writer(out, tstruct);
+  if (gen_serialized_size_) {
+    generate_struct_serialized_size(gen_templates_ ? out : f_types_sizes_, tstruct);
+  }
   generate_struct_swap(f_types_impl_, tstruct);
   if (!gen_no_default_operators_) {
     generate_equality_operator(f_types_impl_, tstruct);
@@ -994,6 +1362,7 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
     generate_exception_what_method(f_types_impl_, tstruct);
   }
 
+  string_view_struct_ = nullptr;
   has_members_ = true;
 }
 
@@ -1121,6 +1490,150 @@ void t_cpp_generator::generate_default_constructor(ostream& out,
   scope_down(out);
 }
 
+/**
+ * Generates __clear(), which puts a struct back into its default constructed
+ * state without giving up the memory held by its strings and containers.
+ */
+void t_cpp_generator::generate_struct_clear(ostream& out, t_struct* tstruct) {
+  vector<t_field*>::const_iterator m_iter;
+  const vector<t_field*>& members = tstruct->get_members();
+  bool has_nonrequired_fields = false;
+
+  out << '\n' << indent() << "void " << tstruct->get_name() << "::__clear() {" << '\n';
+  indent_up();
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    t_const_value* cv = (*m_iter)->get_value();
+    string name = "this->" + (*m_iter)->get_name();
+    if ((*m_iter)->get_req() != t_field::T_REQUIRED) {
+      has_nonrequired_fields = true;
+    }
+    if (is_reference(*m_iter)) {
+      indent(out) << name << ".reset();" << '\n';
+    } else if (is_lazy_field(*m_iter)) {
+      indent(out) << name << " = " << type_name(t) << "();" << '\n';
+    } else if (t->is_string() && !is_string_view_field(*m_iter)) {
+      if (cv != nullptr) {
+        indent(out) << name << " = " << render_const_value(&out, name, t, cv) << ";" << '\n';
+      } else {
+        indent(out) << name << ".clear();" << '\n';
+      }
+    } else if (t->is_base_type() || t->is_enum()) {
+      string dval;
+      if (cv != nullptr) {
+        dval = render_const_value(&out, name, t, cv);
+      } else if (t->is_enum()) {
+        dval = "static_cast<" + type_name(t) + ">(0)";
+      } else if (t->is_string() || t->is_uuid()) {
+        dval = type_name(t) + "()";
+      } else {
+        dval = "0";
+      }
+      indent(out) << name << " = " << dval << ";" << '\n';
+    } else {
+      indent(out) << name << (t->is_container() ? ".clear();" : ".__clear();") << '\n';
+      if (cv != nullptr) {
+        print_const_value(out, name, t, cv);
+      }
+    }
+  }
+  if (has_nonrequired_fields) {
+    indent(out) << "__isset = _" << tstruct->get_name() << "__isset();" << '\n';
+  }
+  indent_down();
+  indent(out) << "}" << '\n';
+}
+
+/**
+ * Generates the allocator-extended default, copy and move constructors of
+ * cpp:pmr structs.  Strings, containers and structs get the allocator,
+ * everything else is initialized like in the plain constructors.
+ */
+void t_cpp_generator::generate_allocator_constructors(ostream& out, t_struct* tstruct) {
+  vector<t_field*>::const_iterator m_iter;
+  const vector<t_field*>& members = tstruct->get_members();
+  const string& name = tstruct->get_name();
+  bool has_nonrequired_fields = false;
+  bool uses_alloc = false;
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    uses_alloc = uses_alloc || is_allocator_aware(*m_iter);
+  }
+
+  // Default
+  out << '\n' << indent() << name << "::" << name << "(const allocator_type& alloc)";
+  string sep = " : ";
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    t_const_value* cv = (*m_iter)->get_value();
+    if ((*m_iter)->get_req() != t_field::T_REQUIRED) {
+      has_nonrequired_fields = true;
+    }
+    if (is_allocator_aware(*m_iter)) {
+      out << sep << (*m_iter)->get_name() << "(";
+      if (t->is_string() && cv != nullptr) {
+        out << render_const_value(&out, (*m_iter)->get_name(), t, cv) << ", ";
+      }
+      out << "alloc)";
+    } else if (t->is_base_type() || t->is_enum() || is_reference(*m_iter)) {
+      string dval;
+      if (cv != nullptr) {
+        dval = render_const_value(&out, (*m_iter)->get_name(), t, cv);
+      } else if (t->is_enum()) {
+        dval = "static_cast<" + type_name(t) + ">(0)";
+      } else if (!t->is_string() && !t->is_uuid() && !is_reference(*m_iter)) {
+        dval = "0";
+      }
+      out << sep << (*m_iter)->get_name() << "(" << dval << ")";
+    } else {
+      continue;
+    }
+    sep = ", ";
+  }
+  out << " {" << '\n';
+  indent_up();
+  if (!uses_alloc) {
+    indent(out) << "(void) alloc;" << '\n';
+  }
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    if (!t->is_base_type() && !t->is_enum() && !is_reference(*m_iter)
+        && (*m_iter)->get_value() != nullptr) {
+      print_const_value(out, (*m_iter)->get_name(), t, (*m_iter)->get_value());
+    }
+  }
+  indent_down();
+  indent(out) << "}" << '\n';
+
+  // Copy and move
+  for (int is_move = 0; is_move < 2; is_move++) {
+    out << '\n' << indent() << name << "::" << name << "(" << (is_move ? "" : "const ") << name
+        << (is_move ? "&&" : "&") << " other, const allocator_type& alloc)";
+    sep = " : ";
+    for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+      string other = "other." + (*m_iter)->get_name();
+      out << sep << (*m_iter)->get_name() << "(" << (is_move ? "std::move(" + other + ")" : other);
+      if (is_allocator_aware(*m_iter)) {
+        out << ", alloc";
+      }
+      out << ")";
+      sep = ", ";
+    }
+    out << " {" << '\n';
+    indent_up();
+    if (members.empty()) {
+      indent(out) << "(void) other;" << '\n';
+    }
+    if (!uses_alloc) {
+      indent(out) << "(void) alloc;" << '\n';
+    }
+    if (has_nonrequired_fields) {
+      indent(out) << "__isset = other.__isset;" << '\n';
+    }
+    indent_down();
+    indent(out) << "}" << '\n';
+  }
+}
+
 void t_cpp_generator::generate_copy_constructor(ostream& out,
                                                 t_struct* tstruct,
                                                 bool is_exception) {
@@ -1346,6 +1859,17 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
     // Default constructor
     std::string clsname_ctor = tstruct->get_name() + "()";
     indent(out) << clsname_ctor << (has_default_value ? "" : " noexcept") << ";" << '\n';
+
+    // Allocator-extended constructors, so that std::pmr containers pass
+    // their memory resource down to the structs they hold
+    if (gen_pmr_) {
+      out << '\n' << indent() << "typedef ::std::pmr::polymorphic_allocator<char> allocator_type;"
+          << '\n' << indent() << "explicit " << tstruct->get_name()
+          << "(const allocator_type& alloc);" << '\n' << indent() << tstruct->get_name()
+          << "(const " << tstruct->get_name() << "& other, const allocator_type& alloc);" << '\n'
+          << indent() << tstruct->get_name() << "(" << tstruct->get_name()
+          << "&& other, const allocator_type& alloc);" << '\n';
+    }
   }
 
   if (!gen_no_constructors_ && tstruct->annotations_.find("final") == tstruct->annotations_.end()) {
@@ -1391,6 +1915,9 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
       out << '\n' << indent() << "void __set_" << (*m_iter)->get_name() << "(::std::shared_ptr<"
           << type_name((*m_iter)->get_type(), false, false) << ">";
       out << " val);" << '\n';
+    } else if (is_string_view_field(*m_iter)) {
+      out << '\n' << indent() << "void __set_" << (*m_iter)->get_name()
+          << "(const std::string_view val);" << '\n';
     } else {
       out << '\n' << indent() << "void __set_" << (*m_iter)->get_name() << "("
           << type_name((*m_iter)->get_type(), false, true);
@@ -1398,11 +1925,19 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
     }
   }
 
+  if (gen_reuse_objects_ && !pointers) {
+    out << '\n' << indent() << "/**" << '\n' << indent()
+        << " * Resets all fields to their default values, keeping allocated capacity." << '\n'
+        << indent() << " */" << '\n' << indent() << "void __clear();" << '\n';
+  }
+
   // Generate getter methods when private_optional is enabled
   if (gen_private_optional_ && !pointers) {
     for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
       std::string field_type = type_name((*m_iter)->get_type());
-      if (is_reference((*m_iter))) {
+      if (is_string_view_field(*m_iter)) {
+        field_type = "std::string_view";
+      } else if (is_reference((*m_iter))) {
         field_type = "::std::shared_ptr<" + field_type + ">";
       }
       // Const getter only
@@ -1442,6 +1977,16 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    if (gen_field_masks_ && is_user_struct) {
+      if (gen_templates_) {
+        out << indent() << "template <class Protocol_>" << '\n' << indent()
+            << "uint32_t read(Protocol_* iprot, "
+            << "const ::apache::thrift::protocol::TFieldMask& mask);" << '\n';
+      } else {
+        out << indent() << "uint32_t read(::apache::thrift::protocol::TProtocol* iprot, "
+            << "const ::apache::thrift::protocol::TFieldMask& mask);" << '\n';
+      }
+    }
   }
   if (write) {
     if (gen_templates_) {
@@ -1454,6 +1999,12 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    // With templates the service args and results get one as well, for the
+    // processor to size its replies
+    if (gen_serialized_size_ && !pointers && (is_user_struct || gen_templates_)) {
+      out << indent() << "template <class Protocol_>" << '\n' << indent()
+          << "uint32_t serializedSize(Protocol_* oprot) const;" << '\n';
+    }
   }
   out << '\n';
 
@@ -1556,6 +2107,14 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
     generate_default_constructor(force_cpp_out, tstruct, false);
   }
 
+  if (gen_reuse_objects_ && !pointers) {
+    generate_struct_clear(force_cpp_out, tstruct);
+  }
+
+  if (gen_pmr_ && !gen_no_constructors_ && !pointers) {
+    generate_allocator_constructors(force_cpp_out, tstruct);
+  }
+
   // Create a setter function for each field
   if (setters) {
     for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
@@ -1564,6 +2123,9 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
             << (*m_iter)->get_name() << "(::std::shared_ptr<"
             << type_name((*m_iter)->get_type(), false, false) << ">";
         out << " val) {" << '\n';
+      } else if (is_string_view_field(*m_iter)) {
+        out << '\n' << indent() << "void " << tstruct->get_name() << "::__set_"
+            << (*m_iter)->get_name() << "(const std::string_view val) {" << '\n';
       } else {
         out << '\n' << indent() << "void " << tstruct->get_name() << "::__set_"
             << (*m_iter)->get_name() << "(" << type_name((*m_iter)->get_type(), false, true);
@@ -1594,13 +2156,19 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
  * @param out Stream to write to
  * @param tstruct The struct
  */
-void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bool pointers) {
+void t_cpp_generator::generate_struct_reader(ostream& out,
+                                             t_struct* tstruct,
+                                             bool pointers,
+                                             bool masked) {
+  // The masked overload only reads the fields in mask and skips the rest.
+  string mask_param = masked ? ", const ::apache::thrift::protocol::TFieldMask& mask" : "";
   if (gen_templates_) {
     out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
-        << tstruct->get_name() << "::read(Protocol_* iprot) {" << '\n';
+        << tstruct->get_name() << "::read(Protocol_* iprot" << mask_param << ") {" << '\n';
   } else {
     indent(out) << "uint32_t " << tstruct->get_name()
-                << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << '\n';
+                << "::read(::apache::thrift::protocol::TProtocol* iprot" << mask_param << ") {"
+                << '\n';
   }
   indent_up();
 
@@ -1650,7 +2218,11 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
     for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
       indent(out) << "case " << (*f_iter)->get_key() << ":" << '\n';
       indent_up();
-      indent(out) << "if (ftype == " << type_to_enum((*f_iter)->get_type()) << ") {" << '\n';
+      indent(out) << "if (ftype == " << type_to_enum((*f_iter)->get_type());
+      if (masked) {
+        out << " && mask.contains(" << (*f_iter)->get_key() << ")";
+      }
+      out << ") {" << '\n';
       indent_up();
 
       const char* isset_prefix = ((*f_iter)->get_req() != t_field::T_REQUIRED) ? "this->__isset."
@@ -1700,9 +2272,14 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   // there might possibly be a chance of continuing.
   out << '\n';
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
-    if ((*f_iter)->get_req() == t_field::T_REQUIRED)
-      out << indent() << "if (!isset_" << (*f_iter)->get_name() << ')' << '\n' << indent()
+    if ((*f_iter)->get_req() == t_field::T_REQUIRED) {
+      out << indent() << "if (!isset_" << (*f_iter)->get_name();
+      if (masked) {
+        out << " && mask.contains(" << (*f_iter)->get_key() << ")";
+      }
+      out << ')' << '\n' << indent()
           << "  throw TProtocolException(TProtocolException::INVALID_DATA);" << '\n';
+    }
   }
 
   indent(out) << "return xfer;" << '\n';
@@ -1775,6 +2352,169 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
   indent(out) << "}" << '\n' << '\n';
 }
 
+/**
+ * Generates serializedSize(), which returns the number of bytes write()
+ * would produce with the given binary or compact protocol, so that output
+ * buffers can be sized before writing.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_serialized_size(ostream& out,
+                                                      t_struct* tstruct,
+                                                      bool result) {
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
+      << tstruct->get_name() << "::serializedSize(Protocol_* oprot) const {" << '\n';
+  indent_up();
+
+  out << indent() << "uint32_t xfer = 0;" << '\n';
+
+  // The compact field header depends on the id of the field written before,
+  // which is only known at run time once optional fields are skipped
+  bool track_last_id = !result && fields.size() > 1;
+  if (track_last_id) {
+    out << indent() << "int16_t lastFieldId = 0;" << '\n';
+  }
+
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    // Like generate_struct_result_writer(), a result has only one field set
+    bool check_if_set = result || (*f_iter)->get_req() == t_field::T_OPTIONAL
+                        || (*f_iter)->get_type()->is_xception();
+    if (check_if_set) {
+      out << (result && f_iter != fields.begin() ? "" : "\n") << indent()
+          << (result && f_iter != fields.begin() ? "else if" : "if")
+          << " (this->__isset." << (*f_iter)->get_name() << ") {" << '\n';
+      indent_up();
+    } else {
+      out << '\n';
+    }
+
+    out << indent() << "xfer += oprot->serializedSizeFieldBegin("
+        << type_to_enum((*f_iter)->get_type()) << ", " << (*f_iter)->get_key() << ", "
+        << (track_last_id ? "lastFieldId" : "0") << ");" << '\n';
+    generate_serialized_size_field(out, *f_iter, "this->");
+    if (track_last_id && f_iter + 1 != fields.end()) {
+      out << indent() << "lastFieldId = " << (*f_iter)->get_key() << ";" << '\n';
+    }
+    if (check_if_set) {
+      indent_down();
+      indent(out) << '}' << '\n';
+    }
+  }
+
+  out << '\n'
+      << indent() << "xfer += oprot->serializedSizeStop();" << '\n'
+      << indent() << "return xfer;" << '\n';
+
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+}
+
+/**
+ * Adds the encoded size of a field, mirroring generate_serialize_field().
+ */
+void t_cpp_generator::generate_serialized_size_field(ostream& out,
+                                                     t_field* tfield,
+                                                     string prefix) {
+  t_type* type = get_true_type(tfield->get_type());
+  string name = prefix + tfield->get_name();
+
+  if (type->is_struct() || type->is_xception()) {
+    if (is_reference(tfield)) {
+      indent(out) << "xfer += " << name << " ? " << name
+                  << "->serializedSize(oprot) : oprot->serializedSizeStop();" << '\n';
+    } else {
+      indent(out) << "xfer += " << name << ".serializedSize(oprot);" << '\n';
+    }
+  } else if (type->is_container()) {
+    generate_serialized_size_container(out, type, name);
+  } else if (type->is_enum()) {
+    indent(out) << "xfer += oprot->serializedSizeI32(static_cast<int32_t>(" << name << "));"
+                << '\n';
+  } else if (type->is_base_type()) {
+    indent(out) << "xfer += oprot->";
+    t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
+    switch (tbase) {
+    case t_base_type::TYPE_UUID:
+      out << "serializedSizeUUID();";
+      break;
+    case t_base_type::TYPE_STRING:
+      out << (type->is_binary() ? "serializedSizeBinary" : "serializedSizeString")
+          << "(static_cast<uint32_t>(" << name << ".size()));";
+      break;
+    case t_base_type::TYPE_BOOL:
+      out << "serializedSizeBool(" << name << ");";
+      break;
+    case t_base_type::TYPE_I8:
+      out << "serializedSizeByte(" << name << ");";
+      break;
+    case t_base_type::TYPE_I16:
+      out << "serializedSizeI16(" << name << ");";
+      break;
+    case t_base_type::TYPE_I32:
+      out << "serializedSizeI32(" << name << ");";
+      break;
+    case t_base_type::TYPE_I64:
+      out << "serializedSizeI64(" << name << ");";
+      break;
+    case t_base_type::TYPE_DOUBLE:
+      out << "serializedSizeDouble(" << name << ");";
+      break;
+    default:
+      throw "compiler error: no C++ size for base type " + t_base_type::t_base_name(tbase) + " "
+          + name;
+    }
+    out << '\n';
+  } else {
+    throw "compiler error: no C++ size for type " + type_name(type) + " " + name;
+  }
+}
+
+void t_cpp_generator::generate_serialized_size_container(ostream& out,
+                                                         t_type* ttype,
+                                                         string prefix) {
+  scope_up(out);
+
+  if (ttype->is_map()) {
+    indent(out) << "xfer += oprot->serializedSizeMapBegin("
+                << type_to_enum(((t_map*)ttype)->get_key_type()) << ", "
+                << type_to_enum(((t_map*)ttype)->get_val_type()) << ", "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  } else if (ttype->is_set()) {
+    indent(out) << "xfer += oprot->serializedSizeSetBegin("
+                << type_to_enum(((t_set*)ttype)->get_elem_type()) << ", "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  } else if (ttype->is_list()) {
+    indent(out) << "xfer += oprot->serializedSizeListBegin("
+                << type_to_enum(((t_list*)ttype)->get_elem_type()) << ", "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  }
+
+  string iter = tmp("_iter");
+  out << indent() << type_name(ttype) << "::const_iterator " << iter << ";" << '\n' << indent()
+      << "for (" << iter << " = " << prefix << ".begin(); " << iter << " != " << prefix
+      << ".end(); ++" << iter << ")" << '\n';
+  scope_up(out);
+  if (ttype->is_map()) {
+    t_field kfield(((t_map*)ttype)->get_key_type(), iter + "->first");
+    generate_serialized_size_field(out, &kfield, "");
+    t_field vfield(((t_map*)ttype)->get_val_type(), iter + "->second");
+    generate_serialized_size_field(out, &vfield, "");
+  } else if (ttype->is_set()) {
+    t_field efield(((t_set*)ttype)->get_elem_type(), "(*" + iter + ")");
+    generate_serialized_size_field(out, &efield, "");
+  } else if (ttype->is_list()) {
+    t_field efield(((t_list*)ttype)->get_elem_type(), "(*" + iter + ")");
+    generate_serialized_size_field(out, &efield, "");
+  }
+  scope_down(out);
+
+  scope_down(out);
+}
+
 /**
  * Struct writer for result of a function, which can have only one of its
  * fields set and does a conditional if else look up into the __isset field
@@ -2080,6 +2820,7 @@ void t_cpp_generator::generate_service(t_service* tservice) {
     f_header_ << "#include <thrift/async/TAsyncDispatchProcessor.h>" << '\n';
   }
   f_header_ << "#include <thrift/async/TConcurrentClientSyncInfo.h>" << '\n';
+  f_header_ << "#include <cstring>" << '\n';
   f_header_ << "#include <memory>" << '\n';
   f_header_ << "#include \"" << get_include_prefix(*get_program()) << program_name_ << "_types.h\""
             << '\n';
@@ -2202,6 +2943,9 @@ void t_cpp_generator::generate_service_helpers(t_service* tservice) {
     generate_struct_definition(out, f_service_, ts, false);
     generate_struct_reader(out, ts);
     generate_struct_writer(out, ts);
+    if (gen_serialized_size_ && gen_templates_) {
+      generate_struct_serialized_size(out, ts);
+    }
 
     ts->set_name(tservice->get_name() + "_" + (*f_iter)->get_name() + "_pargs");
     generate_struct_declaration(f_header_, ts, false, true, false, true);
@@ -3237,6 +3981,7 @@ public:
 
   void generate_class_definition();
   void generate_dispatch_call(bool template_protocol);
+  void generate_dispatch_tree(const std::vector<t_function*>& functions);
   void generate_process_functions();
   void generate_factory();
 
@@ -3262,15 +4007,12 @@ protected:
   string if_name_;
   string factory_class_name_;
   string finish_cob_;
-  string finish_cob_decl_;
   string ret_type_;
   string call_context_;
   string cob_arg_;
   string call_context_arg_;
-  string call_context_decl_;
   string template_header_;
   string template_suffix_;
-  string typename_str_;
   string class_suffix_;
   string extends_;
 };
@@ -3290,7 +4032,6 @@ ProcessorGenerator::ProcessorGenerator(t_cpp_generator* generator,
     if_name_ = service_name_ + "CobSvIf";
 
     finish_cob_ = "::std::function<void(bool ok)> cob, ";
-    finish_cob_decl_ = "::std::function<void(bool ok)>, ";
     cob_arg_ = "cob, ";
     ret_type_ = "void ";
   } else {
@@ -3301,7 +4042,6 @@ ProcessorGenerator::ProcessorGenerator(t_cpp_generator* generator,
     // TODO(edhall) callContext should eventually be added to TAsyncProcessor
     call_context_ = ", void* callContext";
     call_context_arg_ = ", callContext";
-    call_context_decl_ = ", void*";
   }
 
   factory_class_name_ = class_name_ + "Factory";
@@ -3309,7 +4049,6 @@ ProcessorGenerator::ProcessorGenerator(t_cpp_generator* generator,
   if (generator->gen_templates_) {
     template_header_ = "template <class Protocol_>\n";
     template_suffix_ = "<Protocol_>";
-    typename_str_ = "typename ";
     class_name_ += "T";
     factory_class_name_ += "T";
   }
@@ -3368,30 +4107,6 @@ void ProcessorGenerator::generate_class_definition() {
   f_header_ << " private:" << '\n';
   indent_up();
 
-  // Declare processMap_
-  f_header_ << indent() << "typedef  void (" << class_name_ << "::*"
-            << "ProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-            << "::apache::thrift::protocol::TProtocol*, "
-            << "::apache::thrift::protocol::TProtocol*" << call_context_decl_ << ");" << '\n';
-  if (generator_->gen_templates_) {
-    f_header_ << indent() << "typedef void (" << class_name_ << "::*"
-              << "SpecializedProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-              << "Protocol_*, Protocol_*" << call_context_decl_ << ");" << '\n' << indent()
-              << "struct ProcessFunctions {" << '\n' << indent() << "  ProcessFunction generic;"
-              << '\n' << indent() << "  SpecializedProcessFunction specialized;" << '\n' << indent()
-              << "  ProcessFunctions(ProcessFunction g, "
-              << "SpecializedProcessFunction s) :" << '\n' << indent() << "    generic(g)," << '\n'
-              << indent() << "    specialized(s) {}" << '\n' << indent()
-              << "  ProcessFunctions() : generic(nullptr), specialized(nullptr) "
-              << "{}" << '\n' << indent() << "};" << '\n' << indent()
-              << "typedef std::map<std::string, ProcessFunctions> "
-              << "ProcessMap;" << '\n';
-  } else {
-    f_header_ << indent() << "typedef std::map<std::string, ProcessFunction> "
-              << "ProcessMap;" << '\n';
-  }
-  f_header_ << indent() << "ProcessMap processMap_;" << '\n';
-
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
     indent(f_header_) << "void process_" << (*f_iter)->get_name() << "(" << finish_cob_
                       << "int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, "
@@ -3436,26 +4151,6 @@ void ProcessorGenerator::generate_class_definition() {
     f_header_ << indent() << "  " << extends_ << "(iface)," << '\n';
   }
   f_header_ << indent() << "  iface_(iface) {" << '\n';
-  indent_up();
-
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    f_header_ << indent() << "processMap_[\"" << (*f_iter)->get_name() << "\"] = ";
-    if (generator_->gen_templates_) {
-      f_header_ << "ProcessFunctions(" << '\n';
-      if (generator_->gen_templates_only_) {
-        indent(f_header_) << "  nullptr," << '\n';
-      } else {
-        indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ","
-                          << '\n';
-      }
-      indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ")";
-    } else {
-      f_header_ << "&" << class_name_ << "::process_" << (*f_iter)->get_name();
-    }
-    f_header_ << ";" << '\n';
-  }
-
-  indent_down();
   f_header_ << indent() << "}" << '\n' << '\n' << indent() << "virtual ~" << class_name_ << "() {}"
             << '\n';
   indent_down();
@@ -3497,53 +4192,103 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
          << "const std::string& fname, int32_t seqid" << call_context_ << ") {" << '\n';
   indent_up();
 
-  // HOT: member function pointer map
-  f_out_ << indent() << typename_str_ << "ProcessMap::iterator pfn;" << '\n' << indent()
-         << "pfn = processMap_.find(fname);" << '\n' << indent()
-         << "if (pfn == processMap_.end()) {" << '\n';
+  // HOT: switch on the name, see generate_dispatch_tree()
+  vector<t_function*> functions = service_->get_functions();
+  if (!functions.empty()) {
+    std::map<size_t, vector<t_function*> > by_length;
+    for (vector<t_function*>::iterator f_iter = functions.begin(); f_iter != functions.end();
+         ++f_iter) {
+      by_length[(*f_iter)->get_name().size()].push_back(*f_iter);
+    }
+    f_out_ << indent() << "switch (fname.size()) {" << '\n';
+    for (std::map<size_t, vector<t_function*> >::iterator l_iter = by_length.begin();
+         l_iter != by_length.end(); ++l_iter) {
+      f_out_ << indent() << "case " << l_iter->first << ":" << '\n';
+      indent_up();
+      generate_dispatch_tree(l_iter->second);
+      f_out_ << indent() << "break;" << '\n';
+      indent_down();
+    }
+    f_out_ << indent() << "}" << '\n';
+  }
+
   if (extends_.empty()) {
-    f_out_ << indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << '\n' << indent()
-           << "  iprot->readMessageEnd();" << '\n' << indent()
-           << "  iprot->getTransport()->readEnd();" << '\n' << indent()
-           << "  ::apache::thrift::TApplicationException "
+    if (functions.empty() && !call_context_.empty()) {
+      f_out_ << indent() << "(void)callContext;" << '\n';
+    }
+    f_out_ << indent() << "iprot->skip(::apache::thrift::protocol::T_STRUCT);" << '\n' << indent()
+           << "iprot->readMessageEnd();" << '\n' << indent()
+           << "iprot->getTransport()->readEnd();" << '\n' << indent()
+           << "::apache::thrift::TApplicationException "
               "x(::apache::thrift::TApplicationException::UNKNOWN_METHOD, \"Invalid method name: "
               "'\"+fname+\"'\");" << '\n' << indent()
-           << "  oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
-           << '\n' << indent() << "  x.write(oprot);" << '\n' << indent()
-           << "  oprot->writeMessageEnd();" << '\n' << indent()
-           << "  oprot->getTransport()->writeEnd();" << '\n' << indent()
-           << "  oprot->getTransport()->flush();" << '\n' << indent()
-           << (style_ == "Cob" ? "  return cob(true);" : "  return true;") << '\n';
+           << "oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
+           << '\n' << indent() << "x.write(oprot);" << '\n' << indent()
+           << "oprot->writeMessageEnd();" << '\n' << indent()
+           << "oprot->getTransport()->writeEnd();" << '\n' << indent()
+           << "oprot->getTransport()->flush();" << '\n' << indent()
+           << (style_ == "Cob" ? "return cob(true);" : "return true;") << '\n';
   } else {
-    f_out_ << indent() << "  return " << extends_ << "::dispatchCall("
-           << (style_ == "Cob" ? "cob, " : "") << "iprot, oprot, fname, seqid" << call_context_arg_
-           << ");" << '\n';
+    f_out_ << indent() << "return " << extends_ << "::dispatchCall"
+           << function_suffix << "(" << (style_ == "Cob" ? "cob, " : "")
+           << "iprot, oprot, fname, seqid" << call_context_arg_ << ");" << '\n';
   }
-  f_out_ << indent() << "}" << '\n';
-  if (template_protocol) {
-    f_out_ << indent() << "(this->*(pfn->second.specialized))";
-  } else {
-    if (generator_->gen_templates_only_) {
-      // TODO: This is a null pointer, so nothing good will come from calling
-      // it.  Throw an exception instead.
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else if (generator_->gen_templates_) {
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else {
-      f_out_ << indent() << "(this->*(pfn->second))";
-    }
+
+  indent_down();
+  f_out_ << "}" << '\n' << '\n';
+}
+
+/**
+ * Emits the lookup of fname among functions, which all have names of the
+ * same length: nested switches on the characters that tell the names apart,
+ * then a single memcmp to confirm the match.  Falls through if there is
+ * none.
+ */
+void ProcessorGenerator::generate_dispatch_tree(const vector<t_function*>& functions) {
+  if (functions.size() == 1) {
+    const string& name = functions.front()->get_name();
+    f_out_ << indent() << "if (::std::memcmp(fname.data(), \"" << name << "\", " << name.size()
+           << ") == 0) {" << '\n';
+    indent_up();
+    f_out_ << indent() << "process_" << name << "(" << cob_arg_ << "seqid, iprot, oprot"
+           << call_context_arg_ << ");" << '\n';
+    f_out_ << indent() << (style_ == "Cob" ? "return;" : "return true;") << '\n';
+    indent_down();
+    f_out_ << indent() << "}" << '\n';
+    return;
   }
-  f_out_ << "(" << cob_arg_ << "seqid, iprot, oprot" << call_context_arg_ << ");" << '\n';
 
-  // TODO(dreiss): return pfn ret?
-  if (style_ == "Cob") {
-    f_out_ << indent() << "return;" << '\n';
-  } else {
-    f_out_ << indent() << "return true;" << '\n';
+  // Split on the position with the most distinct characters
+  size_t length = functions.front()->get_name().size();
+  size_t best_pos = 0;
+  size_t best_count = 0;
+  for (size_t pos = 0; pos < length; ++pos) {
+    std::set<char> chars;
+    for (vector<t_function*>::const_iterator f_iter = functions.begin();
+         f_iter != functions.end(); ++f_iter) {
+      chars.insert((*f_iter)->get_name()[pos]);
+    }
+    if (chars.size() > best_count) {
+      best_pos = pos;
+      best_count = chars.size();
+    }
   }
 
-  indent_down();
-  f_out_ << "}" << '\n' << '\n';
+  std::map<char, vector<t_function*> > by_char;
+  for (vector<t_function*>::const_iterator f_iter = functions.begin(); f_iter != functions.end();
+       ++f_iter) {
+    by_char[(*f_iter)->get_name()[best_pos]].push_back(*f_iter);
+  }
+  f_out_ << indent() << "switch (fname[" << best_pos << "]) {" << '\n';
+  for (std::map<char, vector<t_function*> >::iterator c_iter = by_char.begin();
+       c_iter != by_char.end(); ++c_iter) {
+    f_out_ << indent() << "case '" << c_iter->first << "':" << '\n';
+    indent_up();
+    generate_dispatch_tree(c_iter->second);
+    f_out_ << indent() << "break;" << '\n';
+    indent_down();
+  }
+  f_out_ << indent() << "}" << '\n';
 }
 
 void ProcessorGenerator::generate_process_functions() {
@@ -3649,6 +4394,9 @@ void t_cpp_generator::generate_function_helpers(t_service* tservice, t_function*
   generate_struct_definition(out, f_service_, &result, false);
   generate_struct_reader(out, &result);
   generate_struct_result_writer(out, &result);
+  if (gen_serialized_size_ && gen_templates_) {
+    generate_struct_serialized_size(out, &result, true);
+  }
 
   result.set_name(tservice->get_name() + "_" + tfunction->get_name() + "_presult");
   generate_struct_declaration(f_header_, &result, false, true, true, gen_cob_style_);
@@ -3714,7 +4462,24 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         << "this->eventHandler_.get(), ctx, " << service_func_name << ");" << '\n' << '\n'
         << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
         << "  this->eventHandler_->preRead(ctx, " << service_func_name << ");" << '\n' << indent()
-        << "}" << '\n' << '\n' << indent() << argsname << " args;" << '\n' << indent()
+        << "}" << '\n' << '\n';
+    // With reuse_objects the args and result live as long as the thread, so
+    // strings and containers keep their capacity from one call to the next.
+    // A nested call on the same thread gets objects of its own.
+    if (gen_reuse_objects_) {
+      out << indent() << "::apache::thrift::TReusedObject<" << argsname << "> reusedArgs;" << '\n'
+          << indent() << argsname << "& args = reusedArgs.get();" << '\n';
+    } else if (gen_pmr_) {
+      // With pmr the args and result allocate from an arena that starts on
+      // the stack and is released in one go when the call returns.
+      out << indent() << "alignas(::std::max_align_t) unsigned char arenaBuffer[4096];" << '\n'
+          << indent()
+          << "::std::pmr::monotonic_buffer_resource arena(arenaBuffer, sizeof(arenaBuffer));"
+          << '\n' << indent() << argsname << " args(&arena);" << '\n';
+    } else {
+      out << indent() << argsname << " args;" << '\n';
+    }
+    out << indent()
         << "args.read(iprot);" << '\n' << indent() << "iprot->readMessageEnd();" << '\n' << indent()
         << "uint32_t bytes = iprot->getTransport()->readEnd();" << '\n' << '\n' << indent()
         << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
@@ -3723,7 +4488,14 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
 
     // Declare result
     if (!tfunction->is_oneway()) {
-      out << indent() << resultname << " result;" << '\n';
+      if (gen_reuse_objects_) {
+        out << indent() << "::apache::thrift::TReusedObject<" << resultname << "> reusedResult;"
+            << '\n' << indent() << resultname << "& result = reusedResult.get();" << '\n';
+      } else if (gen_pmr_) {
+        out << indent() << resultname << " result(&arena);" << '\n';
+      } else {
+        out << indent() << resultname << " result;" << '\n';
+      }
     }
 
     // Try block for functions with exceptions
@@ -3814,7 +4586,14 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
     // Serialize the result into a struct
     out << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
         << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n' << indent()
-        << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name()
+        << "}" << '\n' << '\n';
+    if (gen_serialized_size_ && specialized) {
+      // Size the output buffer once instead of growing it during the write
+      out << indent() << "oprot->getTransport()->reserve(oprot->serializedSizeMessageBegin(\""
+          << tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid)"
+          << " + result.serializedSize(oprot));" << '\n';
+    }
+    out << indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name()
         << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n' << indent()
         << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();" << '\n'
         << indent() << "bytes = oprot->getTransport()->writeEnd();" << '\n' << indent()
@@ -4163,10 +4942,26 @@ void t_cpp_generator::generate_deserialize_field(ostream& out,
 
   string name = prefix + tfield->get_name() + suffix;
 
-  if (type->is_struct() || type->is_xception()) {
+  if (is_string_view_field(tfield)) {
+    // Borrow the bytes from the transport instead of copying them
+    string data = tmp("_viewData");
+    string size = tmp("_viewSize");
+    scope_up(out);
+    out << indent() << "const uint8_t* " << data << ";" << '\n'
+        << indent() << "uint32_t " << size << ";" << '\n'
+        << indent() << "xfer += iprot->" << (type->is_binary() ? "readBinaryView(" : "readStringView(")
+        << data << ", " << size << ");" << '\n'
+        << indent() << name << " = std::string_view(reinterpret_cast<const char*>(" << data
+        << "), " << size << ");" << '\n';
+    scope_down(out);
+  } else if (type->is_struct() || type->is_xception()) {
     generate_deserialize_struct(out, (t_struct*)type, name, is_reference(tfield));
   } else if (type->is_container()) {
     generate_deserialize_container(out, type, name);
+  } else if (is_pmr_string(tfield->get_type())) {
+    indent(out) << "xfer += ::apache::thrift::protocol::"
+                << (type->is_binary() ? "readBinaryAs" : "readStringAs") << "(iprot, " << name
+                << ");" << '\n';
   } else if (type->is_base_type()) {
     indent(out) << "xfer += iprot->";
     t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
@@ -4269,12 +5064,26 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
   } else if (ttype->is_set()) {
     out << indent() << "::apache::thrift::protocol::TType " << etype << ";" << '\n' << indent()
         << "xfer += iprot->readSetBegin(" << etype << ", " << size << ");" << '\n';
-  } else if (ttype->is_list()) {
+  }
+  if (!use_push && !container_kind(ttype).empty()) {
+    indent(out) << prefix << ".reserve(" << size << ");" << '\n';
+  }
+  if (ttype->is_list()) {
     out << indent() << "::apache::thrift::protocol::TType " << etype << ";" << '\n' << indent()
         << "xfer += iprot->readListBegin(" << etype << ", " << size << ");" << '\n';
     if (!use_push) {
       indent(out) << prefix << ".resize(" << size << ");" << '\n';
     }
+
+    // Lists of fixed-size numbers are read in a single call
+    string bulk = bulk_array_type((t_list*)ttype);
+    if (!bulk.empty()) {
+      indent(out) << "xfer += iprot->read" << bulk << "Array(" << prefix << ".data(), " << size
+                  << ");" << '\n';
+      indent(out) << "xfer += iprot->readListEnd();" << '\n';
+      scope_down(out);
+      return;
+    }
   }
 
   // For loop iterates over elements
@@ -4294,6 +5103,11 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
 
   scope_down(out);
 
+  // Flat containers are filled in wire order and sorted once
+  if (!use_push && container_kind(ttype) == "flat") {
+    indent(out) << prefix << ".sortAppended();" << '\n';
+  }
+
   // Read container end
   if (ttype->is_map()) {
     indent(out) << "xfer += iprot->readMapEnd();" << '\n';
@@ -4315,11 +5129,16 @@ void t_cpp_generator::generate_deserialize_map_element(ostream& out, t_map* tmap
   t_field fkey(tmap->get_key_type(), key);
   t_field fval(tmap->get_val_type(), val);
 
-  out << indent() << declare_field(&fkey) << '\n';
+  out << indent() << declare_element(&fkey, prefix) << '\n';
 
   generate_deserialize_field(out, &fkey);
-  indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix << "[" << key
-              << "];" << '\n';
+  if (!tmap->has_cpp_name() && container_kind(tmap) == "flat") {
+    indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix
+                << ".appendUnsorted(std::move(" << key << "));" << '\n';
+  } else {
+    indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix << "["
+                << key << "];" << '\n';
+  }
 
   generate_deserialize_field(out, &fval);
 }
@@ -4328,11 +5147,15 @@ void t_cpp_generator::generate_deserialize_set_element(ostream& out, t_set* tset
   string elem = tmp("_elem");
   t_field felem(tset->get_elem_type(), elem);
 
-  indent(out) << declare_field(&felem) << '\n';
+  indent(out) << declare_element(&felem, prefix) << '\n';
 
   generate_deserialize_field(out, &felem);
 
-  indent(out) << prefix << ".insert(" << elem << ");" << '\n';
+  if (!tset->has_cpp_name() && container_kind(tset) == "flat") {
+    indent(out) << prefix << ".appendUnsorted(std::move(" << elem << "));" << '\n';
+  } else {
+    indent(out) << prefix << ".insert(" << elem << ");" << '\n';
+  }
 }
 
 void t_cpp_generator::generate_deserialize_list_element(ostream& out,
@@ -4343,7 +5166,7 @@ void t_cpp_generator::generate_deserialize_list_element(ostream& out,
   if (use_push) {
     string elem = tmp("_elem");
     t_field felem(tlist->get_elem_type(), elem);
-    indent(out) << declare_field(&felem) << '\n';
+    indent(out) << declare_element(&felem, prefix) << '\n';
     generate_deserialize_field(out, &felem);
     indent(out) << prefix << ".push_back(" << elem << ");" << '\n';
   } else {
@@ -4375,6 +5198,10 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
     generate_serialize_struct(out, (t_struct*)type, name, is_reference(tfield));
   } else if (type->is_container()) {
     generate_serialize_container(out, type, name);
+  } else if (is_pmr_string(tfield->get_type()) && !is_string_view_field(tfield)) {
+    indent(out) << "xfer += ::apache::thrift::protocol::"
+                << (type->is_binary() ? "writeBinaryAs" : "writeStringAs") << "(oprot, " << name
+                << ");" << '\n';
   } else if (type->is_base_type() || type->is_enum()) {
 
     indent(out) << "xfer += oprot->";
@@ -4389,7 +5216,11 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
         out << "writeUUID(" << name << ");";
         break;
       case t_base_type::TYPE_STRING:
-        if (type->is_binary()) {
+        if (is_string_view_field(tfield)) {
+          out << (type->is_binary() ? "writeBinaryView" : "writeStringView")
+              << "(reinterpret_cast<const uint8_t*>(" << name << ".data()), static_cast<uint32_t>("
+              << name << ".size()));";
+        } else if (type->is_binary()) {
           out << "writeBinary(" << name << ");";
         } else {
           out << "writeString(" << name << ");";
@@ -4466,6 +5297,16 @@ void t_cpp_generator::generate_serialize_container(ostream& out, t_type* ttype,
     indent(out) << "xfer += oprot->writeListBegin("
                 << type_to_enum(((t_list*)ttype)->get_elem_type()) << ", "
                 << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+
+    // Lists of fixed-size numbers are written in a single call
+    string bulk = bulk_array_type((t_list*)ttype);
+    if (!bulk.empty()) {
+      indent(out) << "xfer += oprot->write" << bulk << "Array(" << prefix << ".data(), "
+                  << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+      indent(out) << "xfer += oprot->writeListEnd();" << '\n';
+      scope_down(out);
+      return;
+    }
   }
 
   string iter = tmp("_iter");
@@ -4632,14 +5473,34 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
       cname = tcontainer->get_cpp_name();
     } else if (ttype->is_map()) {
       t_map* tmap = (t_map*)ttype;
-      cname = "std::map<" + type_name(tmap->get_key_type(), in_typedef) + ", "
-              + type_name(tmap->get_val_type(), in_typedef) + "> ";
+      string kind = container_kind(ttype);
+      string ktype = type_name(tmap->get_key_type(), in_typedef);
+      string vtype = type_name(tmap->get_val_type(), in_typedef);
+      if (kind == "flat") {
+        cname = string(gen_pmr_ ? "::apache::thrift::pmr::" : "::apache::thrift::") + "TFlatMap<"
+                + ktype + ", " + vtype + "> ";
+      } else if (kind == "unordered") {
+        cname = container_prefix() + "unordered_map<" + ktype + ", " + vtype
+                + ", ::apache::thrift::THash<" + ktype + "> > ";
+      } else {
+        cname = container_prefix() + "map<" + ktype + ", " + vtype + "> ";
+      }
     } else if (ttype->is_set()) {
       t_set* tset = (t_set*)ttype;
-      cname = "std::set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
+      string kind = container_kind(ttype);
+      string etype = type_name(tset->get_elem_type(), in_typedef);
+      if (kind == "flat") {
+        cname = string(gen_pmr_ ? "::apache::thrift::pmr::" : "::apache::thrift::") + "TFlatSet<"
+                + etype + "> ";
+      } else if (kind == "unordered") {
+        cname = container_prefix() + "unordered_set<" + etype + ", ::apache::thrift::THash<"
+                + etype + "> > ";
+      } else {
+        cname = container_prefix() + "set<" + etype + "> ";
+      }
     } else if (ttype->is_list()) {
       t_list* tlist = (t_list*)ttype;
-      cname = "std::vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
+      cname = container_prefix() + "vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
     }
 
     if (arg) {
@@ -4689,7 +5550,7 @@ string t_cpp_generator::base_type_name(t_base_type::t_base tbase) {
   case t_base_type::TYPE_VOID:
     return "void";
   case t_base_type::TYPE_STRING:
-    return "std::string";
+    return gen_pmr_ ? "std::pmr::string" : "std::string";
   case t_base_type::TYPE_BOOL:
     return "bool";
   case t_base_type::TYPE_I8:
@@ -4725,9 +5586,15 @@ string t_cpp_generator::declare_field(t_field* tfield,
   if (constant) {
     result += "const ";
   }
-  result += type_name(tfield->get_type());
+  if (is_string_view_field(tfield)) {
+    result += "std::string_view";
+  } else {
+    result += type_name(tfield->get_type());
+  }
   if (is_reference(tfield)) {
     result = "::std::shared_ptr<" + result + ">";
+  } else if (is_lazy_field(tfield) && !pointer) {
+    result = "::apache::thrift::protocol::TLazyField<" + result + ">";
   }
   if (pointer) {
     result += "*";
@@ -4990,4 +5857,24 @@ THRIFT_REGISTER_GENERATOR(
     "    moveable_types:  Generate move constructors and assignment operators.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    string_views:    Generate std::string_view for string and binary struct fields,\n"
+    "                     read without copying from the transport buffer (C++17).\n"
+    "                     Use the cpp.string_views annotation to select single structs.\n"
+    "    field_masks:     Generate read() overloads that only deserialize the fields\n"
+    "                     selected by a TFieldMask and skip the others.\n"
+    "    reuse_objects:   Generate a __clear() method for every struct and let synchronous\n"
+    "                     processors reuse their args and result objects per thread.\n"
+    "                     A call nested in another one on the same thread, through a\n"
+    "                     processor of the same service, gets fresh objects instead.\n"
+    "                     Included files must be generated with the same option.\n"
+    "    serialized_size: Generate a serializedSize() method for every struct, returning the\n"
+    "                     bytes write() produces with the binary or compact protocol. With\n"
+    "                     templates, processors reserve the size of each reply first.\n"
+    "    pmr:             Generate std::pmr strings and containers and allocator-aware structs;\n"
+    "                     synchronous processors read each call into a monotonic arena (C++17).\n"
+    "                     Included files must be generated with the same option.\n"
+    "    containers=flat: Generate sorted-vector TFlatMap/TFlatSet for map and set types.\n"
+    "    containers=unordered:\n"
+    "                     Generate std::unordered_map/set for maps and sets with primitive or\n"
+    "                     enum keys. Use the cpp.containers annotation to select single types.\n")
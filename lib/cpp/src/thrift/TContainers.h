@@ -0,0 +1,374 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TCONTAINERS_H_
+#define _THRIFT_TCONTAINERS_H_ 1
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <thrift/TToString.h>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define THRIFT_HAS_MEMORY_RESOURCE 1
+#endif
+#endif
+
+/**
+ * Alternatives to std::map and std::set for the map<> and set<> fields of
+ * structs generated with cpp:containers=flat|unordered or the
+ * cpp.containers annotation.
+ */
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Hash of the keys of generated unordered containers.  Unlike std::hash in
+ * C++11 it also covers enums.
+ */
+template <class T, class Enable = void>
+struct THash : std::hash<T> {};
+
+template <class T>
+struct THash<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  std::size_t operator()(T value) const {
+    typedef typename std::underlying_type<T>::type underlying_type;
+    return std::hash<underlying_type>()(static_cast<underlying_type>(value));
+  }
+};
+
+namespace detail {
+
+/**
+ * Sorted vector shared by TFlatMap and TFlatSet.  KeyOf extracts the key
+ * of an element.
+ */
+template <class Value, class Key, class KeyOf, class Compare, class Alloc>
+class TFlatTree {
+public:
+  typedef Key key_type;
+  typedef Value value_type;
+  typedef Compare key_compare;
+  typedef Alloc allocator_type;
+  typedef std::vector<Value, Alloc> storage_type;
+  typedef typename storage_type::size_type size_type;
+  typedef typename storage_type::difference_type difference_type;
+  typedef typename storage_type::const_iterator const_iterator;
+
+  TFlatTree() {}
+  explicit TFlatTree(const allocator_type& alloc) : items_(alloc) {}
+  TFlatTree(const TFlatTree& other, const allocator_type& alloc) : items_(other.items_, alloc) {}
+  TFlatTree(TFlatTree&& other, const allocator_type& alloc)
+    : items_(std::move(other.items_), alloc) {}
+  TFlatTree(const TFlatTree&) = default;
+  TFlatTree(TFlatTree&&) = default;
+  TFlatTree& operator=(const TFlatTree&) = default;
+  TFlatTree& operator=(TFlatTree&&) = default;
+
+  allocator_type get_allocator() const { return items_.get_allocator(); }
+
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+  const_iterator cbegin() const { return items_.begin(); }
+  const_iterator cend() const { return items_.end(); }
+
+  bool empty() const { return items_.empty(); }
+  size_type size() const { return items_.size(); }
+  size_type capacity() const { return items_.capacity(); }
+  void reserve(size_type n) { items_.reserve(n); }
+  void clear() { items_.clear(); }
+  void swap(TFlatTree& other) { items_.swap(other.items_); }
+
+  const_iterator lower_bound(const key_type& key) const {
+    return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+  }
+
+  const_iterator find(const key_type& key) const {
+    const_iterator it = lower_bound(key);
+    return (it != items_.end() && !Compare()(key, KeyOf()(*it))) ? it : items_.end();
+  }
+
+  size_type count(const key_type& key) const { return find(key) != items_.end() ? 1 : 0; }
+
+  size_type erase(const key_type& key) {
+    const_iterator it = find(key);
+    if (it == items_.end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  const_iterator erase(const_iterator pos) {
+    return items_.erase(items_.begin() + (pos - items_.cbegin()));
+  }
+
+  /**
+   * Sorts the elements added with appendUnsorted().  Of several elements
+   * with the same key the last one added is kept, like repeated
+   * assignments to a std::map.  Input that is already sorted, which is
+   * what a peer iterating over a std::map writes, is only checked.
+   */
+  void sortAppended() {
+    if (std::is_sorted(items_.begin(), items_.end(), ValueLess())) {
+      dedup();
+      return;
+    }
+    std::stable_sort(items_.begin(), items_.end(), ValueLess());
+    dedup();
+  }
+
+  bool operator==(const TFlatTree& other) const { return items_ == other.items_; }
+  bool operator!=(const TFlatTree& other) const { return items_ != other.items_; }
+  bool operator<(const TFlatTree& other) const { return items_ < other.items_; }
+
+protected:
+  struct KeyLess {
+    bool operator()(const value_type& value, const key_type& key) const {
+      return Compare()(KeyOf()(value), key);
+    }
+  };
+
+  struct ValueLess {
+    bool operator()(const value_type& a, const value_type& b) const {
+      return Compare()(KeyOf()(a), KeyOf()(b));
+    }
+  };
+
+  typename storage_type::iterator mutableLowerBound(const key_type& key) {
+    return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+  }
+
+  bool matches(typename storage_type::iterator it, const key_type& key) const {
+    return it != items_.end() && !Compare()(key, KeyOf()(*it));
+  }
+
+  void dedup() {
+    if (items_.size() < 2) {
+      return;
+    }
+    // Keep the last of each run of equal keys
+    typename storage_type::iterator out = items_.begin();
+    for (typename storage_type::iterator it = items_.begin() + 1; it != items_.end(); ++it) {
+      if (Compare()(KeyOf()(*out), KeyOf()(*it))) {
+        ++out;
+      }
+      if (out != it) {
+        *out = std::move(*it);
+      }
+    }
+    items_.erase(out + 1, items_.end());
+  }
+
+  storage_type items_;
+};
+
+template <class K, class V>
+struct PairFirst {
+  const K& operator()(const std::pair<K, V>& value) const { return value.first; }
+};
+
+template <class T>
+struct Identity {
+  const T& operator()(const T& value) const { return value; }
+};
+
+} // namespace detail
+
+/**
+ * Map stored as a vector of pairs sorted by key.  Lookups are binary
+ * searches over contiguous memory and a decoded map costs a single
+ * allocation.  Inserting into the middle is linear, so it suits maps that
+ * are read or built once and then looked up.
+ */
+template <class K,
+          class V,
+          class Compare = std::less<K>,
+          class Alloc = std::allocator<std::pair<K, V> > >
+class TFlatMap
+  : public detail::TFlatTree<std::pair<K, V>, K, detail::PairFirst<K, V>, Compare, Alloc> {
+  typedef detail::TFlatTree<std::pair<K, V>, K, detail::PairFirst<K, V>, Compare, Alloc> Base;
+
+public:
+  typedef V mapped_type;
+  typedef typename Base::value_type value_type;
+  typedef typename Base::const_iterator const_iterator;
+  typedef typename Base::storage_type::iterator iterator;
+  typedef typename Base::allocator_type allocator_type;
+
+  TFlatMap() {}
+  explicit TFlatMap(const allocator_type& alloc) : Base(alloc) {}
+  TFlatMap(const TFlatMap& other, const allocator_type& alloc) : Base(other, alloc) {}
+  TFlatMap(TFlatMap&& other, const allocator_type& alloc) : Base(std::move(other), alloc) {}
+  TFlatMap(const TFlatMap&) = default;
+  TFlatMap(TFlatMap&&) = default;
+  TFlatMap& operator=(const TFlatMap&) = default;
+  TFlatMap& operator=(TFlatMap&&) = default;
+
+  using Base::begin;
+  using Base::end;
+  using Base::erase;
+  using Base::find;
+
+  iterator begin() { return this->items_.begin(); }
+  iterator end() { return this->items_.end(); }
+
+  iterator find(const K& key) {
+    iterator it = this->mutableLowerBound(key);
+    return this->matches(it, key) ? it : this->items_.end();
+  }
+
+  V& operator[](const K& key) {
+    iterator it = this->mutableLowerBound(key);
+    if (!this->matches(it, key)) {
+      it = this->items_.insert(it, value_type(key, V()));
+    }
+    return it->second;
+  }
+
+  V& at(const K& key) {
+    iterator it = find(key);
+    if (it == this->items_.end()) {
+      throw std::out_of_range("TFlatMap::at");
+    }
+    return it->second;
+  }
+
+  const V& at(const K& key) const {
+    const_iterator it = find(key);
+    if (it == this->items_.end()) {
+      throw std::out_of_range("TFlatMap::at");
+    }
+    return it->second;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return insertValue(value_type(value));
+  }
+
+  std::pair<iterator, bool> insert(value_type&& value) { return insertValue(std::move(value)); }
+
+  /**
+   * Adds an element without keeping the order, for building a map from
+   * decoded input in one pass.  sortAppended() must be called before the
+   * map is used again.
+   */
+  V& appendUnsorted(const K& key) {
+    this->items_.push_back(value_type(key, V()));
+    return this->items_.back().second;
+  }
+
+  V& appendUnsorted(K&& key) {
+    this->items_.push_back(value_type(std::move(key), V()));
+    return this->items_.back().second;
+  }
+
+private:
+  std::pair<iterator, bool> insertValue(value_type&& value) {
+    iterator it = this->mutableLowerBound(value.first);
+    if (this->matches(it, value.first)) {
+      return std::make_pair(it, false);
+    }
+    return std::make_pair(this->items_.insert(it, std::move(value)), true);
+  }
+};
+
+/**
+ * Set stored as a sorted vector, the counterpart of TFlatMap.
+ */
+template <class T, class Compare = std::less<T>, class Alloc = std::allocator<T> >
+class TFlatSet : public detail::TFlatTree<T, T, detail::Identity<T>, Compare, Alloc> {
+  typedef detail::TFlatTree<T, T, detail::Identity<T>, Compare, Alloc> Base;
+
+public:
+  typedef typename Base::const_iterator iterator;
+  typedef typename Base::const_iterator const_iterator;
+  typedef typename Base::allocator_type allocator_type;
+
+  TFlatSet() {}
+  explicit TFlatSet(const allocator_type& alloc) : Base(alloc) {}
+  TFlatSet(const TFlatSet& other, const allocator_type& alloc) : Base(other, alloc) {}
+  TFlatSet(TFlatSet&& other, const allocator_type& alloc) : Base(std::move(other), alloc) {}
+  TFlatSet(const TFlatSet&) = default;
+  TFlatSet(TFlatSet&&) = default;
+  TFlatSet& operator=(const TFlatSet&) = default;
+  TFlatSet& operator=(TFlatSet&&) = default;
+
+  std::pair<iterator, bool> insert(const T& value) { return insertValue(T(value)); }
+
+  std::pair<iterator, bool> insert(T&& value) { return insertValue(std::move(value)); }
+
+  /**
+   * Adds an element without keeping the order; see TFlatMap::appendUnsorted().
+   */
+  void appendUnsorted(const T& value) { this->items_.push_back(value); }
+
+  void appendUnsorted(T&& value) { this->items_.push_back(std::move(value)); }
+
+private:
+  std::pair<iterator, bool> insertValue(T&& value) {
+    typename Base::storage_type::iterator it = this->mutableLowerBound(value);
+    if (this->matches(it, value)) {
+      return std::make_pair(iterator(it), false);
+    }
+    return std::make_pair(iterator(this->items_.insert(it, std::move(value))), true);
+  }
+};
+
+#ifdef THRIFT_HAS_MEMORY_RESOURCE
+namespace pmr {
+template <class K, class V, class Compare = std::less<K> >
+using TFlatMap
+    = ::apache::thrift::TFlatMap<K, V, Compare, std::pmr::polymorphic_allocator<std::pair<K, V> > >;
+
+template <class T, class Compare = std::less<T> >
+using TFlatSet = ::apache::thrift::TFlatSet<T, Compare, std::pmr::polymorphic_allocator<T> >;
+} // namespace pmr
+#endif
+
+template <class K, class V, class C, class A>
+std::string to_string(const TFlatMap<K, V, C, A>& m) {
+  std::ostringstream o;
+  o << "{" << to_string(m.begin(), m.end()) << "}";
+  return o.str();
+}
+
+template <class T, class C, class A>
+std::string to_string(const TFlatSet<T, C, A>& s) {
+  std::ostringstream o;
+  o << "{" << to_string(s.begin(), s.end()) << "}";
+  return o.str();
+}
+}
+} // apache::thrift
+
+#endif // _THRIFT_TCONTAINERS_H_
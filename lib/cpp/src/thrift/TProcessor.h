@@ -20,6 +20,7 @@
 #ifndef _THRIFT_TPROCESSOR_H_
 #define _THRIFT_TPROCESSOR_H_ 1
 
+#include <memory>
 #include <string>
 #include <thrift/protocol/TProtocol.h>
 
@@ -130,6 +131,51 @@ private:
   const char* method_;
 };
 
+/**
+ * A helper class used by the code generated with cpp:reuse_objects to lend a
+ * call the args or result object its thread keeps from one call to the
+ * next, cleared.  The thread has one such object per type, so a call made
+ * while it is lent, by a handler calling into a processor of the same
+ * service, gets an object of its own instead.
+ */
+template <class T>
+class TReusedObject {
+public:
+  TReusedObject() : lent_(!inUse()) {
+    if (lent_) {
+      inUse() = true;
+      object_ = &kept();
+      object_->__clear();
+    } else {
+      own_.reset(new T());
+      object_ = own_.get();
+    }
+  }
+  ~TReusedObject() {
+    if (lent_) {
+      inUse() = false;
+    }
+  }
+  TReusedObject(const TReusedObject&) = delete;
+  TReusedObject& operator=(const TReusedObject&) = delete;
+
+  T& get() { return *object_; }
+
+private:
+  static T& kept() {
+    static thread_local T object;
+    return object;
+  }
+  static bool& inUse() {
+    static thread_local bool lent = false;
+    return lent;
+  }
+
+  bool lent_;
+  T* object_;
+  std::unique_ptr<T> own_;
+};
+
 /**
  * A processor is a generic object that acts upon two streams of data, one
  * an input and the other an output. The definition of this object is loose,
@@ -23,7 +23,10 @@
 #include <thrift/protocol/TProtocolDecorator.h>
 #include <thrift/TApplicationException.h>
 #include <thrift/TProcessor.h>
-#include <boost/tokenizer.hpp>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -37,10 +40,10 @@ namespace protocol {
 class StoredMessageProtocol : public TProtocolDecorator {
 public:
   StoredMessageProtocol(std::shared_ptr<protocol::TProtocol> _protocol,
-                        const std::string& _name,
+                        std::string _name,
                         const TMessageType _type,
                         const int32_t _seqid)
-    : TProtocolDecorator(_protocol), name(_name), type(_type), seqid(_seqid) {}
+    : TProtocolDecorator(_protocol), name(std::move(_name)), type(_type), seqid(_seqid) {}
 
   uint32_t readMessageBegin_virt(std::string& _name, TMessageType& _type, int32_t& _seqid) override {
 
@@ -85,8 +88,6 @@ public:
  */
 class TMultiplexedProcessor : public TProcessor {
 public:
-  typedef std::map<std::string, std::shared_ptr<TProcessor> > services_t;
-
   /**
     * 'Register' a service with this <code>TMultiplexedProcessor</code>.  This
     * allows us to broker requests to individual services by using the service
@@ -99,7 +100,15 @@ public:
     *                         implementing WeatherReportIf interface.
     */
   void registerProcessor(const std::string& serviceName, std::shared_ptr<TProcessor> processor) {
-    services[serviceName] = processor;
+    for (Service& service : services) {
+      if (service.name == serviceName) {
+        service.processor = processor;
+        return;
+      }
+    }
+    Service service = {serviceName, hashName(serviceName.data(), serviceName.size()), processor};
+    services.push_back(service);
+    rebuildIndex();
   }
 
   /**
@@ -143,6 +152,9 @@ public:
    *         that allows readMessageBegin() to return the original TMessage.</li>
    * </ol>
    *
+   * The decorated protocol lives on the stack of this call, so processors
+   * must not keep it once they return.
+   *
    * \throws TException If the message type is not T_CALL or T_ONEWAY, if
    * the service name was not found in the message, or if the service
    * name was not found in the service map.
@@ -164,41 +176,48 @@ public:
       throw protocol_error(in, out, name, seqid, "Unexpected message type");
     }
 
-    // Extract the service name
-    boost::tokenizer<boost::char_separator<char> > tok(name, boost::char_separator<char>(":"));
-
-    std::vector<std::string> tokens;
-    std::copy(tok.begin(), tok.end(), std::back_inserter(tokens));
+    // Extract the service name.  Tokens are separated by ':', and empty
+    // tokens are ignored.
+    size_t tokenStart[2] = {0, 0};
+    size_t tokenSize[2] = {0, 0};
+    size_t tokens = 0;
+    for (size_t pos = 0; pos < name.size();) {
+      size_t end = name.find(':', pos);
+      if (end == std::string::npos) {
+        end = name.size();
+      }
+      if (end > pos) {
+        if (tokens < 2) {
+          tokenStart[tokens] = pos;
+          tokenSize[tokens] = end - pos;
+        }
+        tokens++;
+      }
+      pos = end + 1;
+    }
 
     // A valid message should consist of two tokens: the service
     // name and the name of the method to call.
-    if (tokens.size() == 2) {
+    if (tokens == 2) {
       // Search for a processor associated with this service name.
-      auto it = services.find(tokens[0]);
+      const Service* service = findService(name.data() + tokenStart[0], tokenSize[0]);
 
-      if (it != services.end()) {
-        std::shared_ptr<TProcessor> processor = it->second;
+      if (service) {
         // Let the processor registered for this service name
         // process the message.
-        return processor
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[1], type, seqid)),
-                      out,
-                      connectionContext);
+        return processStored(*service->processor, in, out, name, tokenStart[1], tokenSize[1],
+                             type, seqid, connectionContext);
       } else {
         // Unknown service.
         throw protocol_error(in, out, name, seqid, 
-            "Unknown service: " + tokens[0] +
+            "Unknown service: " + name.substr(tokenStart[0], tokenSize[0]) +
 				". Did you forget to call registerProcessor()?");
       }
-    } else if (tokens.size() == 1) {
+    } else if (tokens == 1) {
 	  if (defaultProcessor) {
         // non-multiplexed client forwards to default processor
-        return defaultProcessor            
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[0], type, seqid)),
-                      out,
-                      connectionContext);
+        return processStored(*defaultProcessor, in, out, name, tokenStart[0], tokenSize[0],
+                             type, seqid, connectionContext);
 	  } else {
 		throw protocol_error(in, out, name, seqid,
 			"Non-multiplexed client request dropped. "
@@ -211,8 +230,80 @@ public:
   }
 
 private:
-  /** Map of service processor objects, indexed by service names. */
-  services_t services;
+  struct Service {
+    std::string name;
+    size_t hash;
+    std::shared_ptr<TProcessor> processor;
+  };
+
+  // FNV-1a
+  static size_t hashName(const char* name, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    }
+    return hash;
+  }
+
+  /**
+   * Open addressing table of indexes into services, at most half full.
+   */
+  void rebuildIndex() {
+    size_t slots = 4;
+    while (slots < services.size() * 2) {
+      slots *= 2;
+    }
+    serviceIndex.assign(slots, -1);
+    for (size_t i = 0; i < services.size(); i++) {
+      size_t slot = services[i].hash & (slots - 1);
+      while (serviceIndex[slot] >= 0) {
+        slot = (slot + 1) & (slots - 1);
+      }
+      serviceIndex[slot] = static_cast<int32_t>(i);
+    }
+  }
+
+  const Service* findService(const char* name, size_t size) const {
+    if (serviceIndex.empty()) {
+      return nullptr;
+    }
+    size_t hash = hashName(name, size);
+    size_t mask = serviceIndex.size() - 1;
+    for (size_t slot = hash & mask; serviceIndex[slot] >= 0; slot = (slot + 1) & mask) {
+      const Service& service = services[serviceIndex[slot]];
+      if (service.hash == hash && service.name.size() == size
+          && memcmp(service.name.data(), name, size) == 0) {
+        return &service;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * Hands the message to processor with name cut down to the method name.
+   */
+  static bool processStored(TProcessor& processor,
+                            const std::shared_ptr<protocol::TProtocol>& in,
+                            const std::shared_ptr<protocol::TProtocol>& out,
+                            std::string& name,
+                            size_t methodStart,
+                            size_t methodSize,
+                            protocol::TMessageType type,
+                            int32_t seqid,
+                            void* connectionContext) {
+    name.erase(methodStart + methodSize);
+    name.erase(0, methodStart);
+    protocol::StoredMessageProtocol stored(in, std::move(name), type, seqid);
+    // Shares ownership with in rather than allocating a control block
+    std::shared_ptr<protocol::TProtocol> storedPtr(in, &stored);
+    return processor.process(storedPtr, out, connectionContext);
+  }
+
+  /** Registered services, in registration order. */
+  std::vector<Service> services;
+
+  /** Hash table of service names, indexing services. */
+  std::vector<int32_t> serviceIndex;
   
   //! If a non-multi client requests something, it goes to the
   //! default processor (if one is defined) for backwards compatibility.
@@ -19,6 +19,11 @@
 
 #include <thrift/protocol/TBase64Utils.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define THRIFT_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
 using std::string;
 
 namespace apache {
@@ -310,6 +315,249 @@ void base64_decode(uint8_t* buf, uint32_t len) {
     }
   }
 }
+
+namespace {
+
+uint32_t encodeScalar(const uint8_t* in, uint32_t len, uint8_t* out) {
+  uint8_t* start = out;
+  while (len >= 3) {
+    base64_encode(in, 3, out);
+    in += 3;
+    out += 4;
+    len -= 3;
+  }
+  if (len) {
+    base64_encode(in, len, out);
+    out += len + 1;
+  }
+  return static_cast<uint32_t>(out - start);
+}
+
+uint32_t decodeScalar(uint8_t* in, uint32_t len, uint8_t* out) {
+  uint8_t* start = out;
+  while (len >= 4) {
+    base64_decode(in, 4);
+    // out never runs ahead of in, so the overlap is harmless
+    out[0] = in[0];
+    out[1] = in[1];
+    out[2] = in[2];
+    in += 4;
+    out += 3;
+    len -= 4;
+  }
+  if (len > 1) {
+    base64_decode(in, len);
+    for (uint32_t i = 0; i < len - 1; ++i) {
+      out[i] = in[i];
+    }
+    out += len - 1;
+  }
+  return static_cast<uint32_t>(out - start);
+}
+
+#ifdef THRIFT_BASE64_X86
+
+// The vector codecs follow Wojciech Mula's SIMD base64 algorithms: bytes
+// are spread into 6-bit indices with multiplies, and characters are mapped
+// to and from indices by a per-range offset looked up with pshufb.  Input
+// that holds anything but base64 characters is left to the scalar code.
+
+__attribute__((target("sse4.1"))) __m128i encodeIndicesSse(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                               _mm_set1_epi32(0x04000040));
+  __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                               _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t0, t1);
+}
+
+__attribute__((target("sse4.1"))) __m128i encodeCharsSse(__m128i indices) {
+  __m128i offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  offsets = _mm_or_si128(offsets, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_mm_shuffle_epi8(shift, offsets), indices);
+}
+
+__attribute__((target("sse4.1"))) uint32_t encodeSse(const uint8_t* in,
+                                                     uint32_t len,
+                                                     uint8_t* out) {
+  uint8_t* start = out;
+  // Each step reads 16 bytes and encodes the first 12
+  while (len >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), encodeCharsSse(encodeIndicesSse(chunk)));
+    in += 12;
+    out += 16;
+    len -= 12;
+  }
+  return static_cast<uint32_t>(out - start) + encodeScalar(in, len, out);
+}
+
+// Returns the 6-bit values of 16 base64 characters, or sets *valid to false
+__attribute__((target("sse4.1"))) __m128i decodeValuesSse(__m128i in, bool* valid) {
+  __m128i high = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+  __m128i low = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+  // Valid high nibbles for each low nibble, as a bitmask
+  __m128i validHigh = _mm_setr_epi8(
+      (char)0xa8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,
+      (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54);
+  __m128i highBit = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0, 0, 0,
+                                  0, 0, 0, 0, 0);
+  __m128i bits = _mm_and_si128(_mm_shuffle_epi8(validHigh, low),
+                               _mm_shuffle_epi8(highBit, high));
+  *valid = _mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128())) == 0;
+
+  __m128i shift = _mm_shuffle_epi8(_mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0,
+                                                 0, 0, 0),
+                                   high);
+  shift = _mm_blendv_epi8(shift, _mm_set1_epi8(16), _mm_cmpeq_epi8(in, _mm_set1_epi8('/')));
+  return _mm_add_epi8(in, shift);
+}
+
+// Packs 16 6-bit values into 12 bytes at the bottom of the register
+__attribute__((target("sse4.1"))) __m128i decodePackSse(__m128i values) {
+  __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(words,
+                          _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("sse4.1"))) uint32_t decodeSse(uint8_t* in, uint32_t len, uint8_t* out) {
+  uint8_t* start = out;
+  while (len >= 16) {
+    bool valid;
+    __m128i values = decodeValuesSse(_mm_loadu_si128(reinterpret_cast<__m128i*>(in)), &valid);
+    if (!valid) {
+      break;
+    }
+    // The 16-byte store stays within the input just read
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), decodePackSse(values));
+    in += 16;
+    out += 12;
+    len -= 16;
+  }
+  return static_cast<uint32_t>(out - start) + decodeScalar(in, len, out);
+}
+
+__attribute__((target("avx2"))) uint32_t encodeAvx2(const uint8_t* in,
+                                                    uint32_t len,
+                                                    uint8_t* out) {
+  uint8_t* start = out;
+  const __m256i reshuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i shift = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+      'A', 0, 0);
+  // Each step reads 28 bytes and encodes the first 24, 12 per lane
+  while (len >= 28) {
+    __m256i chunk = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+    chunk = _mm256_shuffle_epi8(chunk, reshuffle);
+    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(chunk, _mm256_set1_epi32(0x0fc0fc00)),
+                                    _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(chunk, _mm256_set1_epi32(0x003f03f0)),
+                                    _mm256_set1_epi32(0x01000010));
+    __m256i indices = _mm256_or_si256(t0, t1);
+    __m256i offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    offsets = _mm256_or_si256(offsets, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                        _mm256_add_epi8(_mm256_shuffle_epi8(shift, offsets), indices));
+    in += 24;
+    out += 32;
+    len -= 24;
+  }
+  return static_cast<uint32_t>(out - start) + encodeSse(in, len, out);
+}
+
+__attribute__((target("avx2"))) uint32_t decodeAvx2(uint8_t* in, uint32_t len, uint8_t* out) {
+  uint8_t* start = out;
+  const __m256i validHigh = _mm256_setr_epi8(
+      (char)0xa8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,
+      (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54, (char)0xa8,
+      (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,
+      (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54);
+  const __m256i highBit = _mm256_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0,
+                                           0, 0, 0, 0, 0, 0, 0, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+                                           0x40, (char)0x80, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i shiftLut = _mm256_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0,
+                                            0, 0);
+  const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  while (len >= 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i*>(in));
+    __m256i high = _mm256_and_si256(_mm256_srli_epi32(chunk, 4), _mm256_set1_epi8(0x0f));
+    __m256i low = _mm256_and_si256(chunk, _mm256_set1_epi8(0x0f));
+    __m256i bits = _mm256_and_si256(_mm256_shuffle_epi8(validHigh, low),
+                                    _mm256_shuffle_epi8(highBit, high));
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(bits, _mm256_setzero_si256())) != 0) {
+      break;
+    }
+    __m256i shift = _mm256_blendv_epi8(_mm256_shuffle_epi8(shiftLut, high),
+                                       _mm256_set1_epi8(16),
+                                       _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')));
+    __m256i values = _mm256_add_epi8(chunk, shift);
+    __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, pack),
+                                                 _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    // The 32-byte store stays within the input just read
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+    in += 32;
+    out += 24;
+    len -= 32;
+  }
+  return static_cast<uint32_t>(out - start) + decodeSse(in, len, out);
+}
+
+#endif // THRIFT_BASE64_X86
+
+typedef uint32_t (*EncodeFunction)(const uint8_t*, uint32_t, uint8_t*);
+typedef uint32_t (*DecodeFunction)(uint8_t*, uint32_t, uint8_t*);
+
+EncodeFunction selectEncode() {
+#ifdef THRIFT_BASE64_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return encodeAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return encodeSse;
+  }
+#endif
+  return encodeScalar;
+}
+
+DecodeFunction selectDecode() {
+#ifdef THRIFT_BASE64_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return decodeAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return decodeSse;
+  }
+#endif
+  return decodeScalar;
+}
+}
+
+uint32_t base64_encode_block(const uint8_t* in, uint32_t len, uint8_t* out) {
+  static const EncodeFunction encode = selectEncode();
+  return encode(in, len, out);
+}
+
+uint32_t base64_decode_block(uint8_t* buf, uint32_t len) {
+  static const DecodeFunction decode = selectDecode();
+  return decode(buf, len, buf);
+}
 }
 }
 } // apache::thrift::protocol
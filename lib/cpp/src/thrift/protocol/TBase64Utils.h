@@ -38,6 +38,18 @@ void base64_encode(const uint8_t* in, uint32_t len, uint8_t* buf);
 // len is number of bytes to consume from input (must be 2, 3, or 4)
 // no '=' padding should be included in the input
 void base64_decode(uint8_t* buf, uint32_t len);
+
+// Encodes all len bytes of in into out and returns the number of characters
+// written, (len * 4 + 2) / 3.  out must have room for that many and may not
+// overlap in; the data is not padded with '='.
+// Uses SSE4.1 or AVX2 when the CPU supports them.
+uint32_t base64_encode_block(const uint8_t* in, uint32_t len, uint8_t* out);
+
+// Decodes len base64 characters of buf in place and returns the number of
+// bytes written to the start of buf.  No '=' padding should be included in
+// the input, and a single trailing character is ignored.
+// Uses SSE4.1 or AVX2 when the CPU supports them.
+uint32_t base64_decode_block(uint8_t* buf, uint32_t len);
 }
 }
 } // apache::thrift::protocol
@@ -121,6 +121,20 @@ public:
 
   inline uint32_t writeUUID(const TUuid& uuid);
 
+  inline uint32_t writeStringView(const uint8_t* data, uint32_t size);
+
+  inline uint32_t writeBinaryView(const uint8_t* data, uint32_t size);
+
+  inline uint32_t writeByteArray(const int8_t* values, const uint32_t count);
+
+  inline uint32_t writeI16Array(const int16_t* values, const uint32_t count);
+
+  inline uint32_t writeI32Array(const int32_t* values, const uint32_t count);
+
+  inline uint32_t writeI64Array(const int64_t* values, const uint32_t count);
+
+  inline uint32_t writeDoubleArray(const double* values, const uint32_t count);
+
   /**
    * Reading functions
    */
@@ -170,6 +184,77 @@ public:
 
   inline uint32_t readUUID(TUuid& uuid);
 
+  inline uint32_t readStringView(const uint8_t*& data, uint32_t& size);
+
+  inline uint32_t readBinaryView(const uint8_t*& data, uint32_t& size);
+
+  inline uint32_t readStringInto(TStringSink& sink);
+
+  inline uint32_t readBinaryInto(TStringSink& sink);
+
+  inline uint32_t readByteArray(int8_t* values, const uint32_t count);
+
+  inline uint32_t readI16Array(int16_t* values, const uint32_t count);
+
+  inline uint32_t readI32Array(int32_t* values, const uint32_t count);
+
+  inline uint32_t readI64Array(int64_t* values, const uint32_t count);
+
+  inline uint32_t readDoubleArray(double* values, const uint32_t count);
+
+  /**
+   * Skip a value without decoding it.  Fixed-width values, string bodies
+   * and containers of fixed-width elements are dropped in one step.
+   */
+  uint32_t skip(TType type);
+
+  int32_t getRawProtocolId();
+
+  uint32_t readRawValue(TType type, std::string& bytes);
+
+  uint32_t writeRawValue(const std::string& bytes);
+
+  /**
+   * Encoded sizes of values, used by the generated serializedSize() to
+   * presize output buffers.  Every value has a fixed-size encoding, so the
+   * sizes are exact.
+   */
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType,
+                                      const int32_t) const {
+    return (this->strict_write_ ? 12 : 9) + static_cast<uint32_t>(name.size());
+  }
+
+  static uint32_t serializedSizeFieldBegin(const TType, const int16_t, const int16_t) {
+    return 3;
+  }
+
+  static uint32_t serializedSizeStop() { return 1; }
+
+  static uint32_t serializedSizeMapBegin(const TType, const TType, const uint32_t) { return 6; }
+
+  static uint32_t serializedSizeListBegin(const TType, const uint32_t) { return 5; }
+
+  static uint32_t serializedSizeSetBegin(const TType, const uint32_t) { return 5; }
+
+  static uint32_t serializedSizeBool(const bool) { return 1; }
+
+  static uint32_t serializedSizeByte(const int8_t) { return 1; }
+
+  static uint32_t serializedSizeI16(const int16_t) { return 2; }
+
+  static uint32_t serializedSizeI32(const int32_t) { return 4; }
+
+  static uint32_t serializedSizeI64(const int64_t) { return 8; }
+
+  static uint32_t serializedSizeDouble(const double) { return 8; }
+
+  static uint32_t serializedSizeString(const uint32_t size) { return 4 + size; }
+
+  static uint32_t serializedSizeBinary(const uint32_t size) { return 4 + size; }
+
+  static uint32_t serializedSizeUUID() { return 16; }
+
   int getMinSerializedSize(TType type) override;
 
   void checkReadBytesAvailable(TSet& set) override
@@ -192,6 +277,21 @@ protected:
   template <typename StrType>
   uint32_t readStringBody(StrType& str, int32_t sz);
 
+  static uint32_t fixedWireSize(TType type);
+
+  template <typename Wire_>
+  uint32_t readFixedArray(void* values, const uint32_t count);
+
+  template <typename Wire_>
+  uint32_t writeFixedArray(const void* values, const uint32_t count);
+
+  static uint16_t toWire(uint16_t x) { return ByteOrder_::toWire16(x); }
+  static uint32_t toWire(uint32_t x) { return ByteOrder_::toWire32(x); }
+  static uint64_t toWire(uint64_t x) { return ByteOrder_::toWire64(x); }
+  static uint16_t fromWire(uint16_t x) { return ByteOrder_::fromWire16(x); }
+  static uint32_t fromWire(uint32_t x) { return ByteOrder_::fromWire32(x); }
+  static uint64_t fromWire(uint64_t x) { return ByteOrder_::fromWire64(x); }
+
   Transport_* trans_;
 
   int32_t string_limit_;
@@ -234,6 +334,14 @@ public:
     strict_write_ = strict_write;
   }
 
+  int32_t getStringSizeLimit() const { return string_limit_; }
+
+  int32_t getContainerSizeLimit() const { return container_limit_; }
+
+  bool getStrictRead() const { return strict_read_; }
+
+  bool getStrictWrite() const { return strict_write_; }
+
   std::shared_ptr<TProtocol> getProtocol(std::shared_ptr<TTransport> trans) override {
     std::shared_ptr<Transport_> specific_trans = std::dynamic_pointer_cast<Transport_>(trans);
     TProtocol* prot;
@@ -21,9 +21,14 @@
 #define _THRIFT_PROTOCOL_TBINARYPROTOCOL_TCC_ 1
 
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TProtocolTypes.h>
+#include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TTransportException.h>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <type_traits>
 
 namespace apache {
 namespace thrift {
@@ -175,22 +180,111 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeDouble(const double dub)
   return 8;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeByteArray(const int8_t* values,
+                                                                  const uint32_t count) {
+  if (count > 0) {
+    this->trans_->write(reinterpret_cast<const uint8_t*>(values), count);
+  }
+  return count;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI16Array(const int16_t* values,
+                                                                 const uint32_t count) {
+  return writeFixedArray<uint16_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI32Array(const int32_t* values,
+                                                                 const uint32_t count) {
+  return writeFixedArray<uint32_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI64Array(const int64_t* values,
+                                                                 const uint32_t count) {
+  return writeFixedArray<uint64_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeDoubleArray(const double* values,
+                                                                    const uint32_t count) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "sizeof(double) == sizeof(uint64_t)");
+  static_assert(std::numeric_limits<double>::is_iec559, "std::numeric_limits<double>::is_iec559");
+  return writeFixedArray<uint64_t>(values, count);
+}
+
+/**
+ * Write count fixed-width values.  When the wire byte order matches the
+ * host the array goes to the transport as is; otherwise it is swapped
+ * through a stack buffer so the transport sees a few large writes instead
+ * of one per element.
+ */
+template <class Transport_, class ByteOrder_>
+template <typename Wire_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeFixedArray(const void* values,
+                                                                   const uint32_t count) {
+  if (count > (std::numeric_limits<uint32_t>::max)() / sizeof(Wire_)) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  if (count == 0) {
+    return 0;
+  }
+  const uint32_t size = count * static_cast<uint32_t>(sizeof(Wire_));
+  const auto* src = static_cast<const uint8_t*>(values);
+
+  if (toWire(static_cast<Wire_>(1)) == 1) {
+    this->trans_->write(src, size);
+    return size;
+  }
+
+  uint8_t buf[512];
+  const uint32_t chunk = sizeof(buf) / sizeof(Wire_);
+  for (uint32_t done = 0; done < count; ) {
+    uint32_t n = (std::min)(chunk, count - done);
+    for (uint32_t i = 0; i < n; ++i) {
+      Wire_ w;
+      std::memcpy(&w, src + (done + i) * sizeof(Wire_), sizeof(Wire_));
+      w = toWire(w);
+      std::memcpy(buf + i * sizeof(Wire_), &w, sizeof(Wire_));
+    }
+    this->trans_->write(buf, n * static_cast<uint32_t>(sizeof(Wire_)));
+    done += n;
+  }
+  return size;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeString(const StrType& str) {
   if (str.size() > static_cast<size_t>((std::numeric_limits<int32_t>::max)()))
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  auto size = static_cast<uint32_t>(str.size());
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeStringView((const uint8_t*)str.data(),
+                                                                   (uint32_t)str.size());
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinary(const std::string& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeStringView(const uint8_t* data,
+                                                                   uint32_t size) {
+  if (size > static_cast<uint32_t>((std::numeric_limits<int32_t>::max)()))
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
   uint32_t result = writeI32((int32_t)size);
   if (size > 0) {
-    this->trans_->write((uint8_t*)str.data(), size);
+    this->trans_->write(data, size);
   }
   return result + size;
 }
 
 template <class Transport_, class ByteOrder_>
-uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinary(const std::string& str) {
-  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinaryView(const uint8_t* data,
+                                                                   uint32_t size) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeStringView(data, size);
 }
 
 template <class Transport_, class ByteOrder_>
@@ -421,6 +515,85 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readDouble(double& dub) {
   return 8;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readByteArray(int8_t* values,
+                                                                 const uint32_t count) {
+  if (count > 0) {
+    this->trans_->readAll(reinterpret_cast<uint8_t*>(values), count);
+  }
+  return count;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI16Array(int16_t* values,
+                                                                const uint32_t count) {
+  return readFixedArray<uint16_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI32Array(int32_t* values,
+                                                                const uint32_t count) {
+  return readFixedArray<uint32_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI64Array(int64_t* values,
+                                                                const uint32_t count) {
+  return readFixedArray<uint64_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readDoubleArray(double* values,
+                                                                   const uint32_t count) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "sizeof(double) == sizeof(uint64_t)");
+  static_assert(std::numeric_limits<double>::is_iec559, "std::numeric_limits<double>::is_iec559");
+  return readFixedArray<uint64_t>(values, count);
+}
+
+/**
+ * Read count fixed-width values.  If the transport can lend the whole
+ * array it is byte-swapped straight out of the borrowed memory; otherwise
+ * it is read into place with a single readAll() and swapped there.  The
+ * swap loop has no calls or bounds checks, so the compiler can vectorise it.
+ */
+template <class Transport_, class ByteOrder_>
+template <typename Wire_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readFixedArray(void* values,
+                                                                  const uint32_t count) {
+  if (count > (std::numeric_limits<uint32_t>::max)() / sizeof(Wire_)) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  if (count == 0) {
+    return 0;
+  }
+  uint32_t size = count * static_cast<uint32_t>(sizeof(Wire_));
+  auto* dst = static_cast<uint8_t*>(values);
+
+  uint32_t got = size;
+  const uint8_t* src = this->trans_->borrow(nullptr, &got);
+  if (src != nullptr) {
+    for (uint32_t i = 0; i < count; ++i) {
+      Wire_ w;
+      std::memcpy(&w, src + i * sizeof(Wire_), sizeof(Wire_));
+      w = fromWire(w);
+      std::memcpy(dst + i * sizeof(Wire_), &w, sizeof(Wire_));
+    }
+    this->trans_->consume(size);
+    return size;
+  }
+
+  this->trans_->readAll(dst, size);
+  if (fromWire(static_cast<Wire_>(1)) != 1) {
+    for (uint32_t i = 0; i < count; ++i) {
+      Wire_ w;
+      std::memcpy(&w, dst + i * sizeof(Wire_), sizeof(Wire_));
+      w = fromWire(w);
+      std::memcpy(dst + i * sizeof(Wire_), &w, sizeof(Wire_));
+    }
+  }
+  return size;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readString(StrType& str) {
@@ -441,6 +614,84 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readUUID(TUuid& uuid) {
   return 16;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringView(const uint8_t*& data,
+                                                                  uint32_t& size) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryView(data, size);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryView(const uint8_t*& data,
+                                                                  uint32_t& size) {
+  int32_t sz;
+  uint32_t result = readI32(sz);
+
+  // Catch error cases
+  if (sz < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (this->string_limit_ > 0 && sz > this->string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  if (sz == 0) {
+    data = nullptr;
+    size = 0;
+    return result;
+  }
+
+  uint32_t got = sz;
+  const uint8_t* borrow_buf = this->trans_->borrow(nullptr, &got);
+  if (!borrow_buf) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "transport cannot lend the whole string for a zero-copy read");
+  }
+  this->trans_->consume(sz);
+  data = borrow_buf;
+  size = (uint32_t)sz;
+  return result + size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringInto(TStringSink& sink) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryInto(sink);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryInto(TStringSink& sink) {
+  int32_t sz;
+  uint32_t result = readI32(sz);
+
+  // Catch error cases
+  if (sz < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (this->string_limit_ > 0 && sz > this->string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  // Catch empty string case
+  if (sz == 0) {
+    sink.resize(0);
+    return result;
+  }
+
+  // Try to borrow first
+  uint32_t got = sz;
+  const uint8_t* borrow_buf = this->trans_->borrow(nullptr, &got);
+  if (borrow_buf) {
+    sink.assign(borrow_buf, (uint32_t)sz);
+    this->trans_->consume(sz);
+    return result + (uint32_t)sz;
+  }
+
+  // Check against MaxMessageSize before alloc
+  this->trans_->checkReadBytesAvailable(sz);
+
+  this->trans_->readAll(sink.resize((uint32_t)sz), sz);
+  return result + (uint32_t)sz;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str, int32_t size) {
@@ -477,6 +728,163 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str,
   return (uint32_t)size;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  switch (type) {
+  case T_STRING: {
+    int32_t size;
+    uint32_t result = readI32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (this->string_limit_ > 0 && size > this->string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return result + skipBytes(*this->trans_, static_cast<uint32_t>(size));
+  }
+  case T_STRUCT: {
+    uint32_t result = 0;
+    std::string name;
+    int16_t fid;
+    TType ftype;
+    result += readStructBegin(name);
+    while (true) {
+      result += readFieldBegin(name, ftype, fid);
+      if (ftype == T_STOP) {
+        break;
+      }
+      result += skip(ftype);
+      result += readFieldEnd();
+    }
+    result += readStructEnd();
+    return result;
+  }
+  case T_MAP: {
+    uint32_t result = 0;
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    result += readMapBegin(keyType, valType, size);
+    uint32_t keySize = fixedWireSize(keyType);
+    uint32_t valSize = fixedWireSize(valType);
+    if (keySize != 0 && valSize != 0) {
+      result += skipBytes(*this->trans_, static_cast<uint64_t>(size) * (keySize + valSize));
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(keyType);
+        result += skip(valType);
+      }
+    }
+    result += readMapEnd();
+    return result;
+  }
+  case T_SET:
+  case T_LIST: {
+    uint32_t result = 0;
+    TType elemType;
+    uint32_t size;
+    result += type == T_SET ? readSetBegin(elemType, size) : readListBegin(elemType, size);
+    uint32_t elemSize = fixedWireSize(elemType);
+    if (elemSize != 0) {
+      result += skipBytes(*this->trans_, static_cast<uint64_t>(size) * elemSize);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(elemType);
+      }
+    }
+    result += type == T_SET ? readSetEnd() : readListEnd();
+    return result;
+  }
+  default: {
+    uint32_t size = fixedWireSize(type);
+    if (size != 0) {
+      return skipBytes(*this->trans_, size);
+    }
+    break;
+  }
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+template <class Transport_, class ByteOrder_>
+int32_t TBinaryProtocolT<Transport_, ByteOrder_>::getRawProtocolId() {
+  // The little-endian variant has no protocol id of its own to tag raw
+  // values with, so it always decodes them.
+  return std::is_same<ByteOrder_, TNetworkBigEndian>::value ? T_BINARY_PROTOCOL : -1;
+}
+
+/**
+ * Capture the next value as raw bytes.  The value is measured by skipping
+ * it over a view of the transport's buffered input; running off the end of
+ * the view means it has not all arrived yet.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readRawValue(TType type, std::string& bytes) {
+  if (getRawProtocolId() < 0) {
+    return 0;
+  }
+  uint32_t avail = 1;
+  const uint8_t* data = this->trans_->borrow(nullptr, &avail);
+  if (data == nullptr) {
+    return 0;
+  }
+
+  std::shared_ptr<transport::TMemoryBuffer> view(
+      new transport::TMemoryBuffer(const_cast<uint8_t*>(data), avail));
+  TBinaryProtocolT<transport::TMemoryBuffer, ByteOrder_> measure(view,
+                                                                 this->string_limit_,
+                                                                 this->container_limit_,
+                                                                 false,
+                                                                 false);
+  uint32_t size;
+  try {
+    size = measure.skip(type);
+  } catch (const transport::TTransportException& e) {
+    if (e.getType() != transport::TTransportException::END_OF_FILE) {
+      throw;
+    }
+    return 0;
+  }
+
+  bytes.assign(reinterpret_cast<const char*>(data), size);
+  this->trans_->consume(size);
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeRawValue(const std::string& bytes) {
+  auto size = static_cast<uint32_t>(bytes.size());
+  this->trans_->write(reinterpret_cast<const uint8_t*>(bytes.data()), size);
+  return size;
+}
+
+/**
+ * Returns the encoded size of a value of the given type if it is the same
+ * for every value, or 0 if the type has a variable-length encoding.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::fixedWireSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_I16:
+    return 2;
+  case T_I32:
+    return 4;
+  case T_I64:
+  case T_DOUBLE:
+    return 8;
+  case T_UUID:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_, class ByteOrder_>
 int TBinaryProtocolT<Transport_, ByteOrder_>::getMinSerializedSize(TType type)
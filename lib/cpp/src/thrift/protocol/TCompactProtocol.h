@@ -79,8 +79,6 @@ public:
       trans_(trans.get()),
       lastFieldId_(0),
       string_limit_(0),
-      string_buf_(nullptr),
-      string_buf_size_(0),
       container_limit_(0) {
     booleanField_.name = nullptr;
     boolValue_.hasBoolValue = false;
@@ -93,14 +91,12 @@ public:
       trans_(trans.get()),
       lastFieldId_(0),
       string_limit_(string_limit),
-      string_buf_(nullptr),
-      string_buf_size_(0),
       container_limit_(container_limit) {
     booleanField_.name = nullptr;
     boolValue_.hasBoolValue = false;
   }
 
-  ~TCompactProtocolT() override { free(string_buf_); }
+  ~TCompactProtocolT() override = default;
 
   /**
    * Writing functions
@@ -142,6 +138,75 @@ public:
 
   uint32_t writeUUID(const TUuid& str);
 
+  uint32_t writeStringView(const uint8_t* data, uint32_t size);
+
+  uint32_t writeBinaryView(const uint8_t* data, uint32_t size);
+
+  uint32_t writeByteArray(const int8_t* values, const uint32_t count);
+
+  uint32_t writeI16Array(const int16_t* values, const uint32_t count);
+
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count);
+
+  /**
+   * Skip a value without decoding it.  Varints are scanned for their
+   * terminating byte rather than decoded, and string bodies and containers
+   * of fixed-width elements are dropped in one step.
+   */
+  uint32_t skip(TType type);
+
+  int32_t getRawProtocolId();
+
+  uint32_t readRawValue(TType type, std::string& bytes);
+
+  uint32_t writeRawValue(const std::string& bytes);
+
+  /**
+   * Encoded sizes of values, used by the generated serializedSize() to
+   * presize output buffers.  The result is an upper bound: bool fields
+   * are counted with a value byte, although the encoding folds it into the
+   * field header.  serializedSizeFieldBegin() takes the id of the field
+   * written before in the same struct, 0 for the first one, as the field
+   * header depends on the difference between the two ids.
+   */
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid);
+
+  uint32_t serializedSizeFieldBegin(const TType fieldType,
+                                    const int16_t fieldId,
+                                    const int16_t lastFieldId);
+
+  uint32_t serializedSizeStop() { return 1; }
+
+  uint32_t serializedSizeMapBegin(const TType keyType, const TType valType, const uint32_t size);
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size);
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size);
+
+  uint32_t serializedSizeBool(const bool) { return 1; }
+
+  uint32_t serializedSizeByte(const int8_t) { return 1; }
+
+  uint32_t serializedSizeI16(const int16_t i16);
+
+  uint32_t serializedSizeI32(const int32_t i32);
+
+  uint32_t serializedSizeI64(const int64_t i64);
+
+  uint32_t serializedSizeDouble(const double) { return 8; }
+
+  uint32_t serializedSizeString(const uint32_t size);
+
+  uint32_t serializedSizeBinary(const uint32_t size) { return serializedSizeString(size); }
+
+  uint32_t serializedSizeUUID() { return 16; }
+
   int getMinSerializedSize(TType type) override;
 
   void checkReadBytesAvailable(TSet& set) override
@@ -178,6 +243,8 @@ protected:
   uint32_t writeCollectionBegin(const TType elemType, int32_t size);
   uint32_t writeVarint32(uint32_t n);
   uint32_t writeVarint64(uint64_t n);
+  template <typename Value_>
+  uint32_t writeVarintArray(const Value_* values, const uint32_t count);
   uint64_t i64ToZigzag(const int64_t l);
   uint32_t i32ToZigzag(const int32_t n);
   inline int8_t getCompactType(const TType ttype);
@@ -217,6 +284,24 @@ public:
 
   uint32_t readUUID(TUuid& str);
 
+  uint32_t readStringView(const uint8_t*& data, uint32_t& size);
+
+  uint32_t readBinaryView(const uint8_t*& data, uint32_t& size);
+
+  uint32_t readStringInto(TStringSink& sink);
+
+  uint32_t readBinaryInto(TStringSink& sink);
+
+  uint32_t readByteArray(int8_t* values, const uint32_t count);
+
+  uint32_t readI16Array(int16_t* values, const uint32_t count);
+
+  uint32_t readI32Array(int32_t* values, const uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, const uint32_t count);
+
+  uint32_t readDoubleArray(double* values, const uint32_t count);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -230,15 +315,16 @@ public:
 protected:
   uint32_t readVarint32(int32_t& i32);
   uint32_t readVarint64(int64_t& i64);
+  template <typename Value_>
+  uint32_t readVarintArray(Value_* values, const uint32_t count);
+  uint32_t skipVarints(uint32_t count);
+  static uint32_t fixedWireSize(TType type);
+  static bool isVarintType(TType type);
   int32_t zigzagToI32(uint32_t n);
   int64_t zigzagToI64(uint64_t n);
   TType getTType(int8_t type);
 
-  // Buffer for reading strings, save for the lifetime of the protocol to
-  // avoid memory churn allocating memory on every string read
   int32_t string_limit_;
-  uint8_t* string_buf_;
-  int32_t string_buf_size_;
   int32_t container_limit_;
 };
 
@@ -261,6 +347,10 @@ public:
 
   void setContainerSizeLimit(int32_t container_limit) { container_limit_ = container_limit; }
 
+  int32_t getStringSizeLimit() const { return string_limit_; }
+
+  int32_t getContainerSizeLimit() const { return container_limit_; }
+
   std::shared_ptr<TProtocol> getProtocol(std::shared_ptr<TTransport> trans) override {
     std::shared_ptr<Transport_> specific_trans = std::dynamic_pointer_cast<Transport_>(trans);
     TProtocol* prot;
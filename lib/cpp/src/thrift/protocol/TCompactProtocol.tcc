@@ -19,10 +19,18 @@
 #ifndef _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_ 1
 
+#include <algorithm>
 #include <limits>
 #include <cstdlib>
+#include <cstring>
 
 #include "thrift/config.h"
+#include <thrift/protocol/TProtocolTypes.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 /*
  * TCompactProtocol::i*ToZigzag depend on the fact that the right shift
@@ -85,6 +93,107 @@ const int8_t TTypeToCType[17] = {
   CT_UUID, // T_UUID
 };
 
+/*
+ * Word-at-a-time varint coding. The borrowed-buffer fast paths load eight
+ * wire bytes as one little-endian word; the varint ends at the lowest byte
+ * whose continuation bit is clear, so both the length and the value can be
+ * found with a handful of mask and shift operations instead of a loop.
+ */
+const uint64_t VARINT_CONTINUATION_BITS = 0x8080808080808080ULL;
+const uint64_t VARINT_PAYLOAD_BITS = 0x7f7f7f7f7f7f7f7fULL;
+
+inline uint32_t lowestSetBit(uint64_t v) {
+#ifdef __GNUC__
+  return static_cast<uint32_t>(__builtin_ctzll(v));
+#else
+  uint32_t n = 0;
+  while (!(v & 1)) {
+    v >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+inline uint32_t popCount(uint64_t v) {
+#ifdef __GNUC__
+  return static_cast<uint32_t>(__builtin_popcountll(v));
+#else
+  uint32_t n = 0;
+  for (; v != 0; v &= v - 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+inline uint32_t highestSetBit(uint64_t v) {
+#ifdef __GNUC__
+  return static_cast<uint32_t>(63 - __builtin_clzll(v));
+#else
+  uint32_t n = 0;
+  while (v >>= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+/**
+ * Number of bytes the varint encoding of n occupies.
+ */
+inline uint32_t varintSize(uint64_t n) {
+  return n == 0 ? 1 : highestSetBit(n) / 7 + 1;
+}
+
+/**
+ * Decode a varint of at most eight bytes starting at p, which must have
+ * at least eight readable bytes. Returns the number of bytes the varint
+ * occupies, or 0 if none of the eight bytes terminates it.
+ */
+inline uint32_t decodeVarintWord(const uint8_t* p, uint64_t& val) {
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  word = THRIFT_letohll(word);
+
+  uint64_t stops = ~word & VARINT_CONTINUATION_BITS;
+  if (stops == 0) {
+    return 0;
+  }
+  // Keep every byte up to and including the terminating one.
+  word &= stops ^ (stops - 1);
+#if defined(__BMI2__)
+  val = _pext_u64(word, VARINT_PAYLOAD_BITS);
+#else
+  word &= VARINT_PAYLOAD_BITS;
+  word = (word & 0x007f007f007f007fULL) | ((word & 0x7f007f007f007f00ULL) >> 1);
+  word = (word & 0x00003fff00003fffULL) | ((word & 0x3fff00003fff0000ULL) >> 2);
+  val = (word & 0x000000000fffffffULL) | ((word & 0x0fffffff00000000ULL) >> 4);
+#endif
+  return (lowestSetBit(stops) >> 3) + 1;
+}
+
+/**
+ * Encode n, which must fit in 56 bits, into the first bytes of out (which
+ * must have room for eight). Returns the number of bytes the varint needs.
+ */
+inline uint32_t encodeVarintWord(uint64_t n, uint8_t* out) {
+  uint32_t len = varintSize(n);
+  uint64_t word;
+#if defined(__BMI2__)
+  word = _pdep_u64(n, VARINT_PAYLOAD_BITS);
+#else
+  word = (n & 0x000000000fffffffULL) | ((n & 0x00fffffff0000000ULL) << 4);
+  word = (word & 0x00003fff00003fffULL) | ((word & 0x0fffc0000fffc000ULL) << 2);
+  word = (word & 0x007f007f007f007fULL) | ((word & 0x3f803f803f803f80ULL) << 1);
+#endif
+  // Every byte but the last carries a continuation bit.
+  word |= VARINT_CONTINUATION_BITS & ((1ULL << ((len - 1) * 8)) - 1);
+  word = THRIFT_htolell(word);
+  std::memcpy(out, &word, sizeof(word));
+  return len;
+}
+
 }} // end detail::compact namespace
 
 
@@ -265,6 +374,105 @@ uint32_t TCompactProtocolT<Transport_>::writeDouble(const double dub) {
   return 8;
 }
 
+/**
+ * Write a list of bytes; they are stored raw, so this is a single write.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeByteArray(const int8_t* values,
+                                                       const uint32_t count) {
+  if (count > 0) {
+    trans_->write(reinterpret_cast<const uint8_t*>(values), count);
+  }
+  return count;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI16Array(const int16_t* values,
+                                                      const uint32_t count) {
+  return writeVarintArray(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32Array(const int32_t* values,
+                                                      const uint32_t count) {
+  return writeVarintArray(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64Array(const int64_t* values,
+                                                      const uint32_t count) {
+  return writeVarintArray(values, count);
+}
+
+/**
+ * Write a list of doubles. Doubles are little-endian on the wire, so on
+ * little-endian hosts the array is written as is.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeDoubleArray(const double* values,
+                                                         const uint32_t count) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "sizeof(double) == sizeof(uint64_t)");
+  static_assert(std::numeric_limits<double>::is_iec559, "std::numeric_limits<double>::is_iec559");
+
+  if (count > (std::numeric_limits<uint32_t>::max)() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  if (count == 0) {
+    return 0;
+  }
+#if __THRIFT_BYTE_ORDER == __THRIFT_LITTLE_ENDIAN
+  trans_->write(reinterpret_cast<const uint8_t*>(values), count * 8);
+#else
+  uint64_t buf[64];
+  for (uint32_t done = 0; done < count; ) {
+    uint32_t n = (std::min)(static_cast<uint32_t>(64), count - done);
+    for (uint32_t i = 0; i < n; ++i) {
+      buf[i] = THRIFT_htolell(bitwise_cast<uint64_t>(values[done + i]));
+    }
+    trans_->write(reinterpret_cast<const uint8_t*>(buf), n * 8);
+    done += n;
+  }
+#endif
+  return count * 8;
+}
+
+/**
+ * Write a list of integers as zigzag varints. They are encoded into a
+ * stack buffer and handed to the transport a few hundred bytes at a time.
+ */
+template <class Transport_>
+template <typename Value_>
+uint32_t TCompactProtocolT<Transport_>::writeVarintArray(const Value_* values,
+                                                         const uint32_t count) {
+  uint8_t buf[512];
+  uint32_t used = 0;
+  uint32_t wsize = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t n = sizeof(Value_) == 8 ? i64ToZigzag(static_cast<int64_t>(values[i]))
+                                     : i32ToZigzag(static_cast<int32_t>(values[i]));
+    if (sizeof(buf) - used < 10) {
+      trans_->write(buf, used);
+      wsize += used;
+      used = 0;
+    }
+    if (n < (1ULL << 56)) {
+      used += detail::compact::encodeVarintWord(n, buf + used);
+    } else {
+      while (n >= 0x80) {
+        buf[used++] = static_cast<uint8_t>((n & 0x7F) | 0x80);
+        n >>= 7;
+      }
+      buf[used++] = static_cast<uint8_t>(n);
+    }
+  }
+  if (used > 0) {
+    trans_->write(buf, used);
+    wsize += used;
+  }
+  return wsize;
+}
+
 /**
  * Write a string to the wire with a varint size preceding.
  */
@@ -277,14 +485,27 @@ template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
   if(str.size() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  auto ssize = static_cast<uint32_t>(str.size());
-  uint32_t wsize = writeVarint32(ssize) ;
-  // checking ssize + wsize > uint_max, but we don't want to overflow while checking for overflows.
-  // transforming the check to ssize > uint_max - wsize
-  if(ssize > (std::numeric_limits<uint32_t>::max)() - wsize)
+  return writeBinaryView(reinterpret_cast<const uint8_t*>(str.data()),
+                         static_cast<uint32_t>(str.size()));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeStringView(const uint8_t* data, uint32_t size) {
+  return writeBinaryView(data, size);
+}
+
+/**
+ * Write a byte[] to the wire straight from the caller's memory.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryView(const uint8_t* data, uint32_t size) {
+  uint32_t wsize = writeVarint32(size) ;
+  // checking size + wsize > uint_max, but we don't want to overflow while checking for overflows.
+  // transforming the check to size > uint_max - wsize
+  if(size > (std::numeric_limits<uint32_t>::max)() - wsize)
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  wsize += ssize;
-  trans_->write(reinterpret_cast<const uint8_t*>(str.data()), ssize);
+  wsize += size;
+  trans_->write(data, size);
   return wsize;
 }
 
@@ -356,18 +577,14 @@ uint32_t TCompactProtocolT<Transport_>::writeCollectionBegin(const TType elemTyp
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeVarint32(uint32_t n) {
-  uint8_t buf[5];
-  uint32_t wsize = 0;
-
-  while (true) {
-    if ((n & ~0x7F) == 0) {
-      buf[wsize++] = static_cast<int8_t>(n);
-      break;
-    } else {
-      buf[wsize++] = static_cast<int8_t>((n & 0x7F) | 0x80);
-      n >>= 7;
-    }
+  if (n < 0x80) {
+    uint8_t byte = static_cast<uint8_t>(n);
+    trans_->write(&byte, 1);
+    return 1;
   }
+
+  uint8_t buf[8];
+  uint32_t wsize = detail::compact::encodeVarintWord(n, buf);
   trans_->write(buf, wsize);
   return wsize;
 }
@@ -377,9 +594,21 @@ uint32_t TCompactProtocolT<Transport_>::writeVarint32(uint32_t n) {
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeVarint64(uint64_t n) {
+  if (n < 0x80) {
+    uint8_t byte = static_cast<uint8_t>(n);
+    trans_->write(&byte, 1);
+    return 1;
+  }
+
   uint8_t buf[10];
   uint32_t wsize = 0;
 
+  if (n < (1ULL << 56)) {
+    wsize = detail::compact::encodeVarintWord(n, buf);
+    trans_->write(buf, wsize);
+    return wsize;
+  }
+
   while (true) {
     if ((n & ~0x7FL) == 0) {
       buf[wsize++] = static_cast<int8_t>(n);
@@ -684,6 +913,102 @@ uint32_t TCompactProtocolT<Transport_>::readDouble(double& dub) {
   return 8;
 }
 
+/**
+ * Read a list of bytes straight into place.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readByteArray(int8_t* values, const uint32_t count) {
+  if (count > 0) {
+    trans_->readAll(reinterpret_cast<uint8_t*>(values), count);
+  }
+  return count;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI16Array(int16_t* values, const uint32_t count) {
+  return readVarintArray(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32Array(int32_t* values, const uint32_t count) {
+  return readVarintArray(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64Array(int64_t* values, const uint32_t count) {
+  return readVarintArray(values, count);
+}
+
+/**
+ * Read a list of little-endian doubles with a single readAll().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readDoubleArray(double* values, const uint32_t count) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "sizeof(double) == sizeof(uint64_t)");
+  static_assert(std::numeric_limits<double>::is_iec559, "std::numeric_limits<double>::is_iec559");
+
+  if (count > (std::numeric_limits<uint32_t>::max)() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  if (count == 0) {
+    return 0;
+  }
+  trans_->readAll(reinterpret_cast<uint8_t*>(values), count * 8);
+#if __THRIFT_BYTE_ORDER != __THRIFT_LITTLE_ENDIAN
+  for (uint32_t i = 0; i < count; ++i) {
+    values[i] = bitwise_cast<double>(THRIFT_letohll(bitwise_cast<uint64_t>(values[i])));
+  }
+#endif
+  return count * 8;
+}
+
+/**
+ * Read a list of zigzag varints. While the transport can lend a full word
+ * of input the varints are decoded back to back from the borrowed memory
+ * and consumed in one go; the tail of the buffer and any varint longer
+ * than a word fall back to readVarint64().
+ */
+template <class Transport_>
+template <typename Value_>
+uint32_t TCompactProtocolT<Transport_>::readVarintArray(Value_* values, const uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint8_t buf[10];
+    uint32_t buf_size = sizeof(buf);
+    const uint8_t* borrowed = trans_->borrow(buf, &buf_size);
+    uint64_t val;
+
+    if (borrowed != nullptr) {
+      uint32_t used = 0;
+      while (i < count && buf_size - used >= 8) {
+        uint32_t len = detail::compact::decodeVarintWord(borrowed + used, val);
+        if (len == 0) {
+          break;
+        }
+        values[i++] = sizeof(Value_) == 8
+                          ? static_cast<Value_>(zigzagToI64(val))
+                          : static_cast<Value_>(zigzagToI32(static_cast<uint32_t>(val)));
+        used += len;
+      }
+      if (used > 0) {
+        trans_->consume(used);
+        rsize += used;
+        continue;
+      }
+    }
+
+    int64_t wide;
+    rsize += readVarint64(wide);
+    val = static_cast<uint64_t>(wide);
+    values[i++] = sizeof(Value_) == 8
+                      ? static_cast<Value_>(zigzagToI64(val))
+                      : static_cast<Value_>(zigzagToI32(static_cast<uint32_t>(val)));
+  }
+  return rsize;
+}
+
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readString(std::string& str) {
   return readBinary(str);
@@ -712,24 +1037,110 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   }
 
+  // Try to borrow first
+  uint32_t got = static_cast<uint32_t>(size);
+  const uint8_t* borrow_buf = trans_->borrow(nullptr, &got);
+  if (borrow_buf) {
+    str.assign(reinterpret_cast<const char*>(borrow_buf), size);
+    trans_->consume(static_cast<uint32_t>(size));
+    return rsize + static_cast<uint32_t>(size);
+  }
+
   // Check against MaxMessageSize before alloc
   trans_->checkReadBytesAvailable(static_cast<uint32_t>(size));
 
-  // Use the heap here to prevent stack overflow for v. large strings
-  if (size > string_buf_size_ || string_buf_ == nullptr) {
-    void* new_string_buf = std::realloc(string_buf_, static_cast<uint32_t>(size));
-    if (new_string_buf == nullptr) {
-      throw std::bad_alloc();
-    }
-    string_buf_ = static_cast<uint8_t*>(new_string_buf);
-    string_buf_size_ = size;
-  }
-  trans_->readAll(string_buf_, size);
-  str.assign(reinterpret_cast<char*>(string_buf_), size);
+  // Read straight into the string's own storage
+  str.resize(size);
+  trans_->readAll(reinterpret_cast<uint8_t*>(&str[0]), size);
 
   return rsize + static_cast<uint32_t>(size);
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStringView(const uint8_t*& data, uint32_t& size) {
+  return readBinaryView(data, size);
+}
+
+/**
+ * Read a byte[] from the wire without copying it: on success data points into
+ * the transport's read buffer.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryView(const uint8_t*& data, uint32_t& size) {
+  uint32_t rsize = 0;
+  int32_t sz;
+
+  rsize += readVarint32(sz);
+  // Catch empty string case
+  if (sz == 0) {
+    data = nullptr;
+    size = 0;
+    return rsize;
+  }
+
+  // Catch error cases
+  if (sz < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && sz > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  uint32_t got = static_cast<uint32_t>(sz);
+  const uint8_t* borrow_buf = trans_->borrow(nullptr, &got);
+  if (borrow_buf == nullptr) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "transport cannot lend the whole string for a zero-copy read");
+  }
+  trans_->consume(static_cast<uint32_t>(sz));
+  data = borrow_buf;
+  size = static_cast<uint32_t>(sz);
+  return rsize + size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStringInto(TStringSink& sink) {
+  return readBinaryInto(sink);
+}
+
+/**
+ * Read a byte[] from the wire straight into a string of any type.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryInto(TStringSink& sink) {
+  uint32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    sink.resize(0);
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  // Try to borrow first
+  uint32_t got = static_cast<uint32_t>(size);
+  const uint8_t* borrow_buf = trans_->borrow(nullptr, &got);
+  if (borrow_buf) {
+    sink.assign(borrow_buf, static_cast<uint32_t>(size));
+    trans_->consume(static_cast<uint32_t>(size));
+    return rsize + static_cast<uint32_t>(size);
+  }
+
+  // Check against MaxMessageSize before alloc
+  trans_->checkReadBytesAvailable(static_cast<uint32_t>(size));
+
+  trans_->readAll(sink.resize(static_cast<uint32_t>(size)), size);
+  return rsize + static_cast<uint32_t>(size);
+}
 
 /**
  * Read a TUuid from the wire.
@@ -745,6 +1156,22 @@ uint32_t TCompactProtocolT<Transport_>::readUUID(TUuid& uuid) {
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readVarint32(int32_t& i32) {
+  uint8_t buf[8];
+  uint32_t buf_size = sizeof(buf);
+  const uint8_t* borrowed = trans_->borrow(buf, &buf_size);
+
+  // Fast path: decode the whole varint from one word.
+  if (borrowed != nullptr) {
+    uint64_t val;
+    uint32_t rsize = detail::compact::decodeVarintWord(borrowed, val);
+    if (rsize != 0) {
+      i32 = static_cast<int32_t>(val);
+      trans_->consume(rsize);
+      return rsize;
+    }
+  }
+
+  // Short buffers and over-long encodings take the general path.
   int64_t val;
   uint32_t rsize = readVarint64(val);
   i32 = static_cast<int32_t>(val);
@@ -766,6 +1193,13 @@ uint32_t TCompactProtocolT<Transport_>::readVarint64(int64_t& i64) {
 
   // Fast path.
   if (borrowed != nullptr) {
+    rsize = detail::compact::decodeVarintWord(borrowed, val);
+    if (rsize != 0) {
+      i64 = static_cast<int64_t>(val);
+      trans_->consume(rsize);
+      return rsize;
+    }
+    // Longer than one word (or invalid); decode it a byte at a time.
     while (true) {
       uint8_t byte = borrowed[rsize];
       rsize++;
@@ -853,6 +1287,293 @@ TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
   }
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  switch (type) {
+  case T_BOOL: {
+    // A bool field's value lives in its field header.
+    bool value;
+    return readBool(value);
+  }
+  case T_I16:
+  case T_I32:
+  case T_I64:
+    return skipVarints(1);
+  case T_STRING: {
+    int32_t size;
+    uint32_t result = readVarint32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (string_limit_ > 0 && size > string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return result + skipBytes(*trans_, static_cast<uint32_t>(size));
+  }
+  case T_STRUCT: {
+    uint32_t result = 0;
+    std::string name;
+    int16_t fid;
+    TType ftype;
+    result += readStructBegin(name);
+    while (true) {
+      result += readFieldBegin(name, ftype, fid);
+      if (ftype == T_STOP) {
+        break;
+      }
+      result += skip(ftype);
+      result += readFieldEnd();
+    }
+    result += readStructEnd();
+    return result;
+  }
+  case T_MAP: {
+    uint32_t result = 0;
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    result += readMapBegin(keyType, valType, size);
+    uint32_t keySize = fixedWireSize(keyType);
+    uint32_t valSize = fixedWireSize(valType);
+    if (keySize != 0 && valSize != 0) {
+      result += skipBytes(*trans_, static_cast<uint64_t>(size) * (keySize + valSize));
+    } else if (isVarintType(keyType) && isVarintType(valType) && size <= 0x7fffffff) {
+      result += skipVarints(size * 2);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(keyType);
+        result += skip(valType);
+      }
+    }
+    result += readMapEnd();
+    return result;
+  }
+  case T_SET:
+  case T_LIST: {
+    uint32_t result = 0;
+    TType elemType;
+    uint32_t size;
+    result += readListBegin(elemType, size);
+    uint32_t elemSize = fixedWireSize(elemType);
+    if (elemSize != 0) {
+      result += skipBytes(*trans_, static_cast<uint64_t>(size) * elemSize);
+    } else if (isVarintType(elemType)) {
+      result += skipVarints(size);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(elemType);
+      }
+    }
+    result += readListEnd();
+    return result;
+  }
+  default: {
+    uint32_t size = fixedWireSize(type);
+    if (size != 0) {
+      return skipBytes(*trans_, size);
+    }
+    break;
+  }
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeMessageBegin(const std::string& name,
+                                                                   const TMessageType messageType,
+                                                                   const int32_t seqid) {
+  (void)messageType;
+  return 2 + detail::compact::varintSize(static_cast<uint32_t>(seqid))
+         + serializedSizeString(static_cast<uint32_t>(name.size()));
+}
+
+/**
+ * Mirrors writeFieldBeginInternal(): the id is folded into the type byte
+ * if it follows the previous one by 1 to 15.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeFieldBegin(const TType fieldType,
+                                                                 const int16_t fieldId,
+                                                                 const int16_t lastFieldId) {
+  (void)fieldType;
+  if (fieldId > lastFieldId && fieldId - lastFieldId <= 15) {
+    return 1;
+  }
+  return 1 + detail::compact::varintSize(i32ToZigzag(fieldId));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeMapBegin(const TType keyType,
+                                                               const TType valType,
+                                                               const uint32_t size) {
+  (void)keyType;
+  (void)valType;
+  return size == 0 ? 1 : detail::compact::varintSize(size) + 1;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeListBegin(const TType elemType,
+                                                                const uint32_t size) {
+  (void)elemType;
+  return size <= 14 ? 1 : detail::compact::varintSize(size) + 1;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeSetBegin(const TType elemType,
+                                                               const uint32_t size) {
+  return serializedSizeListBegin(elemType, size);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI16(const int16_t i16) {
+  return detail::compact::varintSize(i32ToZigzag(i16));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI32(const int32_t i32) {
+  return detail::compact::varintSize(i32ToZigzag(i32));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI64(const int64_t i64) {
+  return detail::compact::varintSize(i64ToZigzag(i64));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeString(const uint32_t size) {
+  return detail::compact::varintSize(size) + size;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::getRawProtocolId() {
+  return T_COMPACT_PROTOCOL;
+}
+
+/**
+ * Capture the next value as raw bytes.  The value is measured by skipping
+ * it over a view of the transport's buffered input; running off the end of
+ * the view means it has not all arrived yet.  Encoded structs do not
+ * depend on the surrounding field ids, so the bytes can later be written
+ * back at any position.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readRawValue(TType type, std::string& bytes) {
+  uint32_t avail = 1;
+  const uint8_t* data = trans_->borrow(nullptr, &avail);
+  if (data == nullptr) {
+    return 0;
+  }
+
+  std::shared_ptr<transport::TMemoryBuffer> view(
+      new transport::TMemoryBuffer(const_cast<uint8_t*>(data), avail));
+  TCompactProtocolT<transport::TMemoryBuffer> measure(view, string_limit_, container_limit_);
+  uint32_t size;
+  try {
+    size = measure.skip(type);
+  } catch (const transport::TTransportException& e) {
+    if (e.getType() != transport::TTransportException::END_OF_FILE) {
+      throw;
+    }
+    return 0;
+  }
+
+  bytes.assign(reinterpret_cast<const char*>(data), size);
+  trans_->consume(size);
+  return size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeRawValue(const std::string& bytes) {
+  auto size = static_cast<uint32_t>(bytes.size());
+  trans_->write(reinterpret_cast<const uint8_t*>(bytes.data()), size);
+  return size;
+}
+
+/**
+ * Skip count consecutive varints by counting the bytes that end one,
+ * without decoding them. Buffered input is scanned in place and consumed
+ * in a single call; a varint split across refills is simply continued.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipVarints(uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t run = 0;  // continuation bytes seen in the current varint
+
+  while (count > 0) {
+    uint32_t avail = 1;
+    const uint8_t* borrowed = trans_->borrow(nullptr, &avail);
+    if (borrowed != nullptr) {
+      uint32_t used = 0;
+      // A word holds at most eight terminators, so whole words can be
+      // counted while more than that many varints are still to go.
+      while (avail - used >= 8 && count >= 8) {
+        uint64_t word;
+        std::memcpy(&word, borrowed + used, sizeof(word));
+        uint64_t stops = ~THRIFT_letohll(word) & detail::compact::VARINT_CONTINUATION_BITS;
+        uint32_t lead = stops == 0 ? 8 : detail::compact::lowestSetBit(stops) >> 3;
+        if (UNLIKELY(run + lead >= 10)) {
+          break;  // over-long varint; reported by the byte loop below
+        }
+        if (stops == 0) {
+          run += 8;
+        } else {
+          count -= detail::compact::popCount(stops);
+          run = 7 - (detail::compact::highestSetBit(stops) >> 3);
+        }
+        used += 8;
+      }
+      while (used < avail && count > 0) {
+        if (borrowed[used++] & 0x80) {
+          run++;
+          if (UNLIKELY(run >= 10)) {
+            throw TProtocolException(TProtocolException::INVALID_DATA,
+                                     "Variable-length int over 10 bytes.");
+          }
+        } else {
+          run = 0;
+          count--;
+        }
+      }
+      trans_->consume(used);
+      rsize += used;
+    } else {
+      int64_t ignored;
+      rsize += readVarint64(ignored);
+      run = 0;
+      count--;
+    }
+  }
+  return rsize;
+}
+
+/**
+ * Returns the encoded size of a container element of the given type if it
+ * is the same for every element, or 0 otherwise. Bools inside containers
+ * take one byte each.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::fixedWireSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_DOUBLE:
+    return 8;
+  case T_UUID:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+template <class Transport_>
+bool TCompactProtocolT<Transport_>::isVarintType(TType type) {
+  return type == T_I16 || type == T_I32 || type == T_I64;
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_>
 int TCompactProtocolT<Transport_>::getMinSerializedSize(TType type)
@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TFIELDMASK_H_
+#define _THRIFT_PROTOCOL_TFIELDMASK_H_ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Set of field ids selecting which fields of a struct to deserialize.
+ *
+ * Structs generated with the cpp:field_masks option have a
+ * read(iprot, mask) overload that skips every field whose id is not in the
+ * mask.  Skipped fields keep their previous values and required fields
+ * are only checked when selected.  The mask applies to the top-level
+ * fields only; a selected struct field is read in full.
+ */
+class TFieldMask {
+public:
+  TFieldMask() = default;
+
+  TFieldMask(std::initializer_list<int16_t> fids) {
+    for (int16_t fid : fids) {
+      add(fid);
+    }
+  }
+
+  TFieldMask& add(int16_t fid) {
+    std::vector<uint64_t>& bits = fid < 0 ? negative_ : positive_;
+    size_t index = indexOf(fid);
+    if (index / 64 >= bits.size()) {
+      bits.resize(index / 64 + 1, 0);
+    }
+    bits[index / 64] |= uint64_t(1) << (index % 64);
+    return *this;
+  }
+
+  bool contains(int16_t fid) const {
+    const std::vector<uint64_t>& bits = fid < 0 ? negative_ : positive_;
+    size_t index = indexOf(fid);
+    return index / 64 < bits.size() && ((bits[index / 64] >> (index % 64)) & 1) != 0;
+  }
+
+private:
+  // Field ids are usually small and positive; compiler-assigned ids count
+  // down from -1, so each sign gets its own bitmap.
+  static size_t indexOf(int16_t fid) {
+    return fid < 0 ? static_cast<size_t>(-(static_cast<int32_t>(fid) + 1))
+                   : static_cast<size_t>(fid);
+  }
+
+  std::vector<uint64_t> positive_;
+  std::vector<uint64_t> negative_;
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TFIELDMASK_H_
@@ -150,6 +150,34 @@ uint32_t THeaderProtocol::writeUUID(const TUuid& uuid) {
   return proto_->writeUUID(uuid);
 }
 
+uint32_t THeaderProtocol::writeStringView(const uint8_t* data, uint32_t size) {
+  return proto_->writeStringView(data, size);
+}
+
+uint32_t THeaderProtocol::writeBinaryView(const uint8_t* data, uint32_t size) {
+  return proto_->writeBinaryView(data, size);
+}
+
+uint32_t THeaderProtocol::writeByteArray(const int8_t* values, const uint32_t count) {
+  return proto_->writeByteArray(values, count);
+}
+
+uint32_t THeaderProtocol::writeI16Array(const int16_t* values, const uint32_t count) {
+  return proto_->writeI16Array(values, count);
+}
+
+uint32_t THeaderProtocol::writeI32Array(const int32_t* values, const uint32_t count) {
+  return proto_->writeI32Array(values, count);
+}
+
+uint32_t THeaderProtocol::writeI64Array(const int64_t* values, const uint32_t count) {
+  return proto_->writeI64Array(values, count);
+}
+
+uint32_t THeaderProtocol::writeDoubleArray(const double* values, const uint32_t count) {
+  return proto_->writeDoubleArray(values, count);
+}
+
 /**
  * Reading functions
  */
@@ -254,6 +282,54 @@ uint32_t THeaderProtocol::readBinary(std::string& binary) {
 uint32_t THeaderProtocol::readUUID(TUuid& uuid) {
   return proto_->readUUID(uuid);
 }
+
+uint32_t THeaderProtocol::readStringView(const uint8_t*& data, uint32_t& size) {
+  return proto_->readStringView(data, size);
+}
+
+uint32_t THeaderProtocol::readBinaryView(const uint8_t*& data, uint32_t& size) {
+  return proto_->readBinaryView(data, size);
+}
+
+uint32_t THeaderProtocol::readStringInto(TStringSink& sink) {
+  return proto_->readStringInto(sink);
+}
+
+uint32_t THeaderProtocol::readBinaryInto(TStringSink& sink) {
+  return proto_->readBinaryInto(sink);
+}
+
+int32_t THeaderProtocol::getRawProtocolId() {
+  return proto_->getRawProtocolId();
+}
+
+uint32_t THeaderProtocol::readRawValue(TType type, std::string& bytes) {
+  return proto_->readRawValue(type, bytes);
+}
+
+uint32_t THeaderProtocol::writeRawValue(const std::string& bytes) {
+  return proto_->writeRawValue(bytes);
+}
+
+uint32_t THeaderProtocol::readByteArray(int8_t* values, const uint32_t count) {
+  return proto_->readByteArray(values, count);
+}
+
+uint32_t THeaderProtocol::readI16Array(int16_t* values, const uint32_t count) {
+  return proto_->readI16Array(values, count);
+}
+
+uint32_t THeaderProtocol::readI32Array(int32_t* values, const uint32_t count) {
+  return proto_->readI32Array(values, count);
+}
+
+uint32_t THeaderProtocol::readI64Array(int64_t* values, const uint32_t count) {
+  return proto_->readI64Array(values, count);
+}
+
+uint32_t THeaderProtocol::readDoubleArray(double* values, const uint32_t count) {
+  return proto_->readDoubleArray(values, count);
+}
 }
 }
 } // apache::thrift::protocol
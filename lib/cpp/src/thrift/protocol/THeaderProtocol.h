@@ -28,6 +28,7 @@
 #include <memory>
 
 using apache::thrift::transport::THeaderTransport;
+using apache::thrift::transport::THeaderTable;
 
 namespace apache {
 namespace thrift {
@@ -80,11 +81,19 @@ public:
     trans_->setHeader(key, value);
   }
 
+  void setHeader(const char* key, uint32_t keySize, const char* value, uint32_t valueSize) {
+    trans_->setHeader(key, keySize, value, valueSize);
+  }
+
   void clearHeaders() { trans_->clearHeaders(); }
 
+  const THeaderTable& getWriteHeaderTable() const { return trans_->getWriteHeaderTable(); }
+
   StringToStringMap& getWriteHeaders() { return trans_->getWriteHeaders(); }
 
   // these work with read headers
+  const THeaderTable& getHeaderTable() const { return trans_->getHeaderTable(); }
+
   const StringToStringMap& getHeaders() const { return trans_->getHeaders(); }
 
   /**
@@ -137,6 +146,20 @@ public:
 
   uint32_t writeUUID(const TUuid& uuid);
 
+  uint32_t writeStringView(const uint8_t* data, uint32_t size);
+
+  uint32_t writeBinaryView(const uint8_t* data, uint32_t size);
+
+  uint32_t writeByteArray(const int8_t* values, const uint32_t count);
+
+  uint32_t writeI16Array(const int16_t* values, const uint32_t count);
+
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count);
+
   /**
    * Reading functions
    */
@@ -185,6 +208,30 @@ public:
 
   uint32_t readUUID(TUuid& uuid);
 
+  uint32_t readStringView(const uint8_t*& data, uint32_t& size);
+
+  uint32_t readBinaryView(const uint8_t*& data, uint32_t& size);
+
+  uint32_t readStringInto(TStringSink& sink);
+
+  uint32_t readBinaryInto(TStringSink& sink);
+
+  int32_t getRawProtocolId();
+
+  uint32_t readRawValue(TType type, std::string& bytes);
+
+  uint32_t writeRawValue(const std::string& bytes);
+
+  uint32_t readByteArray(int8_t* values, const uint32_t count);
+
+  uint32_t readI16Array(int16_t* values, const uint32_t count);
+
+  uint32_t readI32Array(int32_t* values, const uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, const uint32_t count);
+
+  uint32_t readDoubleArray(double* values, const uint32_t count);
+
 protected:
   std::shared_ptr<THeaderTransport> trans_;
 
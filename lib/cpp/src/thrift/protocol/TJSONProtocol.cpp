@@ -21,7 +21,11 @@
 
 #include <boost/locale.hpp>
 
+#include <algorithm>
+#include <clocale>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <limits>
 #include <locale>
 #include <sstream>
@@ -290,6 +294,66 @@ static bool isJSONNumeric(uint8_t ch) {
   return false;
 }
 
+// Return true if ch can be written inside a JSON string as is
+static bool isJSONSafe(uint8_t ch) {
+  return ch >= 0x30 ? ch != kJSONBackslash : kJSONCharTable[ch] == 1;
+}
+
+// snprintf and strtod follow the C locale, which only agrees with JSON
+// while its decimal point is '.'.
+static bool isDecimalPointDot() {
+  const char* point = localeconv()->decimal_point;
+  return point[0] == '.' && point[1] == '\0';
+}
+
+// Return the integer value of a JSON number with no fraction or exponent,
+// or false if str is not one or its value does not fit in NumberType.
+template <typename NumberType>
+static bool parseJSONInteger(const std::string& str, NumberType& num) {
+  const char* p = str.data();
+  const char* end = p + str.size();
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (p == end) {
+    return false;
+  }
+  uint64_t limit;
+  if (!negative) {
+    limit = static_cast<uint64_t>((std::numeric_limits<NumberType>::max)());
+  } else if (std::numeric_limits<NumberType>::is_signed) {
+    limit = static_cast<uint64_t>(
+                -(static_cast<int64_t>((std::numeric_limits<NumberType>::min)()) + 1)) + 1;
+  } else {
+    limit = 0;
+  }
+  uint64_t value = 0;
+  for (; p != end; ++p) {
+    auto digit = static_cast<uint64_t>(static_cast<uint8_t>(*p - '0'));
+    if (digit > 9 || digit > limit || value > (limit - digit) / 10) {
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+  num = static_cast<NumberType>(negative ? 0 - value : value);
+  return true;
+}
+
+// Return the decimal digits of num, written backwards from end.
+static char* formatJSONInteger(int64_t num, char* end) {
+  uint64_t value = num < 0 ? 0 - static_cast<uint64_t>(num) : static_cast<uint64_t>(num);
+  do {
+    *--end = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  if (num < 0) {
+    *--end = '-';
+  }
+  return end;
+}
+
 // Return true if the code unit is high surrogate
 static bool isHighSurrogate(uint16_t val) {
   return val >= 0xD800 && val <= 0xDBFF;
@@ -464,11 +528,22 @@ uint32_t TJSONProtocol::writeJSONString(const std::string& str) {
   uint32_t result = context_->write(*trans_);
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
-  while (iter != end) {
-    result += writeJSONChar(*iter++);
+  if (str.length() > (std::numeric_limits<uint32_t>::max)())
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  // Write runs of characters that need no escaping with a single call
+  const auto* bytes = (const uint8_t*)str.data();
+  auto len = static_cast<uint32_t>(str.length());
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < len; ++i) {
+    if (!isJSONSafe(bytes[i])) {
+      trans_->write(bytes + start, i - start);
+      result += i - start;
+      result += writeJSONChar(bytes[i]);
+      start = i + 1;
+    }
   }
+  trans_->write(bytes + start, len - start);
+  result += len - start;
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
 }
@@ -479,23 +554,19 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
   uint32_t result = context_->write(*trans_);
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  uint8_t b[4];
   const auto* bytes = (const uint8_t*)str.c_str();
   if (str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   auto len = static_cast<uint32_t>(str.length());
-  while (len >= 3) {
-    // Encode 3 bytes at a time
-    base64_encode(bytes, 3, b);
-    trans_->write(b, 4);
-    result += 4;
-    bytes += 3;
-    len -= 3;
-  }
-  if (len) { // Handle remainder
-    base64_encode(bytes, len, b);
-    trans_->write(b, len + 1);
-    result += len + 1;
+  // Encode a few kilobytes at a time, a multiple of 3 bytes until the end
+  uint8_t b[4096];
+  while (len > 0) {
+    uint32_t chunk = (std::min)(len, static_cast<uint32_t>(sizeof(b) / 4 * 3));
+    uint32_t encoded = base64_encode_block(bytes, chunk, b);
+    trans_->write(b, encoded);
+    result += encoded;
+    bytes += chunk;
+    len -= chunk;
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -506,25 +577,32 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
   uint32_t result = context_->write(*trans_);
-  std::string val(to_string(num));
+  // Room for the quotes, a sign and the 19 digits of an int64_t
+  char buf[24];
+  char* end = buf + sizeof(buf);
   bool escapeNum = context_->escapeNum();
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    *--end = kJSONStringDelimiter;
   }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
+  char* begin = formatJSONInteger(static_cast<int64_t>(num), end);
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    *--begin = kJSONStringDelimiter;
+    ++end;
   }
-  return result;
+  auto len = static_cast<uint32_t>(end - begin);
+  trans_->write((const uint8_t*)begin, len);
+  return result + len;
 }
 
 namespace {
 std::string doubleToString(double d) {
+  if (isDecimalPointDot()) {
+    // The same digits the stream below produces, without building one
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.*g", 2 + std::numeric_limits<double>::digits10, d);
+    return std::string(buf, static_cast<size_t>(len));
+  }
+
   std::ostringstream str;
   str.imbue(std::locale::classic());
   const std::streamsize max_digits10 = 2 + std::numeric_limits<double>::digits10;
@@ -752,6 +830,26 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
   uint8_t ch;
   str.clear();
   while (true) {
+    // Copy runs of plain characters straight out of the transport buffer
+    uint32_t len = 1;
+    const uint8_t* buf = reader_.borrow(&len);
+    if (buf != nullptr) {
+      uint32_t run = 0;
+      while (run < len && buf[run] != kJSONStringDelimiter && buf[run] != kJSONBackslash) {
+        ++run;
+      }
+      if (run > 0) {
+        if (!codeunits.empty()) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Missing UTF-16 low surrogate pair.");
+        }
+        size_t size = str.size();
+        str.resize(size + run);
+        reader_.read((uint8_t*)&str[size], run);
+        result += run;
+        continue;
+      }
+    }
     ch = reader_.read();
     ++result;
     if (ch == kJSONStringDelimiter) {
@@ -803,31 +901,22 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
 
 // Reads a block of base64 characters, decoding it, and returns via str
 uint32_t TJSONProtocol::readJSONBase64(std::string& str) {
-  std::string tmp;
-  uint32_t result = readJSONString(tmp);
-  auto* b = (uint8_t*)tmp.c_str();
-  if (tmp.length() > (std::numeric_limits<uint32_t>::max)())
+  uint32_t result = readJSONString(str);
+  if (str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  auto len = static_cast<uint32_t>(tmp.length());
-  str.clear();
+  auto len = static_cast<uint32_t>(str.length());
   // Ignore padding
   uint32_t padding_count = 0;
-  while (len > 0 && b[len - 1] == '=' && padding_count < 2) {
+  while (len > 0 && str[len - 1] == '=' && padding_count < 2) {
     --len;
     ++padding_count;
   }
-  while (len >= 4) {
-    base64_decode(b, 4);
-    str.append((const char*)b, 3);
-    b += 4;
-    len -= 4;
-  }
-  // Don't decode if we hit the end or got a single leftover byte (invalid
-  // base64 but legal for skip of regular string type)
-  if (len > 1) {
-    base64_decode(b, len);
-    str.append((const char*)b, len - 1);
+  // Decode in place; a single leftover byte (invalid base64 but legal for
+  // skip of regular string type) is dropped
+  if (len > 0) {
+    len = base64_decode_block((uint8_t*)&str[0], len);
   }
+  str.resize(len);
   return result;
 }
 
@@ -836,6 +925,20 @@ uint32_t TJSONProtocol::readJSONBase64(std::string& str) {
 uint32_t TJSONProtocol::readJSONNumericChars(std::string& str) {
   uint32_t result = 0;
   str.clear();
+  uint32_t len = 1;
+  const uint8_t* buf = reader_.borrow(&len);
+  if (buf != nullptr) {
+    while (result < len && isJSONNumeric(buf[result])) {
+      ++result;
+    }
+    // Only take the shortcut when the number ends inside the buffer
+    if (result < len) {
+      str.resize(result);
+      reader_.read((uint8_t*)&str[0], result);
+      return result;
+    }
+    result = 0;
+  }
   while (true) {
     uint8_t ch = reader_.peek();
     if (!isJSONNumeric(ch)) {
@@ -859,6 +962,24 @@ T fromString(const std::string& s) {
     throw std::runtime_error(s);
   return t;
 }
+
+double parseJSONDouble(const std::string& s) {
+  if (!isDecimalPointDot()) {
+    return fromString<double>(s);
+  }
+  // strtod also takes hex, "inf" and "nan", which JSON numbers cannot hold
+  for (char ch : s) {
+    if (!isJSONNumeric(static_cast<uint8_t>(ch))) {
+      throw std::runtime_error(s);
+    }
+  }
+  char* end = nullptr;
+  double d = strtod(s.c_str(), &end);
+  if (s.empty() || end != s.c_str() + s.size()) {
+    throw std::runtime_error(s);
+  }
+  return d;
+}
 }
 
 // Reads a sequence of characters and assembles them into a number,
@@ -871,9 +992,7 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
   }
   std::string str;
   result += readJSONNumericChars(str);
-  try {
-    num = fromString<NumberType>(str);
-  } catch (const std::runtime_error&) {
+  if (!parseJSONInteger(str, num)) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
                              "Expected numeric value; got \"" + str + "\"");
   }
@@ -903,7 +1022,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
                                      "Numeric data unexpectedly quoted");
       }
       try {
-        num = fromString<double>(str);
+        num = parseJSONDouble(str);
       } catch (const std::runtime_error&) {
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Expected numeric value; got \"" + str + "\"");
@@ -916,7 +1035,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
     }
     result += readJSONNumericChars(str);
     try {
-      num = fromString<double>(str);
+      num = parseJSONDouble(str);
     } catch (const std::runtime_error&) {
       throw TProtocolException(TProtocolException::INVALID_DATA,
                                    "Expected numeric value; got \"" + str + "\"");
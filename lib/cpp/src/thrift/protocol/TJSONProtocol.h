@@ -283,12 +283,34 @@ public:
 
     uint8_t peek() {
       if (!hasData_) {
+        // Look at the transport buffer in place when possible so that the
+        // byte can still be borrowed by the next read.
+        uint32_t len = 1;
+        const uint8_t* buf = trans_->borrow(nullptr, &len);
+        if (buf != nullptr) {
+          return buf[0];
+        }
         trans_->readAll(&data_, 1);
+        hasData_ = true;
       }
-      hasData_ = true;
       return data_;
     }
 
+    /**
+     * Borrows the bytes buffered in the transport, at least *len of them,
+     * so that the caller can scan ahead before reading them with read(buf,
+     * len).  Returns nullptr if the transport cannot lend them or a peeked
+     * byte is pending, in which case the caller reads one byte at a time.
+     */
+    const uint8_t* borrow(uint32_t* len) {
+      if (hasData_) {
+        return nullptr;
+      }
+      return trans_->borrow(nullptr, len);
+    }
+
+    void read(uint8_t* buf, uint32_t len) { trans_->readAll(buf, len); }
+
   private:
     TTransport* trans_;
     bool hasData_;
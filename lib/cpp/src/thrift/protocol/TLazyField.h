@@ -0,0 +1,172 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TLAZYFIELD_H_
+#define _THRIFT_PROTOCOL_TLAZYFIELD_H_ 1
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TProtocolTypes.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Holder for a struct field annotated with (cpp.lazy).
+ *
+ * Reading the field only captures its encoded bytes; the struct is decoded
+ * the first time it is accessed.  A field that is never accessed is written
+ * back out verbatim when the protocol matches the one it was read with, so
+ * proxies and routers that only look at a few fields of a large message do
+ * not pay for decoding and re-encoding the rest.
+ *
+ * The first access decodes into a cached value and is not thread-safe,
+ * even through the const accessors.
+ */
+template <class T>
+class TLazyField {
+public:
+  TLazyField() : decoded_(true), protocolId_(-1) {}
+
+  TLazyField(const T& value) : value_(value), decoded_(true), protocolId_(-1) {}
+
+  TLazyField& operator=(const T& value) {
+    set(value);
+    return *this;
+  }
+
+  const T& get() const {
+    if (!decoded_) {
+      decode();
+    }
+    return value_;
+  }
+
+  /**
+   * Access for modification.  The captured encoding no longer matches once
+   * the value can change, so it is dropped.
+   */
+  T& getMutable() {
+    if (!decoded_) {
+      decode();
+    }
+    raw_.clear();
+    protocolId_ = -1;
+    return value_;
+  }
+
+  void set(const T& value) {
+    value_ = value;
+    decoded_ = true;
+    raw_.clear();
+    protocolId_ = -1;
+  }
+
+  operator const T&() const { return get(); }
+
+  /**
+   * Whether the field holds encoded bytes that have not been decoded yet.
+   */
+  bool isEncoded() const { return !decoded_; }
+
+  template <class Protocol_>
+  uint32_t read(Protocol_* iprot) {
+    int32_t protocolId = iprot->getRawProtocolId();
+    if (protocolId >= 0) {
+      uint32_t size = iprot->readRawValue(T_STRUCT, raw_);
+      if (size > 0) {
+        value_ = T();
+        decoded_ = false;
+        protocolId_ = protocolId;
+        return size;
+      }
+    }
+
+    raw_.clear();
+    protocolId_ = -1;
+    value_ = T();
+    decoded_ = true;
+    return value_.read(iprot);
+  }
+
+  template <class Protocol_>
+  uint32_t write(Protocol_* oprot) const {
+    if (protocolId_ >= 0 && oprot->getRawProtocolId() == protocolId_) {
+      return oprot->writeRawValue(raw_);
+    }
+    return get().write(oprot);
+  }
+
+  template <class Protocol_>
+  uint32_t serializedSize(Protocol_* oprot) const {
+    if (protocolId_ >= 0 && oprot->getRawProtocolId() == protocolId_) {
+      return static_cast<uint32_t>(raw_.size());
+    }
+    return get().serializedSize(oprot);
+  }
+
+private:
+  void decode() const {
+    std::shared_ptr<transport::TMemoryBuffer> buffer(new transport::TMemoryBuffer(
+        reinterpret_cast<uint8_t*>(const_cast<char*>(raw_.data())),
+        static_cast<uint32_t>(raw_.size())));
+    T value;
+    if (protocolId_ == T_COMPACT_PROTOCOL) {
+      TCompactProtocolT<transport::TMemoryBuffer> proto(buffer);
+      value.read(&proto);
+    } else {
+      TBinaryProtocolT<transport::TMemoryBuffer> proto(buffer);
+      value.read(&proto);
+    }
+    value_ = std::move(value);
+    decoded_ = true;
+  }
+
+  mutable T value_;
+  mutable bool decoded_;
+  std::string raw_;
+  int32_t protocolId_;
+};
+
+template <class T>
+bool operator==(const TLazyField<T>& lhs, const TLazyField<T>& rhs) {
+  return lhs.get() == rhs.get();
+}
+
+template <class T>
+bool operator!=(const TLazyField<T>& lhs, const TLazyField<T>& rhs) {
+  return !(lhs == rhs);
+}
+
+template <class T>
+std::ostream& operator<<(std::ostream& out, const TLazyField<T>& field) {
+  out << field.get();
+  return out;
+}
+}
+}
+} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TLAZYFIELD_H_
@@ -68,7 +68,7 @@ public:
    * \param _serviceName The service name of the service communicating via this protocol.
    */
   TMultiplexedProtocol(shared_ptr<TProtocol> _protocol, const std::string& _serviceName)
-    : TProtocolDecorator(_protocol), serviceName(_serviceName), separator(":") {}
+    : TProtocolDecorator(_protocol), serviceName(_serviceName), prefix(_serviceName + ":") {}
   ~TMultiplexedProtocol() override = default;
 
   /**
@@ -86,7 +86,9 @@ public:
 
 private:
   const std::string serviceName;
-  const std::string separator;
+  // "serviceName:", and a buffer reused to prepend it to every call
+  const std::string prefix;
+  std::string qualifiedName;
 };
 }
 }
@@ -28,6 +28,138 @@ uint32_t TProtocol::skip_virt(TType type) {
   return ::apache::thrift::protocol::skip(*this, type);
 }
 
+uint32_t TProtocol::readStringView_virt(const uint8_t*& data, uint32_t& size) {
+  (void)data;
+  (void)size;
+  throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                           "this protocol does not support zero-copy string reads.");
+}
+
+uint32_t TProtocol::readBinaryView_virt(const uint8_t*& data, uint32_t& size) {
+  (void)data;
+  (void)size;
+  throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                           "this protocol does not support zero-copy binary reads.");
+}
+
+uint32_t TProtocol::readStringInto_virt(TStringSink& sink) {
+  std::string str;
+  uint32_t xfer = readString(str);
+  sink.assign(reinterpret_cast<const uint8_t*>(str.data()), static_cast<uint32_t>(str.size()));
+  return xfer;
+}
+
+uint32_t TProtocol::readBinaryInto_virt(TStringSink& sink) {
+  std::string str;
+  uint32_t xfer = readBinary(str);
+  sink.assign(reinterpret_cast<const uint8_t*>(str.data()), static_cast<uint32_t>(str.size()));
+  return xfer;
+}
+
+uint32_t TProtocol::writeStringView_virt(const uint8_t* data, uint32_t size) {
+  return writeString(std::string(reinterpret_cast<const char*>(data), size));
+}
+
+uint32_t TProtocol::writeBinaryView_virt(const uint8_t* data, uint32_t size) {
+  return writeBinary(std::string(reinterpret_cast<const char*>(data), size));
+}
+
+uint32_t TProtocol::writeByteArray_virt(const int8_t* values, const uint32_t count) {
+  uint32_t wsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    wsize += writeByte(values[i]);
+  }
+  return wsize;
+}
+
+uint32_t TProtocol::writeI16Array_virt(const int16_t* values, const uint32_t count) {
+  uint32_t wsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    wsize += writeI16(values[i]);
+  }
+  return wsize;
+}
+
+uint32_t TProtocol::writeI32Array_virt(const int32_t* values, const uint32_t count) {
+  uint32_t wsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    wsize += writeI32(values[i]);
+  }
+  return wsize;
+}
+
+uint32_t TProtocol::writeI64Array_virt(const int64_t* values, const uint32_t count) {
+  uint32_t wsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    wsize += writeI64(values[i]);
+  }
+  return wsize;
+}
+
+uint32_t TProtocol::writeDoubleArray_virt(const double* values, const uint32_t count) {
+  uint32_t wsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    wsize += writeDouble(values[i]);
+  }
+  return wsize;
+}
+
+uint32_t TProtocol::readByteArray_virt(int8_t* values, const uint32_t count) {
+  uint32_t rsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    rsize += readByte(values[i]);
+  }
+  return rsize;
+}
+
+uint32_t TProtocol::readI16Array_virt(int16_t* values, const uint32_t count) {
+  uint32_t rsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    rsize += readI16(values[i]);
+  }
+  return rsize;
+}
+
+uint32_t TProtocol::readI32Array_virt(int32_t* values, const uint32_t count) {
+  uint32_t rsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    rsize += readI32(values[i]);
+  }
+  return rsize;
+}
+
+uint32_t TProtocol::readI64Array_virt(int64_t* values, const uint32_t count) {
+  uint32_t rsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    rsize += readI64(values[i]);
+  }
+  return rsize;
+}
+
+uint32_t TProtocol::readDoubleArray_virt(double* values, const uint32_t count) {
+  uint32_t rsize = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    rsize += readDouble(values[i]);
+  }
+  return rsize;
+}
+
+int32_t TProtocol::getRawProtocolId_virt() {
+  return -1;
+}
+
+uint32_t TProtocol::readRawValue_virt(TType type, std::string& bytes) {
+  (void)type;
+  (void)bytes;
+  return 0;
+}
+
+uint32_t TProtocol::writeRawValue_virt(const std::string& bytes) {
+  (void)bytes;
+  throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                           "this protocol does not support raw values.");
+}
+
 TProtocolFactory::~TProtocolFactory() = default;
 
 }}} // apache::thrift::protocol
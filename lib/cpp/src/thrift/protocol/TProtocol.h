@@ -51,6 +51,8 @@
 #include <thrift/protocol/TMap.h>
 #include <thrift/TUuid.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 
 #ifdef HAVE_NETINET_IN_H
@@ -207,6 +209,42 @@ namespace protocol {
 
 using apache::thrift::transport::TTransport;
 
+/**
+ * Where readStringInto() and readBinaryInto() put the value, for string
+ * types other than std::string.  The protocol either assigns the bytes at
+ * once, or resizes the string and reads into the storage returned.
+ */
+class TStringSink {
+public:
+  virtual ~TStringSink() = default;
+
+  virtual void assign(const uint8_t* data, uint32_t size) = 0;
+
+  virtual uint8_t* resize(uint32_t size) = 0;
+};
+
+/**
+ * TStringSink for any type with assign(), resize() and operator[] like
+ * std::string, e.g. std::pmr::string.
+ */
+template <class String_>
+class TStringSinkT : public TStringSink {
+public:
+  explicit TStringSinkT(String_& str) : str_(str) {}
+
+  void assign(const uint8_t* data, uint32_t size) override {
+    str_.assign(reinterpret_cast<const char*>(data), size);
+  }
+
+  uint8_t* resize(uint32_t size) override {
+    str_.resize(size);
+    return size > 0 ? reinterpret_cast<uint8_t*>(&str_[0]) : nullptr;
+  }
+
+private:
+  String_& str_;
+};
+
 /**
  * Abstract class for a thrift protocol driver. These are all the methods that
  * a protocol must implement. Essentially, there must be some way of reading
@@ -278,6 +316,56 @@ public:
 
   virtual uint32_t writeUUID_virt(const TUuid& uuid) = 0;
 
+  virtual uint32_t writeStringView_virt(const uint8_t* data, uint32_t size);
+
+  virtual uint32_t writeBinaryView_virt(const uint8_t* data, uint32_t size);
+
+  virtual uint32_t writeByteArray_virt(const int8_t* values, const uint32_t count);
+
+  virtual uint32_t writeI16Array_virt(const int16_t* values, const uint32_t count);
+
+  virtual uint32_t writeI32Array_virt(const int32_t* values, const uint32_t count);
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values, const uint32_t count);
+
+  virtual uint32_t writeDoubleArray_virt(const double* values, const uint32_t count);
+
+  virtual uint32_t serializedSizeMessageBegin_virt(const std::string&,
+                                                   const TMessageType,
+                                                   const int32_t) { return 0; }
+
+  virtual uint32_t serializedSizeFieldBegin_virt(const TType,
+                                                 const int16_t,
+                                                 const int16_t) { return 0; }
+
+  virtual uint32_t serializedSizeStop_virt() { return 0; }
+
+  virtual uint32_t serializedSizeMapBegin_virt(const TType,
+                                               const TType,
+                                               const uint32_t) { return 0; }
+
+  virtual uint32_t serializedSizeListBegin_virt(const TType, const uint32_t) { return 0; }
+
+  virtual uint32_t serializedSizeSetBegin_virt(const TType, const uint32_t) { return 0; }
+
+  virtual uint32_t serializedSizeBool_virt(const bool) { return 0; }
+
+  virtual uint32_t serializedSizeByte_virt(const int8_t) { return 0; }
+
+  virtual uint32_t serializedSizeI16_virt(const int16_t) { return 0; }
+
+  virtual uint32_t serializedSizeI32_virt(const int32_t) { return 0; }
+
+  virtual uint32_t serializedSizeI64_virt(const int64_t) { return 0; }
+
+  virtual uint32_t serializedSizeDouble_virt(const double) { return 0; }
+
+  virtual uint32_t serializedSizeString_virt(const uint32_t) { return 0; }
+
+  virtual uint32_t serializedSizeBinary_virt(const uint32_t) { return 0; }
+
+  virtual uint32_t serializedSizeUUID_virt() { return 0; }
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -390,6 +478,53 @@ public:
     return writeUUID_virt(uuid);
   }
 
+  /**
+   * Counterparts of readStringView() and readBinaryView(): write size bytes
+   * starting at data as a string or binary value without first copying them
+   * into a std::string.  Protocols that have to escape or encode the value
+   * fall back to writeString()/writeBinary().
+   */
+  uint32_t writeStringView(const uint8_t* data, uint32_t size) {
+    T_VIRTUAL_CALL();
+    return writeStringView_virt(data, size);
+  }
+
+  uint32_t writeBinaryView(const uint8_t* data, uint32_t size) {
+    T_VIRTUAL_CALL();
+    return writeBinaryView_virt(data, size);
+  }
+
+  /**
+   * Bulk variants of writeByte() ... writeDouble() for the elements of a
+   * list.  The encoding is identical to writing the values one at a time;
+   * protocols with a fixed-width or simple wire format override them to
+   * encode the whole array in one pass.
+   */
+  uint32_t writeByteArray(const int8_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeByteArray_virt(values, count);
+  }
+
+  uint32_t writeI16Array(const int16_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI16Array_virt(values, count);
+  }
+
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeDoubleArray_virt(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -440,6 +575,24 @@ public:
 
   virtual uint32_t readUUID_virt(TUuid& uuid) = 0;
 
+  virtual uint32_t readStringView_virt(const uint8_t*& data, uint32_t& size);
+
+  virtual uint32_t readBinaryView_virt(const uint8_t*& data, uint32_t& size);
+
+  virtual uint32_t readStringInto_virt(TStringSink& sink);
+
+  virtual uint32_t readBinaryInto_virt(TStringSink& sink);
+
+  virtual uint32_t readByteArray_virt(int8_t* values, const uint32_t count);
+
+  virtual uint32_t readI16Array_virt(int16_t* values, const uint32_t count);
+
+  virtual uint32_t readI32Array_virt(int32_t* values, const uint32_t count);
+
+  virtual uint32_t readI64Array_virt(int64_t* values, const uint32_t count);
+
+  virtual uint32_t readDoubleArray_virt(double* values, const uint32_t count);
+
   uint32_t readMessageBegin(std::string& name, TMessageType& messageType, int32_t& seqid) {
     T_VIRTUAL_CALL();
     return readMessageBegin_virt(name, messageType, seqid);
@@ -545,6 +698,70 @@ public:
     return readUUID_virt(uuid);
   }
 
+  /**
+   * Zero-copy variants of readString() and readBinary().
+   *
+   * On return data points directly into the transport's read buffer, so no
+   * allocation or copy is made.  The memory stays valid only for as long as
+   * the transport keeps the current frame (e.g. until a TMemoryBuffer is
+   * reset or a TFramedTransport reads the next frame).  Protocols that cannot
+   * lend their input (escaped or encoded strings, transports that do not
+   * support borrow()) throw TProtocolException::NOT_IMPLEMENTED.
+   */
+  uint32_t readStringView(const uint8_t*& data, uint32_t& size) {
+    T_VIRTUAL_CALL();
+    return readStringView_virt(data, size);
+  }
+
+  uint32_t readBinaryView(const uint8_t*& data, uint32_t& size) {
+    T_VIRTUAL_CALL();
+    return readBinaryView_virt(data, size);
+  }
+
+  /**
+   * readString() and readBinary() into a string of another type, see
+   * TStringSink.  The binary and compact protocols read straight into it;
+   * others read a std::string first and copy that.
+   */
+  uint32_t readStringInto(TStringSink& sink) {
+    T_VIRTUAL_CALL();
+    return readStringInto_virt(sink);
+  }
+
+  uint32_t readBinaryInto(TStringSink& sink) {
+    T_VIRTUAL_CALL();
+    return readBinaryInto_virt(sink);
+  }
+
+  /**
+   * Bulk variants of readByte() ... readDouble(): read count consecutive
+   * list elements into values, which must have room for all of them.
+   */
+  uint32_t readByteArray(int8_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readByteArray_virt(values, count);
+  }
+
+  uint32_t readI16Array(int16_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI16Array_virt(values, count);
+  }
+
+  uint32_t readI32Array(int32_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI64Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readDoubleArray_virt(values, count);
+  }
+
   /*
    * std::vector is specialized for bool, and its elements are individual bits
    * rather than bools.   We need to define a different version of readBool()
@@ -555,6 +772,35 @@ public:
     return readBool_virt(value);
   }
 
+  /**
+   * Pass-through of encoded values, used by lazily decoded fields.
+   *
+   * getRawProtocolId() returns the PROTOCOL_TYPES id of the encoding that
+   * readRawValue() captures and writeRawValue() emits, or -1 if values
+   * cannot be passed through this protocol verbatim.  readRawValue() stores
+   * the exact encoding of the next value of the given type in bytes and
+   * returns its size; if the transport does not have the whole value
+   * buffered it consumes nothing and returns 0, and the caller should read
+   * the value normally instead.
+   */
+  int32_t getRawProtocolId() {
+    T_VIRTUAL_CALL();
+    return getRawProtocolId_virt();
+  }
+  virtual int32_t getRawProtocolId_virt();
+
+  uint32_t readRawValue(TType type, std::string& bytes) {
+    T_VIRTUAL_CALL();
+    return readRawValue_virt(type, bytes);
+  }
+  virtual uint32_t readRawValue_virt(TType type, std::string& bytes);
+
+  uint32_t writeRawValue(const std::string& bytes) {
+    T_VIRTUAL_CALL();
+    return writeRawValue_virt(bytes);
+  }
+  virtual uint32_t writeRawValue_virt(const std::string& bytes);
+
   /**
    * Method to arbitrarily skip over data.
    */
@@ -596,6 +842,90 @@ public:
     return 0;
   }
 
+  /**
+   * Encoded sizes for the generated serializedSize(), which calls them in the
+   * order write() would write the values.  A protocol that does not know its
+   * sizes up front reports 0, so nothing gets reserved.
+   */
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid) {
+    T_VIRTUAL_CALL();
+    return serializedSizeMessageBegin_virt(name, messageType, seqid);
+  }
+
+  uint32_t serializedSizeFieldBegin(const TType fieldType,
+                                    const int16_t fieldId,
+                                    const int16_t lastFieldId) {
+    T_VIRTUAL_CALL();
+    return serializedSizeFieldBegin_virt(fieldType, fieldId, lastFieldId);
+  }
+
+  uint32_t serializedSizeStop() {
+    T_VIRTUAL_CALL();
+    return serializedSizeStop_virt();
+  }
+
+  uint32_t serializedSizeMapBegin(const TType keyType, const TType valType, const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeMapBegin_virt(keyType, valType, size);
+  }
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeListBegin_virt(elemType, size);
+  }
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeSetBegin_virt(elemType, size);
+  }
+
+  uint32_t serializedSizeBool(const bool value) {
+    T_VIRTUAL_CALL();
+    return serializedSizeBool_virt(value);
+  }
+
+  uint32_t serializedSizeByte(const int8_t byte) {
+    T_VIRTUAL_CALL();
+    return serializedSizeByte_virt(byte);
+  }
+
+  uint32_t serializedSizeI16(const int16_t i16) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI16_virt(i16);
+  }
+
+  uint32_t serializedSizeI32(const int32_t i32) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI32_virt(i32);
+  }
+
+  uint32_t serializedSizeI64(const int64_t i64) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI64_virt(i64);
+  }
+
+  uint32_t serializedSizeDouble(const double dub) {
+    T_VIRTUAL_CALL();
+    return serializedSizeDouble_virt(dub);
+  }
+
+  uint32_t serializedSizeString(const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeString_virt(size);
+  }
+
+  uint32_t serializedSizeBinary(const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeBinary_virt(size);
+  }
+
+  uint32_t serializedSizeUUID() {
+    T_VIRTUAL_CALL();
+    return serializedSizeUUID_virt();
+  }
+
 protected:
   TProtocol(std::shared_ptr<TTransport> ptrans)
     : ptrans_(ptrans), input_recursion_depth_(0), output_recursion_depth_(0),
@@ -792,6 +1122,66 @@ uint32_t skip(Protocol_& prot, TType type) {
                            "invalid TType");
 }
 
+/**
+ * Helper for protocol-specific skip() implementations: discard len bytes
+ * of input without decoding them.  Whatever the transport has buffered is
+ * dropped with borrow()/consume(); the rest is read into a scratch buffer.
+ */
+template <class Transport_>
+uint32_t skipBytes(Transport_& trans, uint64_t len) {
+  uint64_t remaining = len;
+  while (remaining > 0) {
+    uint32_t avail = 1;
+    if (trans.borrow(nullptr, &avail) != nullptr) {
+      uint32_t n = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(avail), remaining));
+      trans.consume(n);
+      remaining -= n;
+    } else {
+      uint8_t scratch[512];
+      uint32_t n = static_cast<uint32_t>(
+          (std::min)(static_cast<uint64_t>(sizeof(scratch)), remaining));
+      trans.readAll(scratch, n);
+      remaining -= n;
+    }
+  }
+  return static_cast<uint32_t>(len);
+}
+
+/**
+ * readString()/readBinary() and writeString()/writeBinary() for string types
+ * other than std::string, such as the std::pmr::string members generated
+ * with cpp:pmr.  The bytes go straight between str and the protocol.
+ */
+template <class Protocol_, class String_>
+uint32_t readStringAs(Protocol_* iprot, String_& str) {
+  TStringSinkT<String_> sink(str);
+  return iprot->readStringInto(sink);
+}
+
+template <class Protocol_, class String_>
+uint32_t readBinaryAs(Protocol_* iprot, String_& str) {
+  TStringSinkT<String_> sink(str);
+  return iprot->readBinaryInto(sink);
+}
+
+template <class Protocol_, class String_>
+uint32_t writeStringAs(Protocol_* oprot, const String_& str) {
+  if (str.size() > static_cast<size_t>((std::numeric_limits<int32_t>::max)())) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  return oprot->writeStringView(reinterpret_cast<const uint8_t*>(str.data()),
+                                static_cast<uint32_t>(str.size()));
+}
+
+template <class Protocol_, class String_>
+uint32_t writeBinaryAs(Protocol_* oprot, const String_& str) {
+  if (str.size() > static_cast<size_t>((std::numeric_limits<int32_t>::max)())) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  return oprot->writeBinaryView(reinterpret_cast<const uint8_t*>(str.data()),
+                                static_cast<uint32_t>(str.size()));
+}
+
 }}} // apache::thrift::protocol
 
 #endif // #define _THRIFT_PROTOCOL_TPROTOCOL_H_ 1
@@ -92,7 +92,79 @@ public:
   uint32_t writeDouble_virt(const double dub) override { return protocol->writeDouble(dub); }
   uint32_t writeString_virt(const std::string& str) override { return protocol->writeString(str); }
   uint32_t writeBinary_virt(const std::string& str) override { return protocol->writeBinary(str); }
+  uint32_t writeStringView_virt(const uint8_t* data, uint32_t size) override {
+    return protocol->writeStringView(data, size);
+  }
+  uint32_t writeBinaryView_virt(const uint8_t* data, uint32_t size) override {
+    return protocol->writeBinaryView(data, size);
+  }
   uint32_t writeUUID_virt(const TUuid& uuid) override { return protocol->writeUUID(uuid); }
+  uint32_t writeByteArray_virt(const int8_t* values, const uint32_t count) override {
+    return protocol->writeByteArray(values, count);
+  }
+  uint32_t writeI16Array_virt(const int16_t* values, const uint32_t count) override {
+    return protocol->writeI16Array(values, count);
+  }
+  uint32_t writeI32Array_virt(const int32_t* values, const uint32_t count) override {
+    return protocol->writeI32Array(values, count);
+  }
+  uint32_t writeI64Array_virt(const int64_t* values, const uint32_t count) override {
+    return protocol->writeI64Array(values, count);
+  }
+  uint32_t writeDoubleArray_virt(const double* values, const uint32_t count) override {
+    return protocol->writeDoubleArray(values, count);
+  }
+  uint32_t serializedSizeMessageBegin_virt(const std::string& name,
+                                           const TMessageType messageType,
+                                           const int32_t seqid) override {
+    return protocol->serializedSizeMessageBegin(name, messageType, seqid);
+  }
+  uint32_t serializedSizeFieldBegin_virt(const TType fieldType,
+                                         const int16_t fieldId,
+                                         const int16_t lastFieldId) override {
+    return protocol->serializedSizeFieldBegin(fieldType, fieldId, lastFieldId);
+  }
+  uint32_t serializedSizeStop_virt() override {
+    return protocol->serializedSizeStop();
+  }
+  uint32_t serializedSizeMapBegin_virt(const TType keyType,
+                                       const TType valType,
+                                       const uint32_t size) override {
+    return protocol->serializedSizeMapBegin(keyType, valType, size);
+  }
+  uint32_t serializedSizeListBegin_virt(const TType elemType, const uint32_t size) override {
+    return protocol->serializedSizeListBegin(elemType, size);
+  }
+  uint32_t serializedSizeSetBegin_virt(const TType elemType, const uint32_t size) override {
+    return protocol->serializedSizeSetBegin(elemType, size);
+  }
+  uint32_t serializedSizeBool_virt(const bool value) override {
+    return protocol->serializedSizeBool(value);
+  }
+  uint32_t serializedSizeByte_virt(const int8_t byte) override {
+    return protocol->serializedSizeByte(byte);
+  }
+  uint32_t serializedSizeI16_virt(const int16_t i16) override {
+    return protocol->serializedSizeI16(i16);
+  }
+  uint32_t serializedSizeI32_virt(const int32_t i32) override {
+    return protocol->serializedSizeI32(i32);
+  }
+  uint32_t serializedSizeI64_virt(const int64_t i64) override {
+    return protocol->serializedSizeI64(i64);
+  }
+  uint32_t serializedSizeDouble_virt(const double dub) override {
+    return protocol->serializedSizeDouble(dub);
+  }
+  uint32_t serializedSizeString_virt(const uint32_t size) override {
+    return protocol->serializedSizeString(size);
+  }
+  uint32_t serializedSizeBinary_virt(const uint32_t size) override {
+    return protocol->serializedSizeBinary(size);
+  }
+  uint32_t serializedSizeUUID_virt() override {
+    return protocol->serializedSizeUUID();
+  }
 
   uint32_t readMessageBegin_virt(std::string& name,
                                          TMessageType& messageType,
@@ -142,6 +214,40 @@ public:
   uint32_t readString_virt(std::string& str) override { return protocol->readString(str); }
   uint32_t readBinary_virt(std::string& str) override { return protocol->readBinary(str); }
   uint32_t readUUID_virt(TUuid& uuid) override { return protocol->readUUID(uuid); }
+  uint32_t readStringView_virt(const uint8_t*& data, uint32_t& size) override {
+    return protocol->readStringView(data, size);
+  }
+  uint32_t readBinaryView_virt(const uint8_t*& data, uint32_t& size) override {
+    return protocol->readBinaryView(data, size);
+  }
+  uint32_t readStringInto_virt(TStringSink& sink) override {
+    return protocol->readStringInto(sink);
+  }
+  uint32_t readBinaryInto_virt(TStringSink& sink) override {
+    return protocol->readBinaryInto(sink);
+  }
+  int32_t getRawProtocolId_virt() override { return protocol->getRawProtocolId(); }
+  uint32_t readRawValue_virt(TType type, std::string& bytes) override {
+    return protocol->readRawValue(type, bytes);
+  }
+  uint32_t writeRawValue_virt(const std::string& bytes) override {
+    return protocol->writeRawValue(bytes);
+  }
+  uint32_t readByteArray_virt(int8_t* values, const uint32_t count) override {
+    return protocol->readByteArray(values, count);
+  }
+  uint32_t readI16Array_virt(int16_t* values, const uint32_t count) override {
+    return protocol->readI16Array(values, count);
+  }
+  uint32_t readI32Array_virt(int32_t* values, const uint32_t count) override {
+    return protocol->readI32Array(values, count);
+  }
+  uint32_t readI64Array_virt(int64_t* values, const uint32_t count) override {
+    return protocol->readI64Array(values, count);
+  }
+  uint32_t readDoubleArray_virt(double* values, const uint32_t count) override {
+    return protocol->readDoubleArray(values, count);
+  }
 
 private:
   shared_ptr<TProtocol> protocol;
@@ -172,6 +172,18 @@ public:
     return rv;
   }
 
+  uint32_t readStringView(const uint8_t*& data, uint32_t& size) {
+    uint32_t rv = source_->readStringView(data, size);
+    sink_->writeString(std::string(reinterpret_cast<const char*>(data), size));
+    return rv;
+  }
+
+  uint32_t readBinaryView(const uint8_t*& data, uint32_t& size) {
+    uint32_t rv = source_->readBinaryView(data, size);
+    sink_->writeBinary(std::string(reinterpret_cast<const char*>(data), size));
+    return rv;
+  }
+
 private:
   std::shared_ptr<TProtocol> source_;
   std::shared_ptr<TProtocol> sink_;
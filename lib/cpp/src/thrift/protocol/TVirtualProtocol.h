@@ -169,6 +169,150 @@ public:
                              "this protocol does not support reading (yet).");
   }
 
+  uint32_t readStringView(const uint8_t*& data, uint32_t& size) {
+    (void)data;
+    (void)size;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support zero-copy string reads.");
+  }
+
+  uint32_t readBinaryView(const uint8_t*& data, uint32_t& size) {
+    (void)data;
+    (void)size;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support zero-copy binary reads.");
+  }
+
+  uint32_t readStringInto(TStringSink& sink) { return TProtocol::readStringInto_virt(sink); }
+
+  uint32_t readBinaryInto(TStringSink& sink) { return TProtocol::readBinaryInto_virt(sink); }
+
+  /*
+   * The bulk array methods default to one virtual call per element, so a
+   * protocol only needs to provide them when it can do better.
+   */
+  uint32_t readByteArray(int8_t* values, const uint32_t count) {
+    return TProtocol::readByteArray_virt(values, count);
+  }
+
+  uint32_t readI16Array(int16_t* values, const uint32_t count) {
+    return TProtocol::readI16Array_virt(values, count);
+  }
+
+  uint32_t readI32Array(int32_t* values, const uint32_t count) {
+    return TProtocol::readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, const uint32_t count) {
+    return TProtocol::readI64Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, const uint32_t count) {
+    return TProtocol::readDoubleArray_virt(values, count);
+  }
+
+  int32_t getRawProtocolId() { return TProtocol::getRawProtocolId_virt(); }
+
+  uint32_t readRawValue(TType type, std::string& bytes) {
+    return TProtocol::readRawValue_virt(type, bytes);
+  }
+
+  uint32_t writeRawValue(const std::string& bytes) {
+    return TProtocol::writeRawValue_virt(bytes);
+  }
+
+  uint32_t writeStringView(const uint8_t* data, uint32_t size) {
+    return TProtocol::writeStringView_virt(data, size);
+  }
+
+  uint32_t writeBinaryView(const uint8_t* data, uint32_t size) {
+    return TProtocol::writeBinaryView_virt(data, size);
+  }
+
+  uint32_t writeByteArray(const int8_t* values, const uint32_t count) {
+    return TProtocol::writeByteArray_virt(values, count);
+  }
+
+  uint32_t writeI16Array(const int16_t* values, const uint32_t count) {
+    return TProtocol::writeI16Array_virt(values, count);
+  }
+
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count) {
+    return TProtocol::writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count) {
+    return TProtocol::writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count) {
+    return TProtocol::writeDoubleArray_virt(values, count);
+  }
+
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid) {
+    return TProtocol::serializedSizeMessageBegin_virt(name, messageType, seqid);
+  }
+
+  uint32_t serializedSizeFieldBegin(const TType fieldType,
+                                    const int16_t fieldId,
+                                    const int16_t lastFieldId) {
+    return TProtocol::serializedSizeFieldBegin_virt(fieldType, fieldId, lastFieldId);
+  }
+
+  uint32_t serializedSizeStop() {
+    return TProtocol::serializedSizeStop_virt();
+  }
+
+  uint32_t serializedSizeMapBegin(const TType keyType, const TType valType, const uint32_t size) {
+    return TProtocol::serializedSizeMapBegin_virt(keyType, valType, size);
+  }
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size) {
+    return TProtocol::serializedSizeListBegin_virt(elemType, size);
+  }
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size) {
+    return TProtocol::serializedSizeSetBegin_virt(elemType, size);
+  }
+
+  uint32_t serializedSizeBool(const bool value) {
+    return TProtocol::serializedSizeBool_virt(value);
+  }
+
+  uint32_t serializedSizeByte(const int8_t byte) {
+    return TProtocol::serializedSizeByte_virt(byte);
+  }
+
+  uint32_t serializedSizeI16(const int16_t i16) {
+    return TProtocol::serializedSizeI16_virt(i16);
+  }
+
+  uint32_t serializedSizeI32(const int32_t i32) {
+    return TProtocol::serializedSizeI32_virt(i32);
+  }
+
+  uint32_t serializedSizeI64(const int64_t i64) {
+    return TProtocol::serializedSizeI64_virt(i64);
+  }
+
+  uint32_t serializedSizeDouble(const double dub) {
+    return TProtocol::serializedSizeDouble_virt(dub);
+  }
+
+  uint32_t serializedSizeString(const uint32_t size) {
+    return TProtocol::serializedSizeString_virt(size);
+  }
+
+  uint32_t serializedSizeBinary(const uint32_t size) {
+    return TProtocol::serializedSizeBinary_virt(size);
+  }
+
+  uint32_t serializedSizeUUID() {
+    return TProtocol::serializedSizeUUID_virt();
+  }
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -397,6 +541,100 @@ public:
     return static_cast<Protocol_*>(this)->writeUUID(uuid);
   }
 
+  uint32_t writeStringView_virt(const uint8_t* data, uint32_t size) override {
+    return static_cast<Protocol_*>(this)->writeStringView(data, size);
+  }
+
+  uint32_t writeBinaryView_virt(const uint8_t* data, uint32_t size) override {
+    return static_cast<Protocol_*>(this)->writeBinaryView(data, size);
+  }
+
+  uint32_t writeByteArray_virt(const int8_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeByteArray(values, count);
+  }
+
+  uint32_t writeI16Array_virt(const int16_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI16Array(values, count);
+  }
+
+  uint32_t writeI32Array_virt(const int32_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI32Array(values, count);
+  }
+
+  uint32_t writeI64Array_virt(const int64_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI64Array(values, count);
+  }
+
+  uint32_t writeDoubleArray_virt(const double* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeDoubleArray(values, count);
+  }
+
+  uint32_t serializedSizeMessageBegin_virt(const std::string& name,
+                                           const TMessageType messageType,
+                                           const int32_t seqid) override {
+    return static_cast<Protocol_*>(this)->serializedSizeMessageBegin(name, messageType, seqid);
+  }
+
+  uint32_t serializedSizeFieldBegin_virt(const TType fieldType,
+                                         const int16_t fieldId,
+                                         const int16_t lastFieldId) override {
+    return static_cast<Protocol_*>(this)->serializedSizeFieldBegin(fieldType, fieldId, lastFieldId);
+  }
+
+  uint32_t serializedSizeStop_virt() override {
+    return static_cast<Protocol_*>(this)->serializedSizeStop();
+  }
+
+  uint32_t serializedSizeMapBegin_virt(const TType keyType,
+                                       const TType valType,
+                                       const uint32_t size) override {
+    return static_cast<Protocol_*>(this)->serializedSizeMapBegin(keyType, valType, size);
+  }
+
+  uint32_t serializedSizeListBegin_virt(const TType elemType, const uint32_t size) override {
+    return static_cast<Protocol_*>(this)->serializedSizeListBegin(elemType, size);
+  }
+
+  uint32_t serializedSizeSetBegin_virt(const TType elemType, const uint32_t size) override {
+    return static_cast<Protocol_*>(this)->serializedSizeSetBegin(elemType, size);
+  }
+
+  uint32_t serializedSizeBool_virt(const bool value) override {
+    return static_cast<Protocol_*>(this)->serializedSizeBool(value);
+  }
+
+  uint32_t serializedSizeByte_virt(const int8_t byte) override {
+    return static_cast<Protocol_*>(this)->serializedSizeByte(byte);
+  }
+
+  uint32_t serializedSizeI16_virt(const int16_t i16) override {
+    return static_cast<Protocol_*>(this)->serializedSizeI16(i16);
+  }
+
+  uint32_t serializedSizeI32_virt(const int32_t i32) override {
+    return static_cast<Protocol_*>(this)->serializedSizeI32(i32);
+  }
+
+  uint32_t serializedSizeI64_virt(const int64_t i64) override {
+    return static_cast<Protocol_*>(this)->serializedSizeI64(i64);
+  }
+
+  uint32_t serializedSizeDouble_virt(const double dub) override {
+    return static_cast<Protocol_*>(this)->serializedSizeDouble(dub);
+  }
+
+  uint32_t serializedSizeString_virt(const uint32_t size) override {
+    return static_cast<Protocol_*>(this)->serializedSizeString(size);
+  }
+
+  uint32_t serializedSizeBinary_virt(const uint32_t size) override {
+    return static_cast<Protocol_*>(this)->serializedSizeBinary(size);
+  }
+
+  uint32_t serializedSizeUUID_virt() override {
+    return static_cast<Protocol_*>(this)->serializedSizeUUID();
+  }
+
   /**
    * Reading functions
    */
@@ -479,6 +717,54 @@ public:
     return static_cast<Protocol_*>(this)->readUUID(uuid);
   }
 
+  uint32_t readStringView_virt(const uint8_t*& data, uint32_t& size) override {
+    return static_cast<Protocol_*>(this)->readStringView(data, size);
+  }
+
+  uint32_t readBinaryView_virt(const uint8_t*& data, uint32_t& size) override {
+    return static_cast<Protocol_*>(this)->readBinaryView(data, size);
+  }
+
+  uint32_t readStringInto_virt(TStringSink& sink) override {
+    return static_cast<Protocol_*>(this)->readStringInto(sink);
+  }
+
+  uint32_t readBinaryInto_virt(TStringSink& sink) override {
+    return static_cast<Protocol_*>(this)->readBinaryInto(sink);
+  }
+
+  uint32_t readByteArray_virt(int8_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readByteArray(values, count);
+  }
+
+  uint32_t readI16Array_virt(int16_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI16Array(values, count);
+  }
+
+  uint32_t readI32Array_virt(int32_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI32Array(values, count);
+  }
+
+  uint32_t readI64Array_virt(int64_t* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI64Array(values, count);
+  }
+
+  uint32_t readDoubleArray_virt(double* values, const uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readDoubleArray(values, count);
+  }
+
+  int32_t getRawProtocolId_virt() override {
+    return static_cast<Protocol_*>(this)->getRawProtocolId();
+  }
+
+  uint32_t readRawValue_virt(TType type, std::string& bytes) override {
+    return static_cast<Protocol_*>(this)->readRawValue(type, bytes);
+  }
+
+  uint32_t writeRawValue_virt(const std::string& bytes) override {
+    return static_cast<Protocol_*>(this)->writeRawValue(bytes);
+  }
+
   uint32_t skip_virt(TType type) override { return static_cast<Protocol_*>(this)->skip(type); }
 
   /*
@@ -21,12 +21,16 @@
 
 #include <thrift/server/TNonblockingServer.h>
 #include <thrift/concurrency/Exception.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/transport/PlatformSocket.h>
 
 #include <algorithm>
+#include <deque>
 #include <iostream>
+#include <typeinfo>
 
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -57,6 +61,10 @@
 #include <fcntl.h>
 #endif
 
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
 #include <assert.h>
 
 #ifdef HAVE_SCHED_H
@@ -106,6 +114,14 @@ enum TAppState {
   APP_CLOSE_CONNECTION
 };
 
+/// How often an IO thread polls the sockets closed with zero copy sends
+/// pending, and how long it waits for the kernel before resetting them
+static const int ZERO_COPY_POLL_MS = 10;
+static const int ZERO_COPY_RELEASE_TIMEOUT_MS = 30000;
+
+/// States of a request of a pipelined connection
+enum TRequestState { REQUEST_FREE, REQUEST_RUNNING, REQUEST_DONE, REQUEST_DROPPED, REQUEST_SENDING };
+
 /**
  * Represents a connection that is handled via libevent. This connection
  * essentially encapsulates a socket that has some associated libevent state.
@@ -163,12 +179,24 @@ private:
   /// Count of the number of calls for use with getResizeBufferEveryN().
   int32_t callsForResize_;
 
+  /// Pool the buffers are borrowed from, if any
+  TBufferPool* bufferPool_;
+
+  /// Capacity of the write buffer borrowed from the pool, 0 if none
+  uint32_t writeBufferLent_;
+
   /// Transport to read from
   std::shared_ptr<TMemoryBuffer> inputTransport_;
 
   /// Transport that processor writes to
   std::shared_ptr<TMemoryBuffer> outputTransport_;
 
+  /// Responses sent with MSG_ZEROCOPY whose pages the kernel may still use
+  std::vector<std::shared_ptr<TMemoryBuffer> > zeroCopyBuffers_;
+
+  /// Released zero copy buffer, swapped in when the next response is pinned
+  std::shared_ptr<TMemoryBuffer> spareWriteBuffer_;
+
   /// extra transport generated by transport factory (e.g. BufferedRouterTransport)
   std::shared_ptr<TTransport> factoryInputTransport_;
   std::shared_ptr<TTransport> factoryOutputTransport_;
@@ -185,6 +213,59 @@ private:
   /// Thrift call context, if any
   void* connectionContext_;
 
+  /// A request of a pipelined connection, from its frame to its response
+  struct Request {
+    Request() : buffer(nullptr), bufferSize(0), outputLent(0), state(REQUEST_FREE) {}
+    ~Request() { std::free(buffer); }
+
+    /// The frame, as read into readBuffer_
+    uint8_t* buffer;
+    uint32_t bufferSize;
+
+    std::shared_ptr<TMemoryBuffer> inputTransport;
+    std::shared_ptr<TMemoryBuffer> outputTransport;
+    std::shared_ptr<TTransport> factoryInputTransport;
+    std::shared_ptr<TTransport> factoryOutputTransport;
+    std::shared_ptr<TProtocol> inputProtocol;
+    std::shared_ptr<TProtocol> outputProtocol;
+
+    /// Capacity of the write buffer borrowed from the pool, 0 if none
+    uint32_t outputLent;
+
+    /// A TRequestState; the task sets it to done before notifying
+    std::atomic<int> state;
+  };
+
+  /// Whether requests are read ahead and answered out of order
+  bool pipelined_;
+
+  /// Requests of a pipelined connection, in use or not
+  std::vector<std::unique_ptr<Request> > requests_;
+
+  /// Requests not in use
+  std::vector<Request*> freeRequests_;
+
+  /// Requests handed to the thread manager and not yet taken back
+  size_t requestsRunning_;
+
+  /// Responses waiting to be written, the one being written first
+  std::deque<Request*> sendQueue_;
+
+  /// Set when the connection is to close once no request is running
+  bool closing_;
+
+  /// Set when the client shut down its side of a pipelined connection
+  bool readClosed_;
+
+  /// Next connection on the IO thread's pending notifications
+  TConnection* nextNotified_;
+
+  /// notifyIOThread() calls the IO thread has not seen yet; only the one
+  /// that raises it from 0 queues the connection
+  std::atomic<uint32_t> notifyCount_;
+
+  friend class TNonblockingIOThread;
+
   /// Go into read mode
   void setRead() { setFlags(EV_READ | EV_PERSIST); }
 
@@ -194,6 +275,103 @@ private:
   /// Set socket idle
   void setIdle() { setFlags(0); }
 
+  /// Read if another request may start, write if a response is waiting
+  void setPipelinedFlags();
+
+  /// Whether a pipelined connection may read another request
+  bool canReadRequest() const {
+    return !closing_ && !readClosed_
+           && requests_.size() - freeRequests_.size() < server_->getPipelineDepth();
+  }
+
+  /// Wrap the buffers in the server's transports and protocols
+  void createProtocols(const std::shared_ptr<TMemoryBuffer>& input,
+                       const std::shared_ptr<TMemoryBuffer>& output,
+                       std::shared_ptr<TTransport>& factoryInput,
+                       std::shared_ptr<TTransport>& factoryOutput,
+                       std::shared_ptr<TProtocol>& inputProtocol,
+                       std::shared_ptr<TProtocol>& outputProtocol);
+
+  /**
+   * Hands the frame just read to the thread manager as a request of its
+   * own, and goes on reading the next one.
+   *
+   * @return false if the request could not be started and the connection
+   *         has to be closed.
+   */
+  bool dispatchRequest();
+
+  /**
+   * Takes back a request whose task has finished and queues its response.
+   */
+  void completeRequest();
+
+  /**
+   * Writes as much of the queued responses as the socket takes.
+   *
+   * @return false if the connection was closed.
+   */
+  bool sendResponses();
+
+  /// Put a request back on the free list
+  void releaseRequest(Request* request) {
+    if (bufferPool_) {
+      bufferPool_->release(request->buffer, request->bufferSize);
+      request->buffer = nullptr;
+      request->bufferSize = 0;
+      returnBuffer(*request->outputTransport, request->outputLent);
+    }
+    request->state.store(REQUEST_FREE, std::memory_order_relaxed);
+    freeRequests_.push_back(request);
+  }
+
+  /**
+   * Gives a memory buffer storage of at least size bytes from the pool.
+   *
+   * @return false if the pool's budget does not allow it.
+   */
+  bool borrowBuffer(TMemoryBuffer& buffer, uint32_t size, uint32_t& lent);
+
+  /// Gives the storage a memory buffer borrowed from the pool back
+  void returnBuffer(TMemoryBuffer& buffer, uint32_t& lent);
+
+  /// Gives the read buffer back to the pool, if it is borrowed
+  void returnReadBuffer();
+
+  /**
+   * Marks a request as dropped before it ran, for the IO thread to close
+   * the connection.  Called from outside the IO thread.
+   */
+  void dropRequest(Request* request);
+
+  /**
+   * Closes the connection now, or once no request is running anymore if it
+   * is pipelined.
+   */
+  void closeWhenIdle();
+
+  /**
+   * Stops reading a pipelined connection whose client shut down its side,
+   * and closes it once every running request's response is sent.
+   *
+   * @return false if the connection was closed.
+   */
+  bool closeWhenSent();
+
+  /**
+   * Keeps the response just sent in zeroCopyBuffers_ until the kernel
+   * releases it, and gives outputTransport_ another buffer meanwhile.
+   */
+  void pinWriteBuffer();
+
+  /**
+   * Reads the zero copy completions of the socket and releases the pinned
+   * responses once none is pending.
+   *
+   * @return true if any completion was read.
+   */
+  bool reapZeroCopy();
+
   /**
    * Set event flags for this connection.
    *
@@ -205,9 +383,12 @@ private:
    * Libevent handler called (via our static wrapper) when the connection
    * socket had something happen.  Rather than use the flags libevent passed,
    * we use the connection state to determine whether we need to read or
-   * write the socket.
+   * write the socket; only pipelined connections, which do both at once,
+   * look at the flags.
+   *
+   * @param which the flags associated with the event.
    */
-  void workSocket();
+  void workSocket(short which);
 
 public:
   class Task;
@@ -217,6 +398,8 @@ public:
               TNonblockingIOThread* ioThread) {
     readBuffer_ = nullptr;
     readBufferSize_ = 0;
+    nextNotified_ = nullptr;
+    notifyCount_ = 0;
 
     ioThread_ = ioThread;
     server_ = ioThread->getServer();
@@ -224,8 +407,13 @@ public:
     // Allocate input and output transports these only need to be allocated
     // once per TConnection (they don't need to be reallocated on init() call)
     inputTransport_.reset(new TMemoryBuffer(readBuffer_, readBufferSize_));
-    outputTransport_.reset(
-        new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    if (server_->getBufferPool()) {
+      // The write buffer is borrowed for each request
+      outputTransport_.reset(new TMemoryBuffer(nullptr, 0));
+    } else {
+      outputTransport_.reset(
+          new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    }
 
     tSocket_ =  socket;
 
@@ -255,8 +443,12 @@ public:
    * This is called when the application transitions from one state into
    * another. This means that it has finished writing the data that it needed
    * to, or finished receiving the data that it needed to.
+   *
+   * @return false if the connection has to be closed, because a frame could
+   *         not be handled or APP_CLOSE_CONNECTION was asked for.  The caller
+   *         closes it then, as nothing may touch the connection after that.
    */
-  void transition();
+  bool transition();
 
   /**
    * C-callable event handler for connection events.  Provides a callback
@@ -266,9 +458,9 @@ public:
    * @param which the flags associated with the event.
    * @param v void* callback arg where we placed TConnection's "this".
    */
-  static void eventHandler(evutil_socket_t fd, short /* which */, void* v) {
+  static void eventHandler(evutil_socket_t fd, short which, void* v) {
     assert(fd == static_cast<evutil_socket_t>(((TConnection*)v)->getTSocket()->getSocketFD()));
-    ((TConnection*)v)->workSocket();
+    ((TConnection*)v)->workSocket(which);
   }
 
   /**
@@ -282,6 +474,19 @@ public:
    */
   bool notifyIOThread() { return ioThread_->notify(this); }
 
+  /**
+   * Called by the IO thread for each notifyIOThread().  A pipelined
+   * connection takes back one finished request, any other connection moves
+   * on to its next state.
+   */
+  void notified() {
+    if (pipelined_ && appState_ != APP_INIT) {
+      completeRequest();
+    } else if (!transition()) {
+      close();
+    }
+  }
+
   /*
    * Returns the number of this connection's currently assigned IO
    * thread.
@@ -304,6 +509,9 @@ public:
   /// get state of connection.
   TAppState getState() const { return appState_; }
 
+  /// whether requests are read ahead and answered out of order
+  bool isPipelined() const { return pipelined_; }
+
   /// return the TSocket transport wrapping this network connection
   std::shared_ptr<TSocket> getTSocket() const { return tSocket_; }
 
@@ -319,11 +527,13 @@ public:
   Task(std::shared_ptr<TProcessor> processor,
        std::shared_ptr<TProtocol> input,
        std::shared_ptr<TProtocol> output,
-       TConnection* connection)
+       TConnection* connection,
+       Request* request = nullptr)
     : processor_(processor),
       input_(input),
       output_(output),
       connection_(connection),
+      request_(request),
       serverEventHandler_(connection_->getServerEventHandler()),
       connectionContext_(connection_->getConnectionContext()) {}
 
@@ -351,22 +561,42 @@ public:
       TOutput::instance().printf("TNonblockingServer: unknown exception while processing.");
     }
 
-    // Signal completion back to the libevent thread via a pipe
+    if (request_) {
+      request_->state.store(REQUEST_DONE, std::memory_order_release);
+    }
+
+    // Signal completion back to the libevent thread via a pipe.  Once queued
+    // the notification is seen even if waking the thread up failed, so the
+    // request of a pipelined connection is always taken back.
     if (!connection_->notifyIOThread()) {
       TOutput::instance().printf("TNonblockingServer: failed to notifyIOThread, closing.");
-      connection_->server_->decrementActiveProcessors();
-      connection_->close();
+      // The IO thread has shut down.  A pipelined connection may still be
+      // in use by it, so it is left for the server to close on destruction.
+      if (!request_) {
+        connection_->server_->decrementActiveProcessors();
+        connection_->close();
+      }
       throw TException("TNonblockingServer::Task::run: failed write on notify pipe");
     }
   }
 
   TConnection* getTConnection() { return connection_; }
 
+  /// Force connection shutdown for a task that will not run.
+  void forceClose() {
+    if (request_) {
+      connection_->dropRequest(request_);
+    } else {
+      connection_->forceClose();
+    }
+  }
+
 private:
   std::shared_ptr<TProcessor> processor_;
   std::shared_ptr<TProtocol> input_;
   std::shared_ptr<TProtocol> output_;
   TConnection* connection_;
+  Request* request_;
   std::shared_ptr<TServerEventHandler> serverEventHandler_;
   void* connectionContext_;
 };
@@ -388,19 +618,24 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   socketState_ = SOCKET_RECV_FRAMING;
   callsForResize_ = 0;
 
-  // get input/transports
-  factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
-  factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
+  bufferPool_ = server_->getBufferPool().get();
+  writeBufferLent_ = 0;
 
-  // Create protocol
-  if (server_->getHeaderTransport()) {
-    inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_,
-                                                                     factoryOutputTransport_);
-    outputProtocol_ = inputProtocol_;
-  } else {
-    inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_);
-    outputProtocol_ = server_->getOutputProtocolFactory()->getProtocol(factoryOutputTransport_);
-  }
+  pipelined_ = server_->getPipelineDepth() > 1 && server_->isThreadPoolProcessing();
+  requestsRunning_ = 0;
+  closing_ = false;
+  readClosed_ = false;
+
+  // Responses of a pipelined connection, or in a borrowed buffer, are not
+  // pinned for zero copy
+  tSocket_->setZeroCopyThreshold(pipelined_ || bufferPool_ ? 0 : server_->getZeroCopyThreshold());
+
+  createProtocols(inputTransport_,
+                  outputTransport_,
+                  factoryInputTransport_,
+                  factoryOutputTransport_,
+                  inputProtocol_,
+                  outputProtocol_);
 
   // Set up for any server event handler
   serverEventHandler_ = server_->getEventHandler();
@@ -414,12 +649,57 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   processor_ = server_->getProcessor(inputProtocol_, outputProtocol_, tSocket_);
 }
 
+void TNonblockingServer::TConnection::createProtocols(const std::shared_ptr<TMemoryBuffer>& input,
+                                                      const std::shared_ptr<TMemoryBuffer>& output,
+                                                      std::shared_ptr<TTransport>& factoryInput,
+                                                      std::shared_ptr<TTransport>& factoryOutput,
+                                                      std::shared_ptr<TProtocol>& inputProtocol,
+                                                      std::shared_ptr<TProtocol>& outputProtocol) {
+  // get input/transports
+  factoryInput = server_->getInputTransportFactory()->getTransport(input);
+  factoryOutput = server_->getOutputTransportFactory()->getTransport(output);
+
+  // Create protocol
+  if (server_->getHeaderTransport()) {
+    inputProtocol = server_->getInputProtocolFactory()->getProtocol(factoryInput, factoryOutput);
+    outputProtocol = inputProtocol;
+  } else if (server_->specializedInputProtocolFactory_) {
+    inputProtocol = server_->specializedInputProtocolFactory_->getProtocol(factoryInput);
+    outputProtocol = server_->specializedOutputProtocolFactory_->getProtocol(factoryOutput);
+  } else {
+    inputProtocol = server_->getInputProtocolFactory()->getProtocol(factoryInput);
+    outputProtocol = server_->getOutputProtocolFactory()->getProtocol(factoryOutput);
+  }
+}
+
 void TNonblockingServer::TConnection::setSocket(std::shared_ptr<TSocket> socket) {
   tSocket_ = socket;
 }
 
-void TNonblockingServer::TConnection::workSocket() {
+void TNonblockingServer::TConnection::workSocket(short which) {
+  // Zero copy completions wake the connection up as an error condition,
+  // possibly with nothing to read
+  if (reapZeroCopy() && socketState_ != SOCKET_SEND && !tSocket_->hasPendingDataToRead()) {
+    return;
+  }
+
+  // A pipelined connection writes responses while it reads requests, its
+  // socket state only tracks the reading
+  if (pipelined_) {
+    if ((which & EV_WRITE) && !sendResponses()) {
+      return;
+    }
+    if (!(which & EV_READ)) {
+      return;
+    }
+  }
+
   while (true) {
+    // Leave the next frame in the socket until a request may start
+    if (pipelined_ && !canReadRequest()) {
+      return;
+    }
+
     int got = 0, left = 0, sent = 0;
     uint32_t fetch = 0;
 
@@ -438,17 +718,23 @@ void TNonblockingServer::TConnection::workSocket() {
         fetch = tSocket_->read(&framing.buf[readBufferPos_],
                                uint32_t(sizeof(framing.size) - readBufferPos_));
         if (fetch == 0) {
-          // Whenever we get here it means a remote disconnect
-          close();
+          // Whenever we get here it means a remote disconnect, though a
+          // pipelined client may still be waiting for its responses
+          if (pipelined_) {
+            closeWhenSent();
+          } else {
+            closeWhenIdle();
+          }
           return;
         }
+        ioThread_->countBytesRead(fetch);
         readBufferPos_ += fetch;
       } catch (TTransportException& te) {
         //In Nonblocking SSLSocket some operations need to be retried again.
         //Current approach is parsing exception message, but a better solution needs to be investigated.
         if(!strstr(te.what(), "retry")) {
           TOutput::instance().printf("TConnection::workSocket(): %s", te.what());
-          close();
+          closeWhenIdle();
 
           return;
         }
@@ -472,11 +758,14 @@ void TNonblockingServer::TConnection::workSocket() {
             readWant_,
             (uint64_t)server_->getMaxFrameSize(),
             tSocket_->getSocketInfo().c_str());
-        close();
+        closeWhenIdle();
         return;
       }
       // size known; now get the rest of the frame
-      transition();
+      if (!transition()) {
+        closeWhenIdle();
+        return;
+      }
 
       // If the socket has more data than the frame header, continue to work on it. This is not strictly necessary for
       // regular sockets, because if there is more data, libevent will fire the event handler registered for read
@@ -495,7 +784,7 @@ void TNonblockingServer::TConnection::workSocket() {
       // It is an error to be in this state if we already have all the data
       if (!(readBufferPos_ < readWant_)) {
         TOutput::instance().printf("TNonblockingServer: frame size too short");
-        close();
+        closeWhenIdle();
         return;
       }
 
@@ -508,13 +797,15 @@ void TNonblockingServer::TConnection::workSocket() {
         //Current approach is parsing exception message, but a better solution needs to be investigated.
         if(!strstr(te.what(), "retry")) {
           TOutput::instance().printf("TConnection::workSocket(): %s", te.what());
-          close();
+          closeWhenIdle();
         }
 
         return;
       }
 
       if (got > 0) {
+        ioThread_->countBytesRead(got);
+
         // Move along in the buffer
         readBufferPos_ += got;
 
@@ -523,7 +814,10 @@ void TNonblockingServer::TConnection::workSocket() {
 
         // We are done reading, move onto the next state
         if (readBufferPos_ == readWant_) {
-          transition();
+          if (!transition()) {
+            closeWhenIdle();
+            return;
+          }
           if (socketState_ == SOCKET_RECV_FRAMING && tSocket_->hasPendingDataToRead())
           {
               continue;
@@ -533,7 +827,11 @@ void TNonblockingServer::TConnection::workSocket() {
       }
 
       // Whenever we get down here it means a remote disconnect
-      close();
+      if (pipelined_) {
+        closeWhenSent();
+      } else {
+        closeWhenIdle();
+      }
 
       return;
 
@@ -553,10 +851,11 @@ void TNonblockingServer::TConnection::workSocket() {
         sent = tSocket_->write_partial(writeBuffer_ + writeBufferPos_, left);
       } catch (TTransportException& te) {
         TOutput::instance().printf("TConnection::workSocket(): %s ", te.what());
-        close();
+        closeWhenIdle();
         return;
       }
 
+      ioThread_->countBytesWritten(sent);
       writeBufferPos_ += sent;
 
       // Did we overdo it?
@@ -589,7 +888,7 @@ bool TNonblockingServer::getHeaderTransport() {
  * another. This means that it has finished writing the data that it needed
  * to, or finished receiving the data that it needed to.
  */
-void TNonblockingServer::TConnection::transition() {
+bool TNonblockingServer::TConnection::transition() {
   // ensure this connection is active right now
   assert(ioThread_);
   assert(server_);
@@ -598,6 +897,21 @@ void TNonblockingServer::TConnection::transition() {
   switch (appState_) {
 
   case APP_READ_REQUEST:
+    ioThread_->countRequest();
+
+    if (pipelined_) {
+      return dispatchRequest();
+    }
+
+    if (bufferPool_
+        && !borrowBuffer(*outputTransport_,
+                         static_cast<uint32_t>(server_->getWriteBufferDefaultSize()),
+                         writeBufferLent_)) {
+      TOutput::instance().printf("TNonblockingServer: buffer budget exceeded, closing client %s",
+                                 tSocket_->getSocketInfo().c_str());
+      return false;
+    }
+
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
     if (server_->getHeaderTransport()) {
@@ -637,14 +951,14 @@ void TNonblockingServer::TConnection::transition() {
         // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
         TOutput::instance().printf("IllegalStateException: Server::process() %s", ise.what());
         server_->decrementActiveProcessors();
-        close();
+        return false;
       } catch (TimedOutException& to) {
         TOutput::instance().printf("[ERROR] TimedOutException: Server::process() %s", to.what());
         server_->decrementActiveProcessors();
-        close();
+        return false;
       }
 
-      return;
+      return true;
     } else {
       try {
         if (serverEventHandler_) {
@@ -658,20 +972,17 @@ void TNonblockingServer::TConnection::transition() {
             "process(): %s",
             ttx.what());
         server_->decrementActiveProcessors();
-        close();
-        return;
+        return false;
       } catch (const std::exception& x) {
         TOutput::instance().printf("Server::process() uncaught exception: %s: %s",
                             typeid(x).name(),
                             x.what());
         server_->decrementActiveProcessors();
-        close();
-        return;
+        return false;
       } catch (...) {
         TOutput::instance().printf("Server::process() unknown exception");
         server_->decrementActiveProcessors();
-        close();
-        return;
+        return false;
       }
     }
     // fallthrough
@@ -685,6 +996,10 @@ void TNonblockingServer::TConnection::transition() {
     // the writeBuffer_ for actual writing by the libevent thread
 
     server_->decrementActiveProcessors();
+
+    // The request has been processed, a borrowed read buffer can go back
+    returnReadBuffer();
+
     // Get the result of the operation
     outputTransport_->getBuffer(&writeBuffer_, &writeBufferSize_);
 
@@ -705,7 +1020,7 @@ void TNonblockingServer::TConnection::transition() {
       appState_ = APP_SEND_RESULT;
       setWrite();
 
-      return;
+      return true;
     }
 
     // In this case, the request was oneway and we should fall through
@@ -713,6 +1028,12 @@ void TNonblockingServer::TConnection::transition() {
     goto LABEL_APP_INIT;
 
   case APP_SEND_RESULT:
+    // The kernel may still be reading a response sent without a copy
+    reapZeroCopy();
+    if (tSocket_->getZeroCopyPending() > 0) {
+      pinWriteBuffer();
+    }
+
     // it's now safe to perform buffer size housekeeping.
     if (writeBufferSize_ > largestWriteBufferSize_) {
       largestWriteBufferSize_ = writeBufferSize_;
@@ -730,6 +1051,9 @@ void TNonblockingServer::TConnection::transition() {
   LABEL_APP_INIT:
   case APP_INIT:
 
+    // Give back a borrowed write buffer
+    returnBuffer(*outputTransport_, writeBufferLent_);
+
     // Clear write buffer variables
     writeBuffer_ = nullptr;
     writeBufferPos_ = 0;
@@ -744,14 +1068,23 @@ void TNonblockingServer::TConnection::transition() {
     // Register read event
     setRead();
 
-    return;
+    return true;
 
   case APP_READ_FRAME_SIZE:
     readWant_ += 4;
 
     // We just read the request length
     // Double the buffer size until it is big enough
-    if (readWant_ > readBufferSize_) {
+    if (readWant_ > readBufferSize_ && bufferPool_) {
+      // Borrow a buffer that fits the frame
+      returnReadBuffer();
+      readBuffer_ = bufferPool_->allocate(readWant_, &readBufferSize_);
+      if (readBuffer_ == nullptr) {
+        TOutput::instance().printf("TNonblockingServer: buffer budget exceeded, closing client %s",
+                                   tSocket_->getSocketInfo().c_str());
+        return false;
+      }
+    } else if (readWant_ > readBufferSize_) {
       if (readBufferSize_ == 0) {
         readBufferSize_ = 1;
       }
@@ -776,16 +1109,16 @@ void TNonblockingServer::TConnection::transition() {
     socketState_ = SOCKET_RECV;
     appState_ = APP_READ_REQUEST;
 
-    return;
+    return true;
 
   case APP_CLOSE_CONNECTION:
     server_->decrementActiveProcessors();
-    close();
-    return;
+    return false;
 
   default:
     TOutput::instance().printf("Unexpected Application State %d", appState_);
     assert(0);
+    return false;
   }
 }
 
@@ -845,6 +1178,253 @@ void TNonblockingServer::TConnection::setFlags(short eventFlags) {
   }
 }
 
+void TNonblockingServer::TConnection::setPipelinedFlags() {
+  short eventFlags = 0;
+  if (canReadRequest()) {
+    eventFlags |= EV_READ;
+  }
+  if (!sendQueue_.empty()) {
+    eventFlags |= EV_WRITE;
+  }
+  setFlags(eventFlags ? eventFlags | EV_PERSIST : 0);
+}
+
+bool TNonblockingServer::TConnection::dispatchRequest() {
+  Request* request;
+  if (freeRequests_.empty()) {
+    requests_.push_back(std::unique_ptr<Request>(new Request));
+    request = requests_.back().get();
+    request->inputTransport.reset(new TMemoryBuffer(request->buffer, request->bufferSize));
+    if (bufferPool_) {
+      request->outputTransport.reset(new TMemoryBuffer(nullptr, 0));
+    } else {
+      request->outputTransport.reset(
+          new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    }
+    createProtocols(request->inputTransport,
+                    request->outputTransport,
+                    request->factoryInputTransport,
+                    request->factoryOutputTransport,
+                    request->inputProtocol,
+                    request->outputProtocol);
+  } else {
+    request = freeRequests_.back();
+    freeRequests_.pop_back();
+  }
+
+  // The request takes the frame and leaves its old buffer for the next one
+  std::swap(readBuffer_, request->buffer);
+  std::swap(readBufferSize_, request->bufferSize);
+
+  if (bufferPool_
+      && !borrowBuffer(*request->outputTransport,
+                       static_cast<uint32_t>(server_->getWriteBufferDefaultSize()),
+                       request->outputLent)) {
+    TOutput::instance().printf("TNonblockingServer: buffer budget exceeded, closing client %s",
+                               tSocket_->getSocketInfo().c_str());
+    releaseRequest(request);
+    return false;
+  }
+
+  if (server_->getHeaderTransport()) {
+    request->inputTransport->resetBuffer(request->buffer, readBufferPos_);
+    request->outputTransport->resetBuffer();
+  } else {
+    request->inputTransport->resetBuffer(request->buffer + 4, readBufferPos_ - 4);
+    request->outputTransport->resetBuffer();
+    request->outputTransport->getWritePtr(4);
+    request->outputTransport->wroteBytes(4);
+  }
+
+  request->state.store(REQUEST_RUNNING, std::memory_order_relaxed);
+  ++requestsRunning_;
+  server_->incrementActiveProcessors();
+
+  try {
+    server_->addTask(std::make_shared<Task>(
+        processor_, request->inputProtocol, request->outputProtocol, this, request));
+  } catch (IllegalStateException& ise) {
+    // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
+    TOutput::instance().printf("IllegalStateException: Server::process() %s", ise.what());
+    --requestsRunning_;
+    server_->decrementActiveProcessors();
+    releaseRequest(request);
+    return false;
+  } catch (TimedOutException& to) {
+    TOutput::instance().printf("[ERROR] TimedOutException: Server::process() %s", to.what());
+    --requestsRunning_;
+    server_->decrementActiveProcessors();
+    releaseRequest(request);
+    return false;
+  }
+
+  // Go on with the next frame while the request is processed
+  socketState_ = SOCKET_RECV_FRAMING;
+  appState_ = APP_READ_FRAME_SIZE;
+  readBufferPos_ = 0;
+  setPipelinedFlags();
+  return true;
+}
+
+void TNonblockingServer::TConnection::completeRequest() {
+  // Every task marks its request before it notifies, so there is a marked
+  // request for each notification, if not necessarily the notifier's own
+  Request* request = nullptr;
+  int state = REQUEST_FREE;
+  for (auto& candidate : requests_) {
+    state = candidate->state.load(std::memory_order_acquire);
+    if (state == REQUEST_DONE || state == REQUEST_DROPPED) {
+      request = candidate.get();
+      break;
+    }
+  }
+  assert(request != nullptr);
+
+  --requestsRunning_;
+  server_->decrementActiveProcessors();
+
+  if (state == REQUEST_DROPPED) {
+    // The request expired before it ran, and its client would wait forever
+    releaseRequest(request);
+    closing_ = true;
+  } else {
+    uint8_t* buffer;
+    uint32_t size;
+    request->outputTransport->getBuffer(&buffer, &size);
+
+    // 4 bytes were reserved for frame size, oneway requests leave nothing else
+    if (size > 4) {
+      auto frameSize = (int32_t)htonl(size - 4);
+      memcpy(buffer, &frameSize, 4);
+      request->state.store(REQUEST_SENDING, std::memory_order_relaxed);
+      sendQueue_.push_back(request);
+    } else {
+      releaseRequest(request);
+    }
+  }
+
+  if (closing_) {
+    closeWhenIdle();
+    return;
+  }
+  if (readClosed_) {
+    closeWhenSent();
+    return;
+  }
+  setPipelinedFlags();
+}
+
+bool TNonblockingServer::TConnection::sendResponses() {
+  while (!sendQueue_.empty()) {
+    Request* request = sendQueue_.front();
+    uint8_t* buffer;
+    uint32_t size;
+    request->outputTransport->getBuffer(&buffer, &size);
+
+    uint32_t sent;
+    try {
+      sent = tSocket_->write_partial(buffer + writeBufferPos_, size - writeBufferPos_);
+    } catch (TTransportException& te) {
+      TOutput::instance().printf("TConnection::workSocket(): %s ", te.what());
+      closeWhenIdle();
+      return false;
+    }
+
+    ioThread_->countBytesWritten(sent);
+    writeBufferPos_ += sent;
+    if (writeBufferPos_ < size) {
+      // The socket is full, go on when it can take more
+      return true;
+    }
+
+    writeBufferPos_ = 0;
+    sendQueue_.pop_front();
+    releaseRequest(request);
+
+    // Buffer housekeeping, unless a frame is being read into readBuffer_
+    if (server_->getResizeBufferEveryN() > 0
+        && ++callsForResize_ >= server_->getResizeBufferEveryN()
+        && socketState_ == SOCKET_RECV_FRAMING) {
+      checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
+                              server_->getIdleWriteBufferLimit());
+      callsForResize_ = 0;
+    }
+  }
+
+  if (readClosed_) {
+    return closeWhenSent();
+  }
+  setPipelinedFlags();
+  return true;
+}
+
+bool TNonblockingServer::TConnection::borrowBuffer(TMemoryBuffer& buffer,
+                                                   uint32_t size,
+                                                   uint32_t& lent) {
+  uint32_t capacity;
+  uint8_t* storage = bufferPool_->allocate(size, &capacity);
+  if (storage == nullptr) {
+    return false;
+  }
+  buffer.resetBuffer(storage, capacity, TMemoryBuffer::TAKE_OWNERSHIP);
+  buffer.resetBuffer();
+  lent = capacity;
+  return true;
+}
+
+void TNonblockingServer::TConnection::returnBuffer(TMemoryBuffer& buffer, uint32_t& lent) {
+  if (lent == 0) {
+    return;
+  }
+
+  // The buffer may have grown while the response was written
+  uint32_t capacity;
+  uint8_t* storage = buffer.releaseBuffer(&capacity);
+  if (capacity != lent) {
+    bufferPool_->resized(lent, capacity);
+  }
+  bufferPool_->release(storage, capacity);
+  lent = 0;
+}
+
+void TNonblockingServer::TConnection::returnReadBuffer() {
+  if (bufferPool_ && readBuffer_ != nullptr) {
+    bufferPool_->release(readBuffer_, readBufferSize_);
+    readBuffer_ = nullptr;
+    readBufferSize_ = 0;
+  }
+}
+
+void TNonblockingServer::TConnection::dropRequest(Request* request) {
+  request->state.store(REQUEST_DROPPED, std::memory_order_release);
+  if (!notifyIOThread()) {
+    throw TException("TConnection::dropRequest: failed write on notify pipe");
+  }
+}
+
+void TNonblockingServer::TConnection::closeWhenIdle() {
+  if (requestsRunning_ == 0) {
+    close();
+    return;
+  }
+
+  // The running requests' tasks still use the connection
+  closing_ = true;
+  setIdle();
+}
+
+bool TNonblockingServer::TConnection::closeWhenSent() {
+  readClosed_ = true;
+  if (requestsRunning_ == 0 && sendQueue_.empty()) {
+    close();
+    return false;
+  }
+
+  // Only write from now on, the finished requests bring us back here
+  setPipelinedFlags();
+  return true;
+}
+
 /**
  * Closes a connection
  */
@@ -854,10 +1434,24 @@ void TNonblockingServer::TConnection::close() {
   if (serverEventHandler_) {
     serverEventHandler_->deleteContext(connectionContext_, inputProtocol_, outputProtocol_);
   }
+  ioThread_->removeConnection();
+
+  // The kernel may still be reading responses sent without a copy, in
+  // which case the IO thread keeps them and closes the socket later
+  reapZeroCopy();
+  if (tSocket_->getZeroCopyPending() > 0) {
+    if (socketState_ == SOCKET_SEND) {
+      pinWriteBuffer();
+    }
+    ioThread_->releaseZeroCopy(tSocket_, zeroCopyBuffers_);
+  } else {
+    tSocket_->close();
+  }
   ioThread_ = nullptr;
 
-  // Close the socket
-  tSocket_->close();
+  // Give back what is borrowed from the buffer pool
+  returnReadBuffer();
+  returnBuffer(*outputTransport_, writeBufferLent_);
 
   // close any factory produced transports
   factoryInputTransport_->close();
@@ -866,11 +1460,23 @@ void TNonblockingServer::TConnection::close() {
   // release processor and handler
   processor_.reset();
 
+  // Pipelined requests stay with the connection for its next client
+  sendQueue_.clear();
+  freeRequests_.clear();
+  for (auto& request : requests_) {
+    releaseRequest(request.get());
+  }
+
   // Give this object back to the server that owns it
   server_->returnConnection(this);
 }
 
 void TNonblockingServer::TConnection::checkIdleBufferMemLimit(size_t readLimit, size_t writeLimit) {
+  // Borrowed buffers are given back as soon as they are not needed
+  if (bufferPool_) {
+    return;
+  }
+
   if (readLimit > 0 && readBufferSize_ > readLimit) {
     free(readBuffer_);
     readBuffer_ = nullptr;
@@ -882,6 +1488,44 @@ void TNonblockingServer::TConnection::checkIdleBufferMemLimit(size_t readLimit,
     outputTransport_->resetBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize()));
     largestWriteBufferSize_ = 0;
   }
+
+  if (writeLimit > 0 && spareWriteBuffer_ && spareWriteBuffer_->getBufferSize() > writeLimit) {
+    spareWriteBuffer_.reset();
+  }
+
+  // Requests not in use are held to the same limits
+  for (Request* request : freeRequests_) {
+    if (readLimit > 0 && request->bufferSize > readLimit) {
+      free(request->buffer);
+      request->buffer = nullptr;
+      request->bufferSize = 0;
+    }
+    if (writeLimit > 0 && request->outputTransport->getBufferSize() > writeLimit) {
+      request->outputTransport->resetBuffer(
+          static_cast<uint32_t>(server_->getWriteBufferDefaultSize()));
+    }
+  }
+}
+
+void TNonblockingServer::TConnection::pinWriteBuffer() {
+  std::shared_ptr<TMemoryBuffer> pinned;
+  pinned.swap(spareWriteBuffer_);
+  if (pinned) {
+    pinned->resetBuffer();
+  } else {
+    pinned.reset(new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+  }
+  pinned->swap(*outputTransport_);
+  zeroCopyBuffers_.push_back(pinned);
+}
+
+bool TNonblockingServer::TConnection::reapZeroCopy() {
+  bool reaped = tSocket_->getZeroCopyPending() > 0 && tSocket_->reapZeroCopyCompletions() > 0;
+  if (!zeroCopyBuffers_.empty() && tSocket_->getZeroCopyPending() == 0) {
+    spareWriteBuffer_ = zeroCopyBuffers_.back();
+    zeroCopyBuffers_.clear();
+  }
+  return reaped;
 }
 
 TNonblockingServer::~TNonblockingServer() {
@@ -909,16 +1553,25 @@ TNonblockingServer::~TNonblockingServer() {
  * Creates a new connection either by reusing an object off the stack or
  * by allocating a new one entirely
  */
-TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket) {
+TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket,
+                                                                      TNonblockingIOThread* ioThread) {
   // Check the stack
   Guard g(connMutex_);
 
-  // pick an IO thread to handle this connection -- currently round robin
-  assert(nextIOThread_ < ioThreads_.size());
-  int selectedThreadIdx = nextIOThread_;
-  nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
-
-  TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
+  // pick an IO thread to handle this connection -- round robin unless a
+  // selector is set
+  if (ioThread == nullptr && ioThreadSelector_) {
+    size_t selectedThreadIdx = ioThreadSelector_->select(ioThreads_);
+    assert(selectedThreadIdx < ioThreads_.size());
+    ioThread = ioThreads_[selectedThreadIdx].get();
+  } else if (ioThread == nullptr) {
+    assert(nextIOThread_ < ioThreads_.size());
+    int selectedThreadIdx = nextIOThread_;
+    nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
+
+    ioThread = ioThreads_[selectedThreadIdx].get();
+  }
+  ioThread->addConnection();
 
   // Check the connection stack to see if we can re-use
   TConnection* result = nullptr;
@@ -956,21 +1609,34 @@ void TNonblockingServer::returnConnection(TConnection* connection) {
  * Server socket had something happen.  We accept all waiting client
  * connections on fd and assign TConnection objects to handle those requests.
  */
-void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
+void TNonblockingServer::handleEvent(TNonblockingIOThread* ioThread, THRIFT_SOCKET fd, short which) {
   (void)which;
+  std::shared_ptr<TNonblockingServerTransport> listener = ioThread->getListener();
+  if (!listener) {
+    listener = serverTransport_;
+  }
   // Make sure that libevent didn't mess up the socket handles
-  assert(fd == serverSocket_);
+  assert(fd == listener->getSocketFD());
+  (void)fd;
 
   // Going to accept a new client socket
   std::shared_ptr<TSocket> clientSocket;
 
-  clientSocket = serverTransport_->accept();
+  clientSocket = listener->accept();
   if (clientSocket) {
-    // If we're overloaded, take action here
-    if (overloadAction_ != T_OVERLOAD_NO_ACTION && serverOverloaded()) {
+    // If we're overloaded, take action here.  With a listener on every IO
+    // thread several threads get here at once, so the check and the drop
+    // counters share connMutex_ with the connection bookkeeping.
+    bool overloaded = false;
+    if (overloadAction_ != T_OVERLOAD_NO_ACTION) {
       Guard g(connMutex_);
-      nConnectionsDropped_++;
-      nTotalConnectionsDropped_++;
+      overloaded = serverOverloadedLocked();
+      if (overloaded) {
+        nConnectionsDropped_++;
+        nTotalConnectionsDropped_++;
+      }
+    }
+    if (overloaded) {
       if (overloadAction_ == T_OVERLOAD_CLOSE_ON_ACCEPT) {
         clientSocket->close();
         return;
@@ -983,8 +1649,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
       }
     }
 
-    // Create a new TConnection for this client socket.
-    TConnection* clientConnection = createConnection(clientSocket);
+    // Create a new TConnection for this client socket.  With a listener on
+    // every IO thread, the thread that accepted it serves it.
+    TConnection* clientConnection
+        = createConnection(clientSocket, ioThreadListeners_ ? ioThread : nullptr);
 
     // Fail fast if we could not create a TConnection object
     if (clientConnection == nullptr) {
@@ -1000,12 +1668,8 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
      *
      * (We need to avoid writing to our own notification pipe, to
      * avoid possible deadlocks if the pipe is full.)
-     *
-     * The IO thread #0 is the only one that handles these listen
-     * events, so unless the connection has been assigned to thread #0
-     * we know it's not on our thread.
      */
-    if (clientConnection->getIOThreadNumber() == 0) {
+    if (clientConnection->getIOThreadNumber() == ioThread->getThreadNumber()) {
       clientConnection->transition();
     } else {
       if (!clientConnection->notifyIOThread()) {
@@ -1039,6 +1703,11 @@ void TNonblockingServer::setThreadManager(std::shared_ptr<ThreadManager> threadM
 }
 
 bool TNonblockingServer::serverOverloaded() {
+  Guard g(connMutex_);
+  return serverOverloadedLocked();
+}
+
+bool TNonblockingServer::serverOverloadedLocked() {
   size_t activeConnections = numTConnections_ - connectionStack_.size();
   if (numActiveProcessors_ > maxActiveProcessors_ || activeConnections > maxConnections_) {
     if (!overloaded_) {
@@ -1065,9 +1734,11 @@ bool TNonblockingServer::drainPendingTask() {
   if (threadManager_) {
     std::shared_ptr<Runnable> task = threadManager_->removeNextPending();
     if (task) {
-      TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
-      assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
-      connection->forceClose();
+      auto* connectionTask = static_cast<TConnection::Task*>(task.get());
+      TConnection* connection = connectionTask->getTConnection();
+      assert(connection && connection->getServer()
+             && (connection->isPipelined() || connection->getState() == APP_WAIT_TASK));
+      connectionTask->forceClose();
       return true;
     }
   }
@@ -1075,9 +1746,11 @@ bool TNonblockingServer::drainPendingTask() {
 }
 
 void TNonblockingServer::expireClose(std::shared_ptr<Runnable> task) {
-  TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
-  assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
-  connection->forceClose();
+  auto* connectionTask = static_cast<TConnection::Task*>(task.get());
+  TConnection* connection = connectionTask->getTConnection();
+  assert(connection && connection->getServer()
+         && (connection->isPipelined() || connection->getState() == APP_WAIT_TASK));
+  connectionTask->forceClose();
 }
 
 void TNonblockingServer::stop() {
@@ -1087,12 +1760,50 @@ void TNonblockingServer::stop() {
   }
 }
 
+/**
+ * Returns the variant of factory whose protocols are specialised on
+ * TMemoryBuffer, or factory itself if it is not one of the stock factories.
+ */
+static std::shared_ptr<TProtocolFactory> specializeProtocolFactory(
+    const std::shared_ptr<TProtocolFactory>& factory) {
+  const std::type_info& type = typeid(*factory);
+  if (type == typeid(TBinaryProtocolFactory)) {
+    const auto& binary = static_cast<const TBinaryProtocolFactory&>(*factory);
+    return std::make_shared<TBinaryProtocolFactoryT<TMemoryBuffer> >(
+        binary.getStringSizeLimit(), binary.getContainerSizeLimit(),
+        binary.getStrictRead(), binary.getStrictWrite());
+  } else if (type == typeid(TCompactProtocolFactory)) {
+    const auto& compact = static_cast<const TCompactProtocolFactory&>(*factory);
+    return std::make_shared<TCompactProtocolFactoryT<TMemoryBuffer> >(
+        compact.getStringSizeLimit(), compact.getContainerSizeLimit());
+  }
+  return factory;
+}
+
 void TNonblockingServer::registerEvents(event_base* user_event_base) {
   userEventBase_ = user_event_base;
 
+  // Connections always use TMemoryBuffer, which the protocols can be
+  // specialised on as long as the transport factories hand it through
+  specializedInputProtocolFactory_.reset();
+  specializedOutputProtocolFactory_.reset();
+  const TTransportFactory& inputTransportFactory = *getInputTransportFactory();
+  const TTransportFactory& outputTransportFactory = *getOutputTransportFactory();
+  if (specializeProtocols_ && !getHeaderTransport()
+      && typeid(inputTransportFactory) == typeid(TTransportFactory)
+      && typeid(outputTransportFactory) == typeid(TTransportFactory)) {
+    specializedInputProtocolFactory_ = specializeProtocolFactory(getInputProtocolFactory());
+    specializedOutputProtocolFactory_ = specializeProtocolFactory(getOutputProtocolFactory());
+  }
+
   // init listen socket
-  if (serverSocket_ == THRIFT_INVALID_SOCKET)
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+    // leave the transport's own SO_REUSEPORT setting alone unless asked to
+    if (reusePort_) {
+      serverTransport_->setReusePort(true);
+    }
     createAndListenOnSocket();
+  }
 
   // set up the IO threads
   assert(ioThreads_.empty());
@@ -1102,12 +1813,35 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   // User-provided event-base doesn't works for multi-threaded servers
   assert(numIOThreads_ == 1 || !userEventBase_);
 
+  // the other IO threads get listeners of their own if the port can be shared
+  std::vector<std::shared_ptr<TNonblockingServerTransport> > listeners(1, serverTransport_);
+  if (reusePort_) {
+    while (listeners.size() < numIOThreads_) {
+      std::shared_ptr<TNonblockingServerTransport> listener = serverTransport_->listenSharedPort();
+      if (!listener) {
+        TOutput::instance().printf(
+            "TNonblockingServer: server transport cannot share its port, "
+            "accepting on IO thread #0 only.");
+        for (size_t i = 1; i < listeners.size(); ++i) {
+          listeners[i]->close();
+        }
+        listeners.resize(1);
+        break;
+      }
+      listeners.push_back(listener);
+    }
+  }
+  ioThreadListeners_ = listeners.size() > 1;
+
   for (uint32_t id = 0; id < numIOThreads_; ++id) {
     // the first IO thread also does the listening on server socket
-    THRIFT_SOCKET listenFd = (id == 0 ? serverSocket_ : THRIFT_INVALID_SOCKET);
-
-    shared_ptr<TNonblockingIOThread> thread(
-        new TNonblockingIOThread(this, id, listenFd, useHighPriorityIOThreads_));
+    shared_ptr<TNonblockingIOThread> thread;
+    if (id < listeners.size()) {
+      thread.reset(new TNonblockingIOThread(this, id, listeners[id], useHighPriorityIOThreads_));
+    } else {
+      thread.reset(
+          new TNonblockingIOThread(this, id, THRIFT_INVALID_SOCKET, useHighPriorityIOThreads_));
+    }
     ioThreads_.push_back(thread);
   }
 
@@ -1176,20 +1910,44 @@ TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
     eventBase_(nullptr),
     ownEventBase_(false),
     serverEvent_{},
-    notificationEvent_{} {
+    notificationEvent_{},
+    zeroCopyEvent_{},
+    pendingNotifications_(nullptr),
+    stopRequested_(false),
+    wakeupLost_(false),
+    numConnections_(0),
+    numRequests_(0),
+    numBytesRead_(0),
+    numBytesWritten_(0) {
   notificationPipeFDs_[0] = -1;
   notificationPipeFDs_[1] = -1;
 }
 
+TNonblockingIOThread::TNonblockingIOThread(
+    TNonblockingServer* server,
+    int number,
+    const std::shared_ptr<TNonblockingServerTransport>& listener,
+    bool useHighPriority)
+  : TNonblockingIOThread(server, number, listener->getSocketFD(), useHighPriority) {
+  listener_ = listener;
+}
+
 TNonblockingIOThread::~TNonblockingIOThread() {
   // make sure our associated thread is fully finished
   join();
 
+  // Nothing polls the sockets anymore
+  reapZeroCopyReleases(true);
+
   if (eventBase_ && ownEventBase_) {
     event_base_free(eventBase_);
     ownEventBase_ = false;
   }
 
+  if (listener_) {
+    listener_->close();
+    listenSocket_ = THRIFT_INVALID_SOCKET;
+  }
   if (listenSocket_ != THRIFT_INVALID_SOCKET) {
     if (0 != ::THRIFT_CLOSESOCKET(listenSocket_)) {
       TOutput::instance().perror("TNonblockingIOThread listenSocket_ close(): ", THRIFT_GET_SOCKET_ERROR);
@@ -1197,6 +1955,11 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     listenSocket_ = THRIFT_INVALID_SOCKET;
   }
 
+#ifdef HAVE_SYS_EVENTFD_H
+  if (notificationPipeFDs_[1] == notificationPipeFDs_[0]) {
+    notificationPipeFDs_[1] = THRIFT_INVALID_SOCKET;
+  }
+#endif
   for (auto notificationPipeFD : notificationPipeFDs_) {
     if (notificationPipeFD >= 0) {
       if (0 != ::THRIFT_CLOSESOCKET(notificationPipeFD)) {
@@ -1209,6 +1972,17 @@ TNonblockingIOThread::~TNonblockingIOThread() {
 }
 
 void TNonblockingIOThread::createNotificationPipe() {
+#ifdef HAVE_SYS_EVENTFD_H
+  // An eventfd is a counter rather than a byte stream: any number of
+  // signals are consumed by a single read()
+  int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd >= 0) {
+    notificationPipeFDs_[0] = efd;
+    notificationPipeFDs_[1] = efd;
+    return;
+  }
+  TOutput::instance().perror("TNonblockingServer::createNotificationPipe eventfd ", errno);
+#endif
   if (evutil_socketpair(AF_LOCAL, SOCK_STREAM, 0, notificationPipeFDs_) == -1) {
     TOutput::instance().perror("TNonblockingServer::createNotificationPipe ", EVUTIL_SOCKET_ERROR());
     throw TException("can't create notification pipe");
@@ -1262,7 +2036,7 @@ void TNonblockingIOThread::registerEvents() {
               listenSocket_,
               EV_READ | EV_PERSIST,
               TNonblockingIOThread::listenHandler,
-              server_);
+              this);
     event_base_set(eventBase_, &serverEvent_);
 
     // Add the event and start up the server
@@ -1293,127 +2067,202 @@ void TNonblockingIOThread::registerEvents() {
         "event_add() failed on task-done notification event");
   }
   TOutput::instance().printf("TNonblocking: IO thread #%d registered for notify.", number_);
+
+  // Polls the sockets of closed connections until the kernel is done with
+  // their zero copy sends, added when there is one
+  event_set(&zeroCopyEvent_, -1, EV_PERSIST, TNonblockingIOThread::zeroCopyHandler, this);
+  event_base_set(eventBase_, &zeroCopyEvent_);
 }
 
-bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
-  auto fd = getNotificationSendFD();
-  if (fd < 0) {
-    return false;
+void TNonblockingIOThread::releaseZeroCopy(const std::shared_ptr<TSocket>& socket,
+                                           std::vector<std::shared_ptr<TMemoryBuffer> >& buffers) {
+  ZeroCopyRelease release;
+  release.socket = socket;
+  release.buffers.swap(buffers);
+  release.deadline = std::chrono::steady_clock::now()
+                     + std::chrono::milliseconds(ZERO_COPY_RELEASE_TIMEOUT_MS);
+  zeroCopyReleases_.push_back(std::move(release));
+
+  if (zeroCopyReleases_.size() == 1) {
+    struct timeval interval = {0, ZERO_COPY_POLL_MS * 1000};
+    event_add(&zeroCopyEvent_, &interval);
   }
+}
 
-  int ret = -1;
-  long kSize = sizeof(conn);
-  const char * pos = (const char *)const_cast_sockopt(&conn);
-
-#if defined(HAVE_POLL_H) || defined(HAVE_SYS_POLL_H)
-  struct pollfd pfd = {fd, POLLOUT, 0};
+void TNonblockingIOThread::zeroCopyHandler(evutil_socket_t fd, short which, void* v) {
+  (void)fd;
+  (void)which;
+  static_cast<TNonblockingIOThread*>(v)->reapZeroCopyReleases(false);
+}
 
-  while (kSize > 0) {
-    pfd.revents = 0;
-    ret = poll(&pfd, 1, -1);
-    if (ret < 0) {
-      return false;
-    } else if (ret == 0) {
-      continue;
+void TNonblockingIOThread::reapZeroCopyReleases(bool abort) {
+  auto now = std::chrono::steady_clock::now();
+  auto it = zeroCopyReleases_.begin();
+  while (it != zeroCopyReleases_.end()) {
+    TSocket& socket = *it->socket;
+    socket.reapZeroCopyCompletions();
+    if (socket.getZeroCopyPending() > 0) {
+      if (!abort && now < it->deadline) {
+        ++it;
+        continue;
+      }
+      // A reset drops what is left to send, and with it the kernel's
+      // references to the buffers
+      socket.setLinger(true, 0);
     }
+    socket.close();
+    it = zeroCopyReleases_.erase(it);
+  }
 
-    if (pfd.revents & POLLHUP || pfd.revents & POLLERR) {
-      ::THRIFT_CLOSESOCKET(fd);
-      return false;
+  if (zeroCopyReleases_.empty() && eventBase_ != nullptr) {
+    event_del(&zeroCopyEvent_);
+  }
+}
+
+bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
+  if (getNotificationSendFD() < 0) {
+    return false;
+  }
+
+  bool queued;
+  if (conn == nullptr) {
+    stopRequested_.store(true, std::memory_order_release);
+    queued = false;
+  } else if (conn->notifyCount_.fetch_add(1, std::memory_order_release) != 0) {
+    // Already queued, the IO thread takes this one along with the others
+    queued = true;
+  } else {
+    conn->nextNotified_ = pendingNotifications_.load(std::memory_order_relaxed);
+    while (!pendingNotifications_.compare_exchange_weak(conn->nextNotified_,
+                                                        conn,
+                                                        std::memory_order_release,
+                                                        std::memory_order_relaxed)) {
     }
+    queued = conn->nextNotified_ != nullptr;
+  }
 
-    if (pfd.revents & POLLOUT) {
-      ret = send(fd, pos, kSize, 0);
-      if (ret < 0) {
-        if (errno == EAGAIN) {
-          continue;
-        }
+  // Whoever finds the queue empty wakes the IO thread, which then takes
+  // everything queued behind it in the same pass
+  if (queued && !wakeupLost_.load(std::memory_order_acquire)) {
+    return true;
+  }
 
-        ::THRIFT_CLOSESOCKET(fd);
-        return false;
+  // The notification stays queued if the wakeup fails, the next notify()
+  // tries again
+  if (!signalNotification()) {
+    wakeupLost_.store(true, std::memory_order_release);
+  }
+  return true;
+}
+
+bool TNonblockingIOThread::signalNotification() {
+  auto fd = getNotificationSendFD();
+  while (true) {
+#ifdef HAVE_SYS_EVENTFD_H
+    if (fd == getNotificationRecvFD()) {
+      uint64_t one = 1;
+      if (::write(fd, &one, sizeof(one)) == sizeof(one)) {
+        return true;
       }
+    } else
+#endif
+    {
+      char one = 1;
+      if (send(fd, &one, sizeof(one), 0) == sizeof(one)) {
+        return true;
+      }
+    }
 
-      kSize -= ret;
-      pos += ret;
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EWOULDBLOCK || errno_copy == THRIFT_EAGAIN) {
+      // The pipe is full of earlier wakeups, none of which has been
+      // consumed yet
+      return true;
     }
-  }
-#else
-  fd_set wfds, efds;
-
-  while (kSize > 0) {
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-    FD_SET(fd, &wfds);
-    FD_SET(fd, &efds);
-    ret = select(static_cast<int>(fd + 1), nullptr, &wfds, &efds, nullptr);
-    if (ret < 0) {
+    if (errno_copy != THRIFT_EINTR) {
+      TOutput::instance().perror("TNonblocking: notify write() failed: ", errno_copy);
       return false;
-    } else if (ret == 0) {
-      continue;
     }
+  }
+}
 
-    if (FD_ISSET(fd, &efds)) {
-      ::THRIFT_CLOSESOCKET(fd);
-      return false;
+bool TNonblockingIOThread::clearNotification() {
+  auto fd = getNotificationRecvFD();
+  while (true) {
+    long nBytes;
+#ifdef HAVE_SYS_EVENTFD_H
+    if (fd == getNotificationSendFD()) {
+      // One read takes the whole counter, there is nothing left to drain
+      uint64_t count;
+      nBytes = ::read(fd, &count, sizeof(count));
+      if (nBytes == sizeof(count)) {
+        return true;
+      }
+    } else
+#endif
+    {
+      char buf[64];
+      nBytes = recv(fd, cast_sockopt(buf), sizeof(buf), 0);
     }
 
-    if (FD_ISSET(fd, &wfds)) {
-      ret = send(fd, pos, kSize, 0);
-      if (ret < 0) {
-        if (errno == EAGAIN) {
-          continue;
-        }
-
-        ::THRIFT_CLOSESOCKET(fd);
+    if (nBytes == 0) {
+      TOutput::instance().printf("notifyHandler: Notify socket closed!");
+      breakLoop(false);
+      return false;
+    } else if (nBytes < 0) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (errno_copy == THRIFT_EWOULDBLOCK || errno_copy == THRIFT_EAGAIN) {
+        return true;
+      }
+      if (errno_copy != THRIFT_EINTR) {
+        TOutput::instance().perror("TNonblocking: notifyHandler read() failed: ", errno_copy);
+        breakLoop(true);
         return false;
       }
-
-      kSize -= ret;
-      pos += ret;
     }
   }
-#endif
-
-  return true;
 }
 
 /* static */
 void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void* v) {
   auto* ioThread = (TNonblockingIOThread*)v;
   assert(ioThread);
+  (void)fd;
   (void)which;
 
-  while (true) {
-    TNonblockingServer::TConnection* connection = nullptr;
-    const int kSize = sizeof(connection);
-    long nBytes = recv(fd, cast_sockopt(&connection), kSize, 0);
-    if (nBytes == kSize) {
-      if (connection == nullptr) {
-        // this is the command to stop our thread, exit the handler!
-        ioThread->breakLoop(false);
-        return;
-      }
-      connection->transition();
-    } else if (nBytes > 0) {
-      // throw away these bytes and hope that next time we get a solid read
-      TOutput::instance().printf("notifyHandler: Bad read of %d bytes, wanted %d", nBytes, kSize);
-      ioThread->breakLoop(true);
-      return;
-    } else if (nBytes == 0) {
-      TOutput::instance().printf("notifyHandler: Notify socket closed!");
-      ioThread->breakLoop(false);
-      // exit the loop
-      break;
-    } else { // nBytes < 0
-      if (THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK
-          && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
-        TOutput::instance().perror("TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
-        ioThread->breakLoop(true);
-        return;
-      }
-      // exit the loop
-      break;
+  // Consume the wakeup before taking the queue: a notify() that lands after
+  // the exchange below finds the queue empty and signals again
+  if (!ioThread->clearNotification()) {
+    return;
+  }
+  ioThread->wakeupLost_.exchange(false, std::memory_order_acquire);
+
+  TNonblockingServer::TConnection* connection
+      = ioThread->pendingNotifications_.exchange(nullptr, std::memory_order_acquire);
+
+  // The queue is a stack, put it back in the order the connections came in
+  TNonblockingServer::TConnection* batch = nullptr;
+  while (connection != nullptr) {
+    TNonblockingServer::TConnection* next = connection->nextNotified_;
+    connection->nextNotified_ = batch;
+    batch = connection;
+    connection = next;
+  }
+
+  while (batch != nullptr) {
+    // Once the count is back to 0 another notify() may queue the
+    // connection again, so the link has to be read first
+    TNonblockingServer::TConnection* next = batch->nextNotified_;
+    uint32_t count = batch->notifyCount_.exchange(0, std::memory_order_acquire);
+    while (count-- > 0) {
+      batch->notified();
     }
+    batch = next;
+  }
+
+  // this is the command to stop our thread
+  if (ioThread->stopRequested_.exchange(false, std::memory_order_acquire)) {
+    ioThread->breakLoop(false);
   }
 }
 
@@ -1501,6 +2350,7 @@ void TNonblockingIOThread::cleanupEvents() {
   }
 
   event_del(&notificationEvent_);
+  event_del(&zeroCopyEvent_);
 }
 
 void TNonblockingIOThread::stop() {
@@ -1521,6 +2371,35 @@ void TNonblockingIOThread::join() {
     }
   }
 }
+
+size_t TLeastConnectionsIOThreadSelector::select(
+    const std::vector<std::shared_ptr<TNonblockingIOThread> >& ioThreads) {
+  size_t selected = 0;
+  for (size_t i = 1; i < ioThreads.size(); ++i) {
+    if (ioThreads[i]->getNumConnections() < ioThreads[selected]->getNumConnections()) {
+      selected = i;
+    }
+  }
+  return selected;
+}
+
+TTwoChoicesIOThreadSelector::TTwoChoicesIOThreadSelector() : random_(std::random_device()()) {
+}
+
+size_t TTwoChoicesIOThreadSelector::select(
+    const std::vector<std::shared_ptr<TNonblockingIOThread> >& ioThreads) {
+  if (ioThreads.size() < 2) {
+    return 0;
+  }
+  // two distinct threads, each equally likely
+  size_t first = random_() % ioThreads.size();
+  size_t second = (first + 1 + random_() % (ioThreads.size() - 1)) % ioThreads.size();
+  return load(*ioThreads[second]) < load(*ioThreads[first]) ? second : first;
+}
+
+uint64_t TTwoChoicesIOThreadSelector::load(const TNonblockingIOThread& ioThread) {
+  return ioThread.getNumConnections();
+}
 }
 }
 } // apache::thrift::server
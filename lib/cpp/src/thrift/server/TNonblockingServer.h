@@ -24,14 +24,18 @@
 #include <memory>
 #include <thrift/server/TServer.h>
 #include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TBufferPool.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TNonblockingServerTransport.h>
 #include <thrift/concurrency/ThreadManager.h>
+#include <atomic>
+#include <chrono>
 #include <climits>
 #include <thrift/concurrency/Thread.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Mutex.h>
+#include <random>
 #include <stack>
 #include <vector>
 #include <string>
@@ -48,6 +52,7 @@ namespace apache {
 namespace thrift {
 namespace server {
 
+using apache::thrift::transport::TBufferPool;
 using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TNonblockingServerTransport;
@@ -109,6 +114,7 @@ enum TOverloadAction {
 };
 
 class TNonblockingIOThread;
+class TIOThreadSelector;
 
 class TNonblockingServer : public TServer {
 private:
@@ -174,6 +180,15 @@ private:
   // Index of next IO Thread to be used (for round-robin)
   uint32_t nextIOThread_;
 
+  /// Chooses the IO thread of new connections, round-robin if nullptr
+  std::shared_ptr<TIOThreadSelector> ioThreadSelector_;
+
+  /// Whether every IO thread should accept on a listener of its own
+  bool reusePort_;
+
+  /// Set when every IO thread does accept on a listener of its own
+  bool ioThreadListeners_;
+
   // Synchronizes access to connection stack and similar data
   Mutex connMutex_;
 
@@ -214,6 +229,18 @@ private:
    */
   size_t writeBufferDefaultSize_;
 
+  /**
+   * Responses of at least this many bytes are sent with MSG_ZEROCOPY where
+   * the socket supports it.  0 disables zero copy.
+   */
+  uint32_t zeroCopyThreshold_;
+
+  /**
+   * Most requests a connection may have in progress at once.  Above 1, and
+   * with a thread manager, connections read ahead and answer out of order.
+   */
+  size_t pipelineDepth_;
+
   /**
    * Max read buffer size for an idle TConnection.  When we place an idle
    * TConnection into connectionStack_ or on every resizeBufferEveryN_ calls,
@@ -237,6 +264,16 @@ private:
    */
   int32_t resizeBufferEveryN_;
 
+  /// Pool connections borrow their buffers from, if any
+  std::shared_ptr<TBufferPool> bufferPool_;
+
+  /// Whether connections use protocols specialised on their buffers
+  bool specializeProtocols_;
+
+  /// Protocol factories used by connections when specializeProtocols_ is set
+  std::shared_ptr<TProtocolFactory> specializedInputProtocolFactory_;
+  std::shared_ptr<TProtocolFactory> specializedOutputProtocolFactory_;
+
   /// Set if we are currently in an overloaded state.
   bool overloaded_;
 
@@ -271,14 +308,20 @@ private:
    * client connections on listen socket fd and assign TConnection objects
    * to handle those requests.
    *
+   * @param ioThread the IO thread listening on fd.
    * @param which the event flag that triggered the handler.
    */
-  void handleEvent(THRIFT_SOCKET fd, short which);
+  void handleEvent(TNonblockingIOThread* ioThread, THRIFT_SOCKET fd, short which);
+
+  /// serverOverloaded() for callers that already hold connMutex_
+  bool serverOverloadedLocked();
 
   void init() {
     serverSocket_ = THRIFT_INVALID_SOCKET;
     numIOThreads_ = DEFAULT_IO_THREADS;
     nextIOThread_ = 0;
+    reusePort_ = false;
+    ioThreadListeners_ = false;
     useHighPriorityIOThreads_ = false;
     userEventBase_ = nullptr;
     threadPoolProcessing_ = false;
@@ -292,9 +335,12 @@ private:
     overloadHysteresis_ = 0.8;
     overloadAction_ = T_OVERLOAD_NO_ACTION;
     writeBufferDefaultSize_ = WRITE_BUFFER_DEFAULT_SIZE;
+    zeroCopyThreshold_ = 0;
+    pipelineDepth_ = 1;
     idleReadBufferLimit_ = IDLE_READ_BUFFER_LIMIT;
     idleWriteBufferLimit_ = IDLE_WRITE_BUFFER_LIMIT;
     resizeBufferEveryN_ = RESIZE_BUFFER_EVERY_N;
+    specializeProtocols_ = false;
     overloaded_ = false;
     nConnectionsDropped_ = 0;
     nTotalConnectionsDropped_ = 0;
@@ -403,6 +449,39 @@ public:
   /** Return the number of IO threads used by this server. */
   size_t getNumIOThreads() const { return numIOThreads_; }
 
+  /**
+   * Set whether every IO thread accepts connections on a listener of its
+   * own, bound to the same port with SO_REUSEPORT, and serves them itself.
+   * The kernel then spreads new connections among the IO threads, instead of
+   * thread #0 accepting all of them and handing them out.  If the server
+   * transport cannot share its port the server falls back to a single
+   * listener.  Can only be used before the call to serve().
+   */
+  void setReusePort(bool reusePort) { reusePort_ = reusePort; }
+
+  /** Return whether every IO thread accepts connections of its own. */
+  bool getReusePort() const { return reusePort_; }
+
+  /**
+   * Set the policy choosing the IO thread that serves each new connection.
+   * The default, nullptr, assigns them round-robin.  Not used for the
+   * connections accepted by an IO thread's own listener, see setReusePort().
+   */
+  void setIOThreadSelector(const std::shared_ptr<TIOThreadSelector>& selector) {
+    ioThreadSelector_ = selector;
+  }
+
+  /** Return the policy choosing the IO thread of new connections. */
+  std::shared_ptr<TIOThreadSelector> getIOThreadSelector() const { return ioThreadSelector_; }
+
+  /**
+   * Return the IO threads of this server, e.g. to read their load counters.
+   * Empty until the server has been started.
+   */
+  const std::vector<std::shared_ptr<TNonblockingIOThread> >& getIOThreads() const {
+    return ioThreads_;
+  }
+
   /**
    * Get the maximum number of unused TConnection we will hold in reserve.
    *
@@ -593,6 +672,47 @@ public:
    */
   void setWriteBufferDefaultSize(size_t size) { writeBufferDefaultSize_ = size; }
 
+  /**
+   * Get the size from which responses are sent with MSG_ZEROCOPY.
+   *
+   * @return # bytes from which responses are sent without a kernel copy.
+   */
+  uint32_t getZeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+  /**
+   * Set the size from which responses are sent with MSG_ZEROCOPY, where the
+   * socket supports it.  Such a response stays pinned in its connection
+   * until the kernel reports that it is done with it; the IO thread reads
+   * these completions from the socket error queue.  0, the default,
+   * disables zero copy.
+   *
+   * @param threshold # bytes from which responses are sent without a kernel copy.
+   */
+  void setZeroCopyThreshold(uint32_t threshold) { zeroCopyThreshold_ = threshold; }
+
+  /**
+   * Get the number of requests a connection may have in progress at once.
+   *
+   * @return # requests read from a connection and not yet answered.
+   */
+  size_t getPipelineDepth() const { return pipelineDepth_; }
+
+  /**
+   * Set the number of requests a connection may have in progress at once.
+   * Above 1, and with a thread manager, a connection keeps reading frames
+   * while earlier requests are being processed, hands each one to the
+   * thread manager as soon as it is read, and writes each response as soon
+   * as it is ready.  Responses may therefore come back in a different order
+   * than the requests: clients must match them by sequence id, as the
+   * generated concurrent clients do (THeaderTransport carries its own
+   * sequence number).  The processor and handler of a connection must be
+   * safe to call from several threads at once.  Pipelined connections do
+   * not use zero copy.  Default is 1.
+   *
+   * @param depth # requests read from a connection and not yet answered.
+   */
+  void setPipelineDepth(size_t depth) { pipelineDepth_ = depth; }
+
   /**
    * Get the maximum size of read buffer allocated to idle TConnection objects.
    *
@@ -665,6 +785,53 @@ public:
    */
   void setResizeBufferEveryN(int32_t count) { resizeBufferEveryN_ = count; }
 
+  /**
+   * Get the pool connections borrow their buffers from.
+   *
+   * @return the pool, nullptr if connections own their buffers.
+   */
+  std::shared_ptr<TBufferPool> getBufferPool() const { return bufferPool_; }
+
+  /**
+   * Have connections borrow their read and write buffers from a pool, only
+   * while a request is in progress.  A connection takes a read buffer once
+   * it knows the frame size, gives it back once the request is processed,
+   * and gives the write buffer back once the response is sent, so idle
+   * connections hold no buffer memory and the idle buffer limits have
+   * nothing to trim.  The pool may be shared with other servers; its budget
+   * bounds the memory of all of them.  When the budget is exhausted and the
+   * pool's action is OVER_BUDGET_FAIL, a connection that needs a buffer is
+   * closed.  Connections using a pool do not use zero copy.  nullptr, the
+   * default, has each connection keep its own buffers.  Must be set before
+   * serve().
+   *
+   * @param pool the pool, or nullptr.
+   */
+  void setBufferPool(const std::shared_ptr<TBufferPool>& pool) { bufferPool_ = pool; }
+
+  /**
+   * Get whether connections use protocols specialised on TMemoryBuffer.
+   *
+   * @return true if enabled.
+   */
+  bool getSpecializeProtocols() const { return specializeProtocols_; }
+
+  /**
+   * Have connections use protocols specialised on TMemoryBuffer, the
+   * transport they always read from and write to.  With the default
+   * transport factories, a TBinaryProtocolFactory or TCompactProtocolFactory
+   * is replaced by its TMemoryBuffer variant, whose protocols call the buffer
+   * without virtual dispatch.  The bytes on the wire are the same.
+   *
+   * Processors generated with the templates option and instantiated on the
+   * concrete protocol, e.g.
+   * FooProcessorT<TBinaryProtocolT<TMemoryBuffer> >, then decode and encode
+   * without virtual calls at all.  Must be set before serve().
+   *
+   * @param specialize whether to specialise the protocols.
+   */
+  void setSpecializeProtocols(bool specialize) { specializeProtocols_ = specialize; }
+
   /**
    * Main workhorse function, starts up the server listening on a port and
    * loops over the libevent handler.
@@ -715,11 +882,12 @@ private:
    * and flags.
    *
    * @param socket FD of socket associated with this connection.
-   * @param addr the sockaddr of the client
-   * @param addrLen the length of addr
+   * @param ioThread the IO thread to serve the connection, or nullptr to
+   *        pick the next one in round-robin order.
    * @return pointer to initialized TConnection object.
    */
-  TConnection* createConnection(std::shared_ptr<TSocket> socket);
+  TConnection* createConnection(std::shared_ptr<TSocket> socket,
+                                TNonblockingIOThread* ioThread = nullptr);
 
   /**
    * Returns a connection to pool or deletion.  If the connection pool
@@ -741,6 +909,13 @@ public:
                        THRIFT_SOCKET listenSocket,
                        bool useHighPriority);
 
+  // Creates an IO thread that accepts connections from listener, which
+  // should be listening already.  The thread closes it when destroyed.
+  TNonblockingIOThread(TNonblockingServer* server,
+                       int number,
+                       const std::shared_ptr<TNonblockingServerTransport>& listener,
+                       bool useHighPriority);
+
   ~TNonblockingIOThread() override;
 
   // Returns the event-base for this thread.
@@ -752,11 +927,15 @@ public:
   // Returns the number of this IO thread.
   int getThreadNumber() const { return number_; }
 
+  // Returns the transport this thread accepts connections from, if any.
+  std::shared_ptr<TNonblockingServerTransport> getListener() const { return listener_; }
+
   // Returns the thread id associated with this object.  This should
   // only be called after the thread has been started.
   Thread::id_t getThreadId() const { return threadId_; }
 
-  // Returns the send-fd for task complete notifications.
+  // Returns the send-fd for task complete notifications.  This is the same
+  // descriptor as the read-fd when an eventfd is used.
   evutil_socket_t getNotificationSendFD() const { return notificationPipeFDs_[1]; }
 
   // Returns the read-fd for task complete notifications.
@@ -768,9 +947,33 @@ public:
   // Sets the actual thread object associated with this IO thread.
   void setThread(const std::shared_ptr<Thread>& t) { thread_ = t; }
 
-  // Used by TConnection objects to indicate processing has finished.
+  // Used by TConnection objects to indicate processing has finished.  Safe
+  // to call from any thread; only the call that finds no other notification
+  // pending wakes the IO thread up.  A null conn asks the thread to stop.
+  // Returns false if the notification could not be queued, which only
+  // happens once the thread has shut down.
   bool notify(TNonblockingServer::TConnection* conn);
 
+  // Returns the number of connections this thread currently serves.
+  size_t getNumConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+
+  // Returns the number of requests this thread has read.
+  uint64_t getNumRequests() const { return numRequests_.load(std::memory_order_relaxed); }
+
+  // Returns the number of bytes this thread has read from its connections.
+  uint64_t getNumBytesRead() const { return numBytesRead_.load(std::memory_order_relaxed); }
+
+  // Returns the number of bytes this thread has written to its connections.
+  uint64_t getNumBytesWritten() const { return numBytesWritten_.load(std::memory_order_relaxed); }
+
+  // Used by TConnection objects to keep the counters above.  Apart from the
+  // connection count they are only updated by this thread.
+  void addConnection() { numConnections_.fetch_add(1, std::memory_order_relaxed); }
+  void removeConnection() { numConnections_.fetch_sub(1, std::memory_order_relaxed); }
+  void countRequest() { increment(numRequests_, 1); }
+  void countBytesRead(uint32_t n) { increment(numBytesRead_, n); }
+  void countBytesWritten(uint32_t n) { increment(numBytesWritten_, n); }
+
   // Enters the event loop and does not return until a call to stop().
   void run() override;
 
@@ -783,12 +986,25 @@ public:
   /// Registers the events for the notification & listen sockets
   void registerEvents();
 
+  // Takes over the socket of a closed connection with the responses it sent
+  // with MSG_ZEROCOPY, and closes the socket once the kernel has released
+  // them.  Only called by this thread.
+  void releaseZeroCopy(const std::shared_ptr<TSocket>& socket,
+                       std::vector<std::shared_ptr<TMemoryBuffer> >& buffers);
+
 private:
+  /// A closed socket whose zero copy sends the kernel may still be reading.
+  struct ZeroCopyRelease {
+    std::shared_ptr<TSocket> socket;
+    std::vector<std::shared_ptr<TMemoryBuffer> > buffers;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
   /**
    * C-callable event handler for signaling task completion.  Provides a
-   * callback that libevent can understand that will read a connection
-   * object's address from a pipe and call connection->transition() for
-   * that object.
+   * callback that libevent can understand that will take every pending
+   * notification at once and call connection->notified() for each
+   * connection, in the order they were queued.
    *
    * @param fd the descriptor the event occurred on.
    */
@@ -800,24 +1016,48 @@ private:
    *
    * @param fd the descriptor the event occurred on.
    * @param which the flags associated with the event.
-   * @param v void* callback arg where we placed TNonblockingServer's "this".
+   * @param v void* callback arg where we placed TNonblockingIOThread's "this".
    */
   static void listenHandler(evutil_socket_t fd, short which, void* v) {
-    ((TNonblockingServer*)v)->handleEvent(fd, which);
+    auto* ioThread = (TNonblockingIOThread*)v;
+    ioThread->getServer()->handleEvent(ioThread, fd, which);
   }
 
+  /**
+   * C-callable timer handler that polls the sockets of zeroCopyReleases_.
+   *
+   * @param v void* callback arg where we placed TNonblockingIOThread's "this".
+   */
+  static void zeroCopyHandler(evutil_socket_t fd, short which, void* v);
+
+  /// Closes the sockets of zeroCopyReleases_ the kernel is done with.  With
+  /// abort, or past their deadline, the others are reset and closed too.
+  void reapZeroCopyReleases(bool abort);
+
   /// Exits the loop ASAP in case of shutdown or error.
   void breakLoop(bool error);
 
   /// Create the pipe used to notify I/O process of task completion.
   void createNotificationPipe();
 
+  /// Wakes the event loop up to drain the pending notifications.
+  bool signalNotification();
+
+  /// Consumes the wakeups sent by signalNotification().  Returns false,
+  /// having broken the loop, if the pipe was closed or failed.
+  bool clearNotification();
+
   /// Unregisters our events for notification and listen sockets.
   void cleanupEvents();
 
   /// Sets (or clears) high priority scheduling status for the current thread.
   void setCurrentThreadHighPriority(bool value);
 
+  /// Adds to a counter only this thread writes, without a locked instruction.
+  static void increment(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
 private:
   /// associated server
   TNonblockingServer* server_;
@@ -831,6 +1071,9 @@ private:
   /// If listenSocket_ >= 0, adds an event on the event_base to accept conns
   THRIFT_SOCKET listenSocket_;
 
+  /// Transport owning listenSocket_, if the thread was given one
+  std::shared_ptr<TNonblockingServerTransport> listener_;
+
   /// Sets a high scheduling priority when running
   bool useHighPriority_;
 
@@ -847,12 +1090,81 @@ private:
   /// Used with eventBase_ for task completion notification
   struct event notificationEvent_;
 
-  /// File descriptors for pipe used for task completion notification.
+  /// File descriptors for pipe used for task completion notification.  Both
+  /// entries hold the same eventfd where one is available.
   evutil_socket_t notificationPipeFDs_[2];
 
+  /// Polls zeroCopyReleases_ while it is not empty
+  struct event zeroCopyEvent_;
+
+  /// Sockets closed with zero copy sends pending, see releaseZeroCopy().
+  std::vector<ZeroCopyRelease> zeroCopyReleases_;
+
+  /// Connections queued by notify(), most recent first, linked through
+  /// their own nextNotified_.
+  std::atomic<TNonblockingServer::TConnection*> pendingNotifications_;
+
+  /// Set by notify(nullptr) to stop the thread.
+  std::atomic<bool> stopRequested_;
+
+  /// Set when a wakeup could not be sent, for the next notify() to retry it.
+  std::atomic<bool> wakeupLost_;
+
+  /// Load counters, see the getters.
+  std::atomic<size_t> numConnections_;
+  std::atomic<uint64_t> numRequests_;
+  std::atomic<uint64_t> numBytesRead_;
+  std::atomic<uint64_t> numBytesWritten_;
+
   /// Actual IO Thread
   std::shared_ptr<Thread> thread_;
 };
+
+/**
+ * Chooses the IO thread that serves a new connection, see
+ * TNonblockingServer::setIOThreadSelector().
+ */
+class TIOThreadSelector {
+public:
+  virtual ~TIOThreadSelector() = default;
+
+  /**
+   * Called with the server's connection lock held, so implementations need
+   * no locking of their own.
+   *
+   * @param ioThreads the server's IO threads, never empty.
+   * @return the index in ioThreads of the thread to use.
+   */
+  virtual size_t select(const std::vector<std::shared_ptr<TNonblockingIOThread> >& ioThreads) = 0;
+};
+
+/**
+ * Picks the IO thread serving the fewest connections, the lowest numbered
+ * one on a tie.
+ */
+class TLeastConnectionsIOThreadSelector : public TIOThreadSelector {
+public:
+  size_t select(const std::vector<std::shared_ptr<TNonblockingIOThread> >& ioThreads) override;
+};
+
+/**
+ * Picks the less loaded of two IO threads chosen at random.  Nearly as
+ * even as looking at every thread, without every new connection going to
+ * the same one while their loads are alike.  The load is the number of
+ * connections unless load() is overridden.
+ */
+class TTwoChoicesIOThreadSelector : public TIOThreadSelector {
+public:
+  TTwoChoicesIOThreadSelector();
+
+  size_t select(const std::vector<std::shared_ptr<TNonblockingIOThread> >& ioThreads) override;
+
+protected:
+  virtual uint64_t load(const TNonblockingIOThread& ioThread);
+
+private:
+  std::minstd_rand random_;
+};
 }
 }
 } // apache::thrift::server
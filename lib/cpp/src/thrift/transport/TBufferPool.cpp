@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#include <thrift/transport/TBufferPool.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using concurrency::Guard;
+
+/// Size classes go up to 2^31 bytes
+static const int NUM_SIZE_CLASSES = 32;
+
+TBufferPool::TBufferPool(size_t budget, uint32_t minSize)
+  : budget_(budget),
+    minSize_(1),
+    overBudgetAction_(OVER_BUDGET_ALLOCATE),
+    bytesInUse_(0),
+    bytesCached_(0),
+    numOverBudget_(0),
+    cached_(NUM_SIZE_CLASSES) {
+  while (minSize_ < minSize && minSize_ < (1u << (NUM_SIZE_CLASSES - 1))) {
+    minSize_ *= 2;
+  }
+}
+
+TBufferPool::~TBufferPool() {
+  for (auto& buffers : cached_) {
+    for (uint8_t* buffer : buffers) {
+      std::free(buffer);
+    }
+  }
+}
+
+int TBufferPool::sizeClass(uint32_t capacity) const {
+  if (capacity < minSize_ || (capacity & (capacity - 1)) != 0) {
+    return -1;
+  }
+  int sizeClass = 0;
+  while (capacity > 1) {
+    capacity >>= 1;
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+uint8_t* TBufferPool::allocate(uint32_t size, uint32_t* capacity) {
+  uint32_t bytes = minSize_;
+  while (bytes < size && bytes < (1u << (NUM_SIZE_CLASSES - 1))) {
+    bytes *= 2;
+  }
+  if (bytes < size) {
+    // Too large for any class, it is freed on release
+    bytes = size;
+  }
+  int bytesClass = sizeClass(bytes);
+
+  {
+    Guard g(mutex_);
+    if (bytesClass >= 0 && !cached_[bytesClass].empty()) {
+      uint8_t* buffer = cached_[bytesClass].back();
+      cached_[bytesClass].pop_back();
+      bytesCached_ -= bytes;
+      bytesInUse_ += bytes;
+      *capacity = bytes;
+      return buffer;
+    }
+
+    if (budget_ > 0 && bytesInUse_ + bytesCached_ + bytes > budget_) {
+      makeRoom(bytes);
+      if (bytesInUse_ + bytesCached_ + bytes > budget_) {
+        ++numOverBudget_;
+        if (overBudgetAction_ == OVER_BUDGET_FAIL) {
+          *capacity = 0;
+          return nullptr;
+        }
+      }
+    }
+    bytesInUse_ += bytes;
+  }
+
+  auto* buffer = static_cast<uint8_t*>(std::malloc(bytes));
+  if (buffer == nullptr) {
+    Guard g(mutex_);
+    bytesInUse_ -= bytes;
+    throw std::bad_alloc();
+  }
+  *capacity = bytes;
+  return buffer;
+}
+
+void TBufferPool::release(uint8_t* buffer, uint32_t capacity) {
+  if (buffer == nullptr) {
+    return;
+  }
+
+  int bufferClass = sizeClass(capacity);
+  {
+    Guard g(mutex_);
+    assert(bytesInUse_ >= capacity);
+    bytesInUse_ -= capacity;
+    // Only keep it if that does not leave the pool over budget
+    if (bufferClass >= 0 && (budget_ == 0 || bytesInUse_ + bytesCached_ + capacity <= budget_)) {
+      cached_[bufferClass].push_back(buffer);
+      bytesCached_ += capacity;
+      return;
+    }
+  }
+  std::free(buffer);
+}
+
+void TBufferPool::resized(uint32_t oldCapacity, uint32_t newCapacity) {
+  Guard g(mutex_);
+  assert(bytesInUse_ >= oldCapacity);
+  bytesInUse_ = bytesInUse_ - oldCapacity + newCapacity;
+}
+
+void TBufferPool::makeRoom(size_t size) {
+  for (int i = NUM_SIZE_CLASSES - 1; i >= 0; --i) {
+    std::vector<uint8_t*>& buffers = cached_[i];
+    while (!buffers.empty()) {
+      if (bytesInUse_ + bytesCached_ + size <= budget_) {
+        return;
+      }
+      std::free(buffers.back());
+      buffers.pop_back();
+      bytesCached_ -= size_t(1) << i;
+    }
+  }
+}
+
+void TBufferPool::setOverBudgetAction(OverBudgetAction action) {
+  Guard g(mutex_);
+  overBudgetAction_ = action;
+}
+
+TBufferPool::OverBudgetAction TBufferPool::getOverBudgetAction() const {
+  Guard g(mutex_);
+  return overBudgetAction_;
+}
+
+size_t TBufferPool::getBytesInUse() const {
+  Guard g(mutex_);
+  return bytesInUse_;
+}
+
+size_t TBufferPool::getBytesCached() const {
+  Guard g(mutex_);
+  return bytesCached_;
+}
+
+uint64_t TBufferPool::getNumOverBudget() const {
+  Guard g(mutex_);
+  return numOverBudget_;
+}
+}
+}
+} // apache::thrift::transport
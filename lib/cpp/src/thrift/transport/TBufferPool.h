@@ -0,0 +1,129 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TBUFFERPOOL_H_
+#define _THRIFT_TRANSPORT_TBUFFERPOOL_H_ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <thrift/concurrency/Mutex.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Byte buffers shared by many users under one memory budget.
+ *
+ * Buffers come in power of two size classes.  A released buffer is kept in
+ * its class for the next allocate() of that size, so that users who need a
+ * buffer only now and then share a few instead of each holding its own.
+ * The buffers are plain malloc() memory: a borrower may hand one to a
+ * TMemoryBuffer with TAKE_OWNERSHIP and take it back with releaseBuffer().
+ *
+ * The budget covers the buffers lent out and those kept for reuse.  Kept
+ * buffers are freed to make room before an allocate() exceeds it; if that
+ * is not enough, the over budget action decides.  A budget of 0, the
+ * default, is unlimited.  All methods are thread safe.
+ */
+class TBufferPool {
+public:
+  /// What allocate() does when the budget would be exceeded
+  enum OverBudgetAction {
+    /// Allocate anyway; the buffer is freed instead of kept once released
+    OVER_BUDGET_ALLOCATE,
+    /// Return nullptr
+    OVER_BUDGET_FAIL
+  };
+
+  static const uint32_t DEFAULT_MIN_SIZE = 256;
+
+  /**
+   * @param budget  most bytes lent out and kept, 0 for no limit
+   * @param minSize size of the smallest class, rounded up to a power of two
+   */
+  TBufferPool(size_t budget = 0, uint32_t minSize = DEFAULT_MIN_SIZE);
+
+  ~TBufferPool();
+
+  /**
+   * Lends a buffer of at least size bytes.
+   *
+   * @param size     bytes needed
+   * @param capacity set to the size of the buffer, to be passed to release()
+   * @return the buffer, or nullptr if the budget does not allow it and the
+   *         over budget action is OVER_BUDGET_FAIL
+   */
+  uint8_t* allocate(uint32_t size, uint32_t* capacity);
+
+  /**
+   * Takes a buffer back, keeping it for reuse if the budget allows.
+   *
+   * @param buffer   a buffer from allocate(), or nullptr
+   * @param capacity its capacity, as last reported by allocate() or resized()
+   */
+  void release(uint8_t* buffer, uint32_t capacity);
+
+  /**
+   * Tells the pool that a borrower grew or shrank a lent buffer with
+   * realloc().  Growth is never refused, but counts against the budget.
+   */
+  void resized(uint32_t oldCapacity, uint32_t newCapacity);
+
+  void setOverBudgetAction(OverBudgetAction action);
+
+  OverBudgetAction getOverBudgetAction() const;
+
+  size_t getBudget() const { return budget_; }
+
+  /// Bytes in buffers lent out
+  size_t getBytesInUse() const;
+
+  /// Bytes in buffers kept for reuse
+  size_t getBytesCached() const;
+
+  /// Number of allocations that went over the budget or were refused
+  uint64_t getNumOverBudget() const;
+
+private:
+  /// Size class holding buffers of capacity bytes, -1 if there is none
+  int sizeClass(uint32_t capacity) const;
+
+  /// Frees kept buffers, largest first, until size more bytes fit the budget
+  void makeRoom(size_t size);
+
+  const size_t budget_;
+  uint32_t minSize_;
+  OverBudgetAction overBudgetAction_;
+
+  mutable concurrency::Mutex mutex_;
+  size_t bytesInUse_;
+  size_t bytesCached_;
+  uint64_t numOverBudget_;
+
+  /// Kept buffers, by size class
+  std::vector<std::vector<uint8_t*> > cached_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TBUFFERPOOL_H_
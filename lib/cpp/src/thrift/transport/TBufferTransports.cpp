@@ -88,12 +88,9 @@ void TBufferedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   // This case also covers the case where the buffer is empty,
   // but it is clearer (I think) to think of it as two separate cases.
   if ((have_bytes + len >= 2 * wBufSize_) || (have_bytes == 0)) {
-    // TODO(dreiss): writev
-    if (have_bytes > 0) {
-      transport_->write(wBuf_.get(), have_bytes);
-    }
-    transport_->write(buf, len);
+    TIOBuffer bufs[] = {{wBuf_.get(), have_bytes}, {buf, len}};
     wBase_ = wBuf_.get();
+    transport_->writev(bufs, 2);
     return;
   }
 
@@ -228,6 +225,26 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   while (new_size < len + have) {
     new_size = new_size > 0 ? new_size * 2 : 1;
   }
+  resizeWriteBuffer(new_size);
+
+  // Copy the data into the new buffer.
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+void TFramedTransport::reserve(uint32_t len) {
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  if (len + have < have /* overflow */ || len + have > 0x7fffffff) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Attempted to write over 2 GB to TFramedTransport.");
+  }
+  if (len + have > wBufSize_) {
+    resizeWriteBuffer(len + have);
+  }
+}
+
+void TFramedTransport::resizeWriteBuffer(uint32_t new_size) {
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
 
   // TODO(dreiss): Consider modifying this class to use malloc/free
   // so we can use realloc here.
@@ -243,10 +260,6 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   wBufSize_ = new_size;
   wBase_ = wBuf_.get() + have;
   wBound_ = wBuf_.get() + wBufSize_;
-
-  // Copy the data into the new buffer.
-  memcpy(wBase_, buf, len);
-  wBase_ += len;
 }
 
 void TFramedTransport::flush() {
@@ -377,7 +390,28 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
   const double suggested_buffer_size = std::exp2(std::ceil(std::log2(required_buffer_size)));
   // Unless the power of two exceeds maxBufferSize_:
   const uint64_t new_size = static_cast<uint64_t>((std::min)(suggested_buffer_size, static_cast<double>(maxBufferSize_)));
+  resizeBuffer(new_size);
+}
+
+void TMemoryBuffer::reserve(uint32_t len) {
+  uint32_t avail = available_write();
+  if (len <= avail) {
+    return;
+  }
+
+  if (!owner_) {
+    throw TTransportException("Insufficient space in external MemoryBuffer");
+  }
+
+  const uint64_t required_buffer_size = static_cast<uint64_t>(len) + (bufferSize_ - avail);
+  if (required_buffer_size > maxBufferSize_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Internal buffer size overflow when requesting a buffer of size " + std::to_string(required_buffer_size));
+  }
+  resizeBuffer(required_buffer_size);
+}
 
+void TMemoryBuffer::resizeBuffer(uint64_t new_size) {
   // Allocate into a new pointer so we don't bork ours if it fails.
   auto* new_buffer = static_cast<uint8_t*>(std::realloc(buffer_, static_cast<std::size_t>(new_size)));
   if (new_buffer == nullptr) {
@@ -394,6 +394,14 @@ public:
    */
   const std::string getOrigin() const override { return transport_->getOrigin(); }
 
+  /**
+   * Make room in the current frame for len more bytes with one allocation
+   * of exactly the needed size, instead of doubling the write buffer while
+   * the frame is written.  Typically called with the serializedSize() of
+   * the message about to be written.
+   */
+  void reserve(uint32_t len) override;
+
   /**
    * Set the maximum size of the frame at read
    */
@@ -413,6 +421,9 @@ protected:
    */
   virtual bool readFrame();
 
+  // Reallocate the write buffer to new_size bytes, keeping the frame so far.
+  void resizeWriteBuffer(uint32_t new_size);
+
   void initPointers() {
     setReadBuffer(nullptr, 0);
     setWriteBuffer(wBuf_.get(), wBufSize_);
@@ -693,6 +704,12 @@ public:
   // that had been provided by getWritePtr().
   void wroteBytes(uint32_t len);
 
+  // Makes room for writing 'len' more bytes, growing the buffer to exactly
+  // the size needed rather than the next power of two.  Reserving the
+  // serializedSize() of a message before writing it fills the buffer with
+  // a single allocation.
+  void reserve(uint32_t len) override;
+
   /*
    * TVirtualTransport provides a default implementation of readAll().
    * We want to use the TBufferBase version instead.
@@ -722,7 +739,9 @@ public:
     maxBufferSize_ = maxSize;
   }
 
-protected:
+  /**
+   * Exchanges the contents and buffers of two memory buffers.
+   */
   void swap(TMemoryBuffer& that) {
     using std::swap;
     swap(buffer_, that.buffer_);
@@ -736,9 +755,34 @@ protected:
     swap(owner_, that.owner_);
   }
 
+  /**
+   * Hands the buffer over to the caller, who must std::free() it, and leaves
+   * this memory buffer empty.  Writes fail until a buffer is set again with
+   * resetBuffer().
+   *
+   * @param size set to the size of the buffer
+   * @return the buffer, or nullptr if this memory buffer does not own one
+   */
+  uint8_t* releaseBuffer(uint32_t* size) {
+    uint8_t* buffer = owner_ ? buffer_ : nullptr;
+    *size = owner_ ? bufferSize_ : 0;
+    buffer_ = nullptr;
+    bufferSize_ = 0;
+    rBase_ = nullptr;
+    rBound_ = nullptr;
+    wBase_ = nullptr;
+    wBound_ = nullptr;
+    owner_ = false;
+    return buffer;
+  }
+
+protected:
   // Make sure there's at least 'len' bytes available for writing.
   void ensureCanWrite(uint32_t len);
 
+  // Reallocate the buffer to new_size bytes, keeping its contents.
+  void resizeBuffer(uint64_t new_size);
+
   // Compute the position and available data for reading.
   void computeRead(uint32_t len, uint8_t** out_start, uint32_t* out_give);
 
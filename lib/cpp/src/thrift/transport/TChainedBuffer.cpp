@@ -0,0 +1,194 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+
+#include <thrift/transport/TChainedBuffer.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TChainedBuffer::TChainedBuffer(std::shared_ptr<TTransport> transport,
+                               uint32_t blockSize,
+                               std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    transport_(transport),
+    blockSize_(blockSize > 0 ? blockSize : DEFAULT_BLOCK_SIZE),
+    usedBlocks_(0),
+    runStart_(nullptr),
+    wBase_(nullptr),
+    wBound_(nullptr),
+    size_(0),
+    readSegment_(0),
+    readOffset_(0) {
+}
+
+uint32_t TChainedBuffer::read(uint8_t* buf, uint32_t len) {
+  if (transport_) {
+    return transport_->read(buf, len);
+  }
+  checkReadBytesAvailable(len);
+  closeRun();
+  uint32_t got = 0;
+  while (got < len && readSegment_ < segments_.size()) {
+    const TIOBuffer& segment = segments_[readSegment_];
+    uint32_t give = (std::min)(len - got, segment.size - readOffset_);
+    std::memcpy(buf + got, segment.data + readOffset_, give);
+    got += give;
+    readOffset_ += give;
+    if (readOffset_ == segment.size) {
+      readSegment_++;
+      readOffset_ = 0;
+    }
+  }
+  size_ -= got;
+  if (readSegment_ == segments_.size()) {
+    clear();
+  }
+  return got;
+}
+
+void TChainedBuffer::writeSlow(const uint8_t* buf, uint32_t len) {
+  checkSize(len);
+  copy(buf, len);
+}
+
+void TChainedBuffer::appendReference(const uint8_t* buf,
+                                     uint32_t len,
+                                     std::shared_ptr<const void> owner) {
+  if (len == 0) {
+    return;
+  }
+  checkSize(len);
+  closeRun();
+  TIOBuffer segment = {buf, len};
+  segments_.push_back(segment);
+  size_ += len;
+  if (owner) {
+    owners_.push_back(std::move(owner));
+  }
+}
+
+void TChainedBuffer::prepend(const uint8_t* buf, uint32_t len) {
+  if (len == 0) {
+    return;
+  }
+  checkSize(len);
+  closeRun();
+  trimRead();
+  size_t first = segments_.size();
+  copy(buf, len);
+  closeRun();
+  std::rotate(segments_.begin() + static_cast<ptrdiff_t>(readSegment_),
+              segments_.begin() + static_cast<ptrdiff_t>(first),
+              segments_.end());
+}
+
+void TChainedBuffer::flush() {
+  resetConsumedMessageSize();
+  if (!transport_) {
+    return;
+  }
+  closeRun();
+  trimRead();
+  if (readSegment_ < segments_.size()) {
+    // Referenced memory has to stay alive until the write is done, so the
+    // chain is cleared afterwards, also when the write throws.
+    try {
+      transport_->writev(segments_.data() + readSegment_,
+                         static_cast<uint32_t>(segments_.size() - readSegment_));
+    } catch (...) {
+      clear();
+      throw;
+    }
+    clear();
+  }
+  transport_->flush();
+}
+
+void TChainedBuffer::getBuffers(std::vector<TIOBuffer>& bufs) {
+  closeRun();
+  trimRead();
+  bufs.insert(bufs.end(), segments_.begin() + static_cast<ptrdiff_t>(readSegment_), segments_.end());
+}
+
+void TChainedBuffer::clear() {
+  segments_.clear();
+  owners_.clear();
+  size_ = 0;
+  readSegment_ = 0;
+  readOffset_ = 0;
+  // Keep copying into the first block, so that the next write takes the
+  // fast path
+  if (blocks_.empty()) {
+    usedBlocks_ = 0;
+    runStart_ = wBase_ = wBound_ = nullptr;
+  } else {
+    usedBlocks_ = 1;
+    runStart_ = wBase_ = blocks_[0].get();
+    wBound_ = wBase_ + blockSize_;
+  }
+}
+
+void TChainedBuffer::closeRun() {
+  if (wBase_ > runStart_) {
+    auto len = static_cast<uint32_t>(wBase_ - runStart_);
+    TIOBuffer segment = {runStart_, len};
+    segments_.push_back(segment);
+    size_ += len;
+    runStart_ = wBase_;
+  }
+}
+
+void TChainedBuffer::copy(const uint8_t* buf, uint32_t len) {
+  while (len > 0) {
+    if (wBase_ == wBound_) {
+      closeRun();
+      if (usedBlocks_ == blocks_.size()) {
+        blocks_.emplace_back(new uint8_t[blockSize_]);
+      }
+      runStart_ = wBase_ = blocks_[usedBlocks_++].get();
+      wBound_ = wBase_ + blockSize_;
+    }
+    uint32_t give = (std::min)(len, static_cast<uint32_t>(wBound_ - wBase_));
+    std::memcpy(wBase_, buf, give);
+    wBase_ += give;
+    buf += give;
+    len -= give;
+  }
+}
+
+void TChainedBuffer::trimRead() {
+  if (readOffset_ > 0) {
+    segments_[readSegment_].data += readOffset_;
+    segments_[readSegment_].size -= readOffset_;
+    readOffset_ = 0;
+  }
+}
+
+void TChainedBuffer::checkSize(uint32_t len) const {
+  if (len > (std::numeric_limits<uint32_t>::max)() - size()) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Attempted to write over 4 GB to TChainedBuffer.");
+  }
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCHAINEDBUFFER_H_
+#define _THRIFT_TRANSPORT_TCHAINEDBUFFER_H_ 1
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <thrift/transport/TTransport.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Write buffer kept as a chain of segments.  Each segment is either copied
+ * into one of the buffer's own blocks or refers to memory owned by someone
+ * else.  flush() hands the whole chain to the underlying transport with one
+ * writev(), which TSocket sends with a single sendmsg().
+ *
+ * write() always copies, as its callers may reuse their buffer as soon as it
+ * returns.  Large payloads whose memory is known to outlive the next flush()
+ * are added without a copy with appendReference().
+ *
+ * Reads come from the underlying transport, or from the chain itself when
+ * there is none.
+ */
+class TChainedBuffer : public TVirtualTransport<TChainedBuffer> {
+public:
+  static const uint32_t DEFAULT_BLOCK_SIZE = 4096;
+
+  TChainedBuffer(std::shared_ptr<TTransport> transport = nullptr,
+                 uint32_t blockSize = DEFAULT_BLOCK_SIZE,
+                 std::shared_ptr<TConfiguration> config = nullptr);
+
+  bool isOpen() const override { return transport_ ? transport_->isOpen() : true; }
+
+  bool peek() override { return transport_ ? transport_->peek() : size() > 0; }
+
+  void open() override {
+    if (transport_) {
+      transport_->open();
+    }
+  }
+
+  void close() override {
+    flush();
+    if (transport_) {
+      transport_->close();
+    }
+  }
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  /**
+   * Copies buf into the chain.
+   */
+  void write(const uint8_t* buf, uint32_t len) {
+    if (len <= static_cast<uint32_t>(wBound_ - wBase_)) {
+      std::memcpy(wBase_, buf, len);
+      wBase_ += len;
+      return;
+    }
+    writeSlow(buf, len);
+  }
+
+  /**
+   * Appends len bytes at buf without copying them.  The memory must stay
+   * valid until the next flush(), or for as long as owner is held, which
+   * the buffer keeps until then.
+   */
+  void appendReference(const uint8_t* buf,
+                       uint32_t len,
+                       std::shared_ptr<const void> owner = nullptr);
+
+  /**
+   * Copies buf in front of the unread data, for headers that are only known
+   * once the payload has been written.
+   */
+  void prepend(const uint8_t* buf, uint32_t len);
+
+  /**
+   * Writes the chain to the underlying transport with one writev() and
+   * flushes it.  Does nothing without an underlying transport.
+   */
+  void flush() override;
+
+  /**
+   * Number of bytes written and not yet flushed or read.
+   */
+  uint32_t size() const { return size_ + static_cast<uint32_t>(wBase_ - runStart_); }
+
+  /**
+   * Appends the unread segments to bufs.  They stay valid until the next
+   * flush() or clear().
+   */
+  void getBuffers(std::vector<TIOBuffer>& bufs);
+
+  /**
+   * Drops everything written, keeping the blocks for reuse.
+   */
+  void clear();
+
+  std::shared_ptr<TTransport> getUnderlyingTransport() { return transport_; }
+
+  const std::string getOrigin() const override {
+    return transport_ ? transport_->getOrigin() : "Unknown";
+  }
+
+private:
+  void writeSlow(const uint8_t* buf, uint32_t len);
+
+  // Ends the segment being copied into the current block
+  void closeRun();
+
+  void copy(const uint8_t* buf, uint32_t len);
+
+  // Drops the part of the first unread segment that has been read already
+  void trimRead();
+
+  void checkSize(uint32_t len) const;
+
+  std::shared_ptr<TTransport> transport_;
+  uint32_t blockSize_;
+
+  std::vector<std::unique_ptr<uint8_t[]> > blocks_;
+  // Number of blocks in use; the last of them is being copied into
+  size_t usedBlocks_;
+  uint8_t* runStart_;
+  uint8_t* wBase_;
+  uint8_t* wBound_;
+
+  std::vector<TIOBuffer> segments_;
+  // Unread bytes in segments_
+  uint32_t size_;
+  size_t readSegment_;
+  uint32_t readOffset_;
+
+  // Owners of referenced memory, released by flush() and clear()
+  std::vector<std::shared_ptr<const void> > owners_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCHAINEDBUFFER_H_
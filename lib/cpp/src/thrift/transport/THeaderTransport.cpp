@@ -23,11 +23,18 @@
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/protocol/TCompactProtocol.h>
 
+#include <algorithm>
 #include <limits>
 #include <utility>
 #include <string>
 #include <string.h>
 #include <zlib.h>
+#ifdef THRIFT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef THRIFT_HAVE_LZ4
+#include <lz4.h>
+#endif
 
 using std::map;
 using std::string;
@@ -97,6 +104,11 @@ bool THeaderTransport::readFrame() {
 
   sz = ntohl(szN);
 
+  // The previous frame's headers point into rBuf_, which is about to be reused
+  readHeaderTable_.clear();
+  readHeaders_.clear();
+  readHeadersValid_ = true;
+
   ensureReadBuffer(4);
 
   if ((sz & TBinaryProtocol::VERSION_MASK) == (uint32_t)TBinaryProtocol::VERSION_1) {
@@ -174,27 +186,26 @@ bool THeaderTransport::readFrame() {
  * Reads a string from ptr, taking care not to reach headerBoundary
  * Advances ptr on success
  *
- * @param   str             output string
+ * @return  the string, pointing into the header
  * @throws  CORRUPTED_DATA  if size of string exceeds boundary
  */
-void THeaderTransport::readString(uint8_t*& ptr,
-                                  /* out */ string& str,
-                                  uint8_t const* headerBoundary) {
+THeaderString THeaderTransport::readString(uint8_t*& ptr, uint8_t const* headerBoundary) {
   int32_t strLen;
 
-  uint32_t bytes = readVarint32(ptr, &strLen, headerBoundary);
-  if (strLen > headerBoundary - ptr) {
+  ptr += readVarint32(ptr, &strLen, headerBoundary);
+  if (strLen < 0 || strLen > headerBoundary - ptr) {
     throw TTransportException(TTransportException::CORRUPTED_DATA,
                               "Info header length exceeds header size");
   }
-  ptr += bytes;
-  str.assign(reinterpret_cast<const char*>(ptr), strLen);
+  THeaderString str(reinterpret_cast<const char*>(ptr), static_cast<uint32_t>(strLen));
   ptr += strLen;
+  return str;
 }
 
 void THeaderTransport::readHeaderFormat(uint16_t headerSize, uint32_t sz) {
   readTrans_.clear();   // Clear out any previous transforms.
-  readHeaders_.clear(); // Clear out any previous headers.
+  readHeaderTable_.reset(rBuf_.get()); // Clear out any previous headers.
+  readHeadersValid_ = false;
 
   // skip over already processed magic(4), seqId(4), headerSize(2)
   auto* ptr = reinterpret_cast<uint8_t*>(rBuf_.get() + 10);
@@ -245,12 +256,13 @@ void THeaderTransport::readHeaderFormat(uint16_t headerSize, uint32_t sz) {
       while (numKVHeaders-- && ptr < headerBoundary) {
         // format: key; value
         // both: length (varint32); value (string)
-        string key, value;
-        readString(ptr, key, headerBoundary);
+        THeaderString key = readString(ptr, headerBoundary);
         // value
-        readString(ptr, value, headerBoundary);
-        // save to headers
-        readHeaders_[key] = value;
+        THeaderString value = readString(ptr, headerBoundary);
+        // save to headers, which point into rBuf_
+        const char* frame = reinterpret_cast<const char*>(rBuf_.get());
+        readHeaderTable_.add(static_cast<uint32_t>(key.data - frame), key.size,
+                             static_cast<uint32_t>(value.data - frame), value.size);
       }
       break;
     }
@@ -260,48 +272,208 @@ void THeaderTransport::readHeaderFormat(uint16_t headerSize, uint32_t sz) {
   untransform(data, safe_numeric_cast<uint32_t>(static_cast<ptrdiff_t>(sz) - (data - rBuf_.get())));
 }
 
+/**
+ * Compression state for the transforms.  Each context is set up the first
+ * time its transform is used and reset between messages, which is much
+ * cheaper than building a new one for every small message.
+ */
+struct THeaderTransport::Codecs {
+  Codecs() : deflateReady(false), inflateReady(false) {
+    memset(&deflater, 0, sizeof(deflater));
+    memset(&inflater, 0, sizeof(inflater));
+  }
+
+  ~Codecs() {
+    if (deflateReady) {
+      deflateEnd(&deflater);
+    }
+    if (inflateReady) {
+      inflateEnd(&inflater);
+    }
+#ifdef THRIFT_HAVE_ZSTD
+    ZSTD_freeCCtx(zstdCompressor);
+    ZSTD_freeDCtx(zstdDecompressor);
+#endif
+  }
+
+  z_stream& getDeflater() {
+    if (!deflateReady) {
+      if (deflateInit(&deflater, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while zlib deflateInit");
+      }
+      deflateReady = true;
+    } else if (deflateReset(&deflater) != Z_OK) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Error while zlib deflateReset");
+    }
+    return deflater;
+  }
+
+  z_stream& getInflater() {
+    if (!inflateReady) {
+      if (inflateInit(&inflater) != Z_OK) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while zlib inflateInit");
+      }
+      inflateReady = true;
+    } else if (inflateReset(&inflater) != Z_OK) {
+      throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                  "Error while zlib inflateReset");
+    }
+    return inflater;
+  }
+
+  z_stream deflater;
+  bool deflateReady;
+  z_stream inflater;
+  bool inflateReady;
+
+#ifdef THRIFT_HAVE_ZSTD
+  ZSTD_CCtx* zstdCompressor = nullptr;
+  ZSTD_DCtx* zstdDecompressor = nullptr;
+#endif
+#ifdef THRIFT_HAVE_LZ4
+  std::unique_ptr<char[]> lz4State;
+#endif
+};
+
+void THeaderTransport::CodecsDeleter::operator()(Codecs* codecs) const {
+  delete codecs;
+}
+
+THeaderTransport::Codecs& THeaderTransport::getCodecs() {
+  if (!codecs_) {
+    codecs_.reset(new Codecs());
+  }
+  return *codecs_;
+}
+
+bool THeaderTransport::isTransformSupported(uint16_t transId) {
+  switch (transId) {
+  case ZLIB_TRANSFORM:
+    return true;
+#ifdef THRIFT_HAVE_ZSTD
+  case ZSTD_TRANSFORM:
+    return true;
+#endif
+#ifdef THRIFT_HAVE_LZ4
+  case LZ4_TRANSFORM:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+/**
+ * Makes room for size bytes of untransformed data, keeping the first keep
+ * bytes already there.
+ */
+void THeaderTransport::resizeUntransformBuffer(uint32_t size, uint32_t keep) {
+  if (size > MAX_FRAME_SIZE) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Untransformed frame is too large");
+  }
+  if (size > uBufSize_) {
+    std::unique_ptr<uint8_t[]> new_buf(new uint8_t[size]);
+    if (keep > 0) {
+      memcpy(new_buf.get(), uBuf_.get(), keep);
+    }
+    uBuf_ = std::move(new_buf);
+    uBufSize_ = size;
+  }
+}
+
 void THeaderTransport::untransform(uint8_t* ptr, uint32_t sz) {
-  // Update the transform buffer size if needed
-  resizeTransformBuffer();
+  // Each transform decodes into uBuf_; one that reads from it needs the
+  // previous output moved out of the way first.
+  std::unique_ptr<uint8_t[]> input;
 
   for (vector<uint16_t>::const_iterator it = readTrans_.begin(); it != readTrans_.end(); ++it) {
     const uint16_t transId = *it;
 
-    if (transId == ZLIB_TRANSFORM) {
-      z_stream stream;
-      int err;
+    if (ptr == uBuf_.get()) {
+      input = std::move(uBuf_);
+      uBufSize_ = 0;
+    }
 
+    if (transId == ZLIB_TRANSFORM) {
+      z_stream& stream = getCodecs().getInflater();
       stream.next_in = ptr;
       stream.avail_in = sz;
 
-      // Setting these to 0 means use the default free/alloc functions
-      stream.zalloc = (alloc_func)nullptr;
-      stream.zfree = (free_func)nullptr;
-      stream.opaque = (voidpf)nullptr;
-      err = inflateInit(&stream);
-      if (err != Z_OK) {
+      uint32_t out_size = 0;
+      int err = Z_OK;
+      while (err != Z_STREAM_END) {
+        uint32_t new_size = (std::max)(uBufSize_,
+                                       (std::min)(sz * 2 + DEFAULT_BUFFER_SIZE,
+                                                  static_cast<uint32_t>(MAX_FRAME_SIZE)));
+        if (out_size == new_size) {
+          new_size = out_size > MAX_FRAME_SIZE / 2 ? MAX_FRAME_SIZE + 1 : out_size * 2;
+        }
+        resizeUntransformBuffer(new_size, out_size);
+        stream.next_out = uBuf_.get() + out_size;
+        stream.avail_out = uBufSize_ - out_size;
+        err = inflate(&stream, Z_FINISH);
+        out_size = uBufSize_ - stream.avail_out;
+        if (err != Z_STREAM_END && err != Z_BUF_ERROR && err != Z_OK) {
+          throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                      "Error while zlib inflate");
+        }
+        if (err != Z_STREAM_END && stream.avail_out != 0) {
+          // The input ran out before the end of the stream
+          throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                      "Error while zlib inflate");
+        }
+      }
+      sz = out_size;
+#ifdef THRIFT_HAVE_ZSTD
+    } else if (transId == ZSTD_TRANSFORM) {
+      Codecs& codecs = getCodecs();
+      if (!codecs.zstdDecompressor) {
+        codecs.zstdDecompressor = ZSTD_createDCtx();
+      }
+      unsigned long long out_size = ZSTD_getFrameContentSize(ptr, sz);
+      if (out_size == ZSTD_CONTENTSIZE_UNKNOWN || out_size == ZSTD_CONTENTSIZE_ERROR
+          || out_size > MAX_FRAME_SIZE) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflateInit");
+                                    "Error while zstd decompress");
       }
-      stream.next_out = tBuf_.get();
-      stream.avail_out = tBufSize_;
-      err = inflate(&stream, Z_FINISH);
-      if (err != Z_STREAM_END || stream.avail_out == 0) {
+      resizeUntransformBuffer(static_cast<uint32_t>(out_size), 0);
+      size_t result = ZSTD_decompressDCtx(codecs.zstdDecompressor, uBuf_.get(),
+                                          static_cast<size_t>(out_size), ptr, sz);
+      if (ZSTD_isError(result) || result != out_size) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflate");
+                                    "Error while zstd decompress");
       }
-      sz = stream.total_out;
-
-      err = inflateEnd(&stream);
-      if (err != Z_OK) {
+      sz = static_cast<uint32_t>(out_size);
+#endif
+#ifdef THRIFT_HAVE_LZ4
+    } else if (transId == LZ4_TRANSFORM) {
+      // A 4-byte big-endian uncompressed size, then one LZ4 block
+      uint32_t out_size_n;
+      if (sz < sizeof(out_size_n)) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflateEnd");
+                                    "Error while lz4 decompress");
       }
-
-      memcpy(ptr, tBuf_.get(), sz);
+      memcpy(&out_size_n, ptr, sizeof(out_size_n));
+      uint32_t out_size = ntohl(out_size_n);
+      resizeUntransformBuffer(out_size, 0);
+      int result = LZ4_decompress_safe(reinterpret_cast<const char*>(ptr) + sizeof(out_size_n),
+                                       reinterpret_cast<char*>(uBuf_.get()),
+                                       static_cast<int>(sz - sizeof(out_size_n)),
+                                       static_cast<int>(out_size));
+      if (result < 0 || static_cast<uint32_t>(result) != out_size) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while lz4 decompress");
+      }
+      sz = out_size;
+#endif
     } else {
       throw TApplicationException(TApplicationException::MISSING_RESULT, "Unknown transform");
     }
+    ptr = uBuf_.get();
   }
 
   setReadBuffer(ptr, sz);
@@ -315,7 +487,7 @@ void THeaderTransport::untransform(uint8_t* ptr, uint32_t sz) {
  * compression transforms (that may slightly grow on small frame sizes)
  */
 void THeaderTransport::resizeTransformBuffer(uint32_t additionalSize) {
-  if (tBufSize_ < wBufSize_ + DEFAULT_BUFFER_SIZE) {
+  if (tBufSize_ < wBufSize_ + DEFAULT_BUFFER_SIZE + additionalSize) {
     uint32_t new_size = wBufSize_ + DEFAULT_BUFFER_SIZE + additionalSize;
     auto* new_buf = new uint8_t[new_size];
     tBuf_.reset(new_buf);
@@ -324,50 +496,80 @@ void THeaderTransport::resizeTransformBuffer(uint32_t additionalSize) {
 }
 
 void THeaderTransport::transform(uint8_t* ptr, uint32_t sz) {
-  // Update the transform buffer size if needed
-  resizeTransformBuffer();
-
   for (vector<uint16_t>::const_iterator it = writeTrans_.begin(); it != writeTrans_.end(); ++it) {
     const uint16_t transId = *it;
 
+    // Size the transform buffer once, for the worst case of the codec
     if (transId == ZLIB_TRANSFORM) {
-      z_stream stream;
-      int err;
+      z_stream& stream = getCodecs().getDeflater();
+      uint32_t bound = safe_numeric_cast<uint32_t>(deflateBound(&stream, sz));
+      resizeTransformBuffer(bound > wBufSize_ ? bound - wBufSize_ : 0);
 
       stream.next_in = ptr;
       stream.avail_in = sz;
-
-      stream.zalloc = (alloc_func)nullptr;
-      stream.zfree = (free_func)nullptr;
-      stream.opaque = (voidpf)nullptr;
-      err = deflateInit(&stream, Z_DEFAULT_COMPRESSION);
-      if (err != Z_OK) {
+      stream.next_out = tBuf_.get();
+      stream.avail_out = tBufSize_;
+      if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
         throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateInit");
+                                  "Error while zlib deflate");
       }
-      uint32_t tbuf_size = 0;
-      while (err == Z_OK) {
-        resizeTransformBuffer(tbuf_size);
-
-        stream.next_out = tBuf_.get();
-        stream.avail_out = tBufSize_;
-        err = deflate(&stream, Z_FINISH);
-        tbuf_size += DEFAULT_BUFFER_SIZE;
+      sz = safe_numeric_cast<uint32_t>(stream.total_out);
+#ifdef THRIFT_HAVE_ZSTD
+    } else if (transId == ZSTD_TRANSFORM) {
+      Codecs& codecs = getCodecs();
+      if (!codecs.zstdCompressor) {
+        codecs.zstdCompressor = ZSTD_createCCtx();
       }
-      sz = stream.total_out;
+      uint32_t bound = safe_numeric_cast<uint32_t>(ZSTD_compressBound(sz));
+      resizeTransformBuffer(bound > wBufSize_ ? bound - wBufSize_ : 0);
 
-      err = deflateEnd(&stream);
-      if (err != Z_OK) {
+      size_t result = ZSTD_compressCCtx(codecs.zstdCompressor, tBuf_.get(), tBufSize_, ptr, sz,
+                                        ZSTD_CLEVEL_DEFAULT);
+      if (ZSTD_isError(result)) {
         throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateEnd");
+                                  "Error while zstd compress");
       }
-
-      memcpy(ptr, tBuf_.get(), sz);
+      sz = static_cast<uint32_t>(result);
+#endif
+#ifdef THRIFT_HAVE_LZ4
+    } else if (transId == LZ4_TRANSFORM) {
+      Codecs& codecs = getCodecs();
+      if (!codecs.lz4State) {
+        codecs.lz4State.reset(new char[LZ4_sizeofState()]);
+      }
+      uint32_t bound = static_cast<uint32_t>(LZ4_compressBound(static_cast<int>(sz)))
+                       + sizeof(uint32_t);
+      resizeTransformBuffer(bound > wBufSize_ ? bound - wBufSize_ : 0);
+
+      uint32_t sz_n = htonl(sz);
+      memcpy(tBuf_.get(), &sz_n, sizeof(sz_n));
+      int result = LZ4_compress_fast_extState(codecs.lz4State.get(),
+                                              reinterpret_cast<const char*>(ptr),
+                                              reinterpret_cast<char*>(tBuf_.get()) + sizeof(sz_n),
+                                              static_cast<int>(sz),
+                                              static_cast<int>(tBufSize_ - sizeof(sz_n)),
+                                              1);
+      if (result <= 0) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while lz4 compress");
+      }
+      sz = static_cast<uint32_t>(result) + sizeof(sz_n);
+#endif
     } else {
       throw TTransportException(TTransportException::CORRUPTED_DATA, "Unknown transform");
     }
+
+    // Incompressible data can come out larger than the write buffer
+    if (sz > wBufSize_) {
+      wBase_ = wBuf_.get();
+      resizeWriteBuffer(sz);
+      ptr = wBuf_.get();
+    }
+    memcpy(ptr, tBuf_.get(), sz);
   }
 
+  // Leave room for the header flush builds in the transform buffer
+  resizeTransformBuffer();
   wBase_ = wBuf_.get() + sz;
 }
 
@@ -388,32 +590,139 @@ uint32_t THeaderTransport::getWriteBytes() {
  * terminated)
  * Automatically advances ptr to after the written portion
  */
-void THeaderTransport::writeString(uint8_t*& ptr, const string& str) {
-  auto strLen = safe_numeric_cast<int32_t>(str.length());
-  ptr += writeVarint32(strLen, ptr);
-  memcpy(ptr, str.c_str(), strLen); // no need to write \0
-  ptr += strLen;
-}
-
-void THeaderTransport::setHeader(const string& key, const string& value) {
-  writeHeaders_[key] = value;
+void THeaderTransport::writeString(uint8_t*& ptr, const char* str, uint32_t len) {
+  ptr += writeVarint32(safe_numeric_cast<int32_t>(len), ptr);
+  memcpy(ptr, str, len); // no need to write \0
+  ptr += len;
 }
 
 uint32_t THeaderTransport::getMaxWriteHeadersSize() const {
+  // 2 varints32 + the strings themselves, for each header
   size_t maxWriteHeadersSize = 0;
   THeaderTransport::StringToStringMap::const_iterator it;
   for (it = writeHeaders_.begin(); it != writeHeaders_.end(); ++it) {
-    // add sizes of key and value to maxWriteHeadersSize
-    // 2 varints32 + the strings themselves
     maxWriteHeadersSize += 5 + 5 + (it->first).length() + (it->second).length();
   }
+  for (uint32_t i = 0; i < writeHeaderTable_.size(); i++) {
+    maxWriteHeadersSize += 5 + 5 + writeHeaderTable_.key(i).size + writeHeaderTable_.value(i).size;
+  }
   return safe_numeric_cast<uint32_t>(maxWriteHeadersSize);
 }
 
 void THeaderTransport::clearHeaders() {
+  writeHeaderTable_.clear();
   writeHeaders_.clear();
 }
 
+THeaderTransport::StringToStringMap& THeaderTransport::getWriteHeaders() {
+  for (uint32_t i = 0; i < writeHeaderTable_.size(); i++) {
+    writeHeaders_[writeHeaderTable_.key(i).str()] = writeHeaderTable_.value(i).str();
+  }
+  writeHeaderTable_.clear();
+  return writeHeaders_;
+}
+
+const THeaderTransport::StringToStringMap& THeaderTransport::getHeaders() const {
+  if (!readHeadersValid_) {
+    readHeaders_.clear();
+    for (uint32_t i = 0; i < readHeaderTable_.size(); i++) {
+      readHeaders_[readHeaderTable_.key(i).str()] = readHeaderTable_.value(i).str();
+    }
+    readHeadersValid_ = true;
+  }
+  return readHeaders_;
+}
+
+bool THeaderTable::find(const char* key, uint32_t keySize, THeaderString& value) const {
+  const Entry* begin = entries();
+  const char* strings = base();
+  for (const Entry* entry = begin + size_; entry != begin; ) {
+    --entry;
+    if (entry->keySize == keySize
+        && (keySize == 0 || memcmp(strings + entry->keyOffset, key, keySize) == 0)) {
+      value = THeaderString(strings + entry->valueOffset, entry->valueSize);
+      return true;
+    }
+  }
+  return false;
+}
+
+void THeaderTable::set(const char* key, uint32_t keySize, const char* value, uint32_t valueSize) {
+  // The strings may already be in strings_, which append() can move
+  if (strings_.size() + keySize + valueSize > (std::numeric_limits<uint32_t>::max)()) {
+    throw TTransportException(TTransportException::BAD_ARGS, "Info headers are too large");
+  }
+  Entry* existing = nullptr;
+  Entry* begin = entries();
+  for (Entry* entry = begin; entry != begin + size_; ++entry) {
+    if (entry->keySize == keySize
+        && (keySize == 0 || memcmp(base() + entry->keyOffset, key, keySize) == 0)) {
+      existing = entry;
+      break;
+    }
+  }
+  std::string value_copy;
+  if (value >= strings_.data() && value < strings_.data() + strings_.size()) {
+    value_copy.assign(value, valueSize);
+    value = value_copy.data();
+  }
+
+  Entry entry;
+  if (existing) {
+    entry.keyOffset = existing->keyOffset;
+  } else {
+    entry.keyOffset = static_cast<uint32_t>(strings_.size());
+    strings_.append(key, keySize);
+  }
+  entry.keySize = keySize;
+  entry.valueOffset = static_cast<uint32_t>(strings_.size());
+  entry.valueSize = valueSize;
+  strings_.append(value, valueSize);
+
+  if (existing) {
+    *existing = entry;
+  } else {
+    push(entry);
+  }
+}
+
+void THeaderTable::clear() {
+  frame_ = nullptr;
+  strings_.clear();
+  size_ = 0;
+  overflow_.clear();
+}
+
+void THeaderTable::reset(const uint8_t* frame) {
+  clear();
+  frame_ = reinterpret_cast<const char*>(frame);
+}
+
+void THeaderTable::add(uint32_t keyOffset,
+                       uint32_t keySize,
+                       uint32_t valueOffset,
+                       uint32_t valueSize) {
+  Entry entry;
+  entry.keyOffset = keyOffset;
+  entry.keySize = keySize;
+  entry.valueOffset = valueOffset;
+  entry.valueSize = valueSize;
+  push(entry);
+}
+
+void THeaderTable::push(const Entry& entry) {
+  if (overflow_.empty()) {
+    if (size_ < INLINE_HEADERS) {
+      inline_[size_++] = entry;
+      return;
+    }
+    overflow_.reserve(2 * INLINE_HEADERS);
+    overflow_.assign(inline_, inline_ + size_);
+  }
+  overflow_.push_back(entry);
+  size_++;
+}
+
 void THeaderTransport::flush() {
   resetConsumedMessageSize();
   // Write out any data waiting in the write buffer.
@@ -450,8 +759,9 @@ void THeaderTransport::flush() {
     uint8_t* pktStart = pkt;
 
     if (maxSzHbo > tBufSize_) {
-      throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                "Attempting to header frame that is too large");
+      resizeTransformBuffer(headerSize);
+      pkt = tBuf_.get();
+      pktStart = pkt;
     }
 
     uint32_t szHbo;
@@ -485,18 +795,25 @@ void THeaderTransport::flush() {
     // write info headers
 
     // for now only write kv-headers
-    auto headerCount = safe_numeric_cast<int32_t>(writeHeaders_.size());
+    auto headerCount = safe_numeric_cast<int32_t>(writeHeaders_.size() + writeHeaderTable_.size());
     if (headerCount > 0) {
       pkt += writeVarint32(infoIdType::KEYVALUE, pkt);
       // Write key-value headers count
       pkt += writeVarint32(static_cast<int32_t>(headerCount), pkt);
-      // Write info headers
+      // Write info headers.  The table goes last so that headers set after
+      // getWriteHeaders() win on the other side.
       map<string, string>::const_iterator it;
       for (it = writeHeaders_.begin(); it != writeHeaders_.end(); ++it) {
-        writeString(pkt, it->first);  // key
-        writeString(pkt, it->second); // value
+        writeString(pkt, it->first.data(), static_cast<uint32_t>(it->first.size()));   // key
+        writeString(pkt, it->second.data(), static_cast<uint32_t>(it->second.size())); // value
+      }
+      for (uint32_t i = 0; i < writeHeaderTable_.size(); i++) {
+        THeaderString key = writeHeaderTable_.key(i);
+        THeaderString value = writeHeaderTable_.value(i);
+        writeString(pkt, key.data, key.size);
+        writeString(pkt, value.data, value.size);
       }
-      writeHeaders_.clear();
+      clearHeaders();
     }
 
     // Fixups after varint size calculations
@@ -517,6 +834,10 @@ void THeaderTransport::flush() {
     }
     szHbo = headerSize + haveBytes          // thrift header + payload
             + static_cast<uint32_t>(szHbp); // common header section
+    if (headerSize / 4 >= 16384) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Attempting to send headers that are too large");
+    }
     headerSizeN = htons(headerSize / 4);
     memcpy(headerSizePtr, &headerSizeN, sizeof(headerSizeN));
 
@@ -524,14 +845,14 @@ void THeaderTransport::flush() {
     szNbo = htonl(szHbo);
     memcpy(pktStart, &szNbo, sizeof(szNbo));
 
-    outTransport_->write(pktStart, szHbo - haveBytes + 4);
-    outTransport_->write(wBuf_.get(), haveBytes);
+    TIOBuffer bufs[] = {{pktStart, szHbo - haveBytes + 4}, {wBuf_.get(), haveBytes}};
+    outTransport_->writev(bufs, 2);
   } else if (clientType == THRIFT_FRAMED_BINARY || clientType == THRIFT_FRAMED_COMPACT) {
     auto szHbo = (uint32_t)haveBytes;
     uint32_t szNbo = htonl(szHbo);
 
-    outTransport_->write(reinterpret_cast<uint8_t*>(&szNbo), 4);
-    outTransport_->write(wBuf_.get(), haveBytes);
+    TIOBuffer bufs[] = {{reinterpret_cast<uint8_t*>(&szNbo), 4}, {wBuf_.get(), haveBytes}};
+    outTransport_->writev(bufs, 2);
   } else if (clientType == THRIFT_UNFRAMED_BINARY || clientType == THRIFT_UNFRAMED_COMPACT) {
     outTransport_->write(wBuf_.get(), haveBytes);
   } else {
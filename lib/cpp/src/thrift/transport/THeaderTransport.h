@@ -25,6 +25,7 @@
 #include <vector>
 #include <stdexcept>
 #include <string>
+#include <string.h>
 #include <map>
 
 #ifdef HAVE_STDINT_H
@@ -53,6 +54,120 @@ namespace transport {
 
 using apache::thrift::protocol::T_COMPACT_PROTOCOL;
 
+/**
+ * A string held in a buffer owned by someone else.
+ */
+struct THeaderString {
+  THeaderString() : data(nullptr), size(0) {}
+  THeaderString(const char* data, uint32_t size) : data(data), size(size) {}
+
+  bool equals(const char* str, uint32_t len) const {
+    return size == len && (len == 0 || memcmp(data, str, len) == 0);
+  }
+
+  std::string str() const { return std::string(data, size); }
+
+  const char* data;
+  uint32_t size;
+};
+
+/**
+ * Flat table of key/value info headers.
+ *
+ * The strings are not copied into separate allocations: a table built by
+ * THeaderTransport for a received frame points into that frame, and one
+ * filled with set() keeps all its strings in a single buffer.  The first
+ * INLINE_HEADERS entries need no allocation at all, and clear() keeps any
+ * memory for reuse by the next message.
+ *
+ * Entries keep the order they were added in.  A key may appear more than
+ * once; find() returns the last value, as a map built from the entries
+ * would.
+ */
+class THeaderTable {
+public:
+  static const uint32_t INLINE_HEADERS = 8;
+
+  THeaderTable() : frame_(nullptr), size_(0) {}
+
+  THeaderTable(const THeaderTable&) = delete;
+  THeaderTable& operator=(const THeaderTable&) = delete;
+
+  uint32_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  THeaderString key(uint32_t i) const {
+    const Entry& entry = entries()[i];
+    return THeaderString(base() + entry.keyOffset, entry.keySize);
+  }
+
+  THeaderString value(uint32_t i) const {
+    const Entry& entry = entries()[i];
+    return THeaderString(base() + entry.valueOffset, entry.valueSize);
+  }
+
+  /**
+   * Looks up the last value stored for key.
+   *
+   * @return false if there is no such header
+   */
+  bool find(const char* key, uint32_t keySize, THeaderString& value) const;
+
+  bool find(const std::string& key, THeaderString& value) const {
+    return find(key.data(), static_cast<uint32_t>(key.size()), value);
+  }
+
+  /**
+   * Sets a header, copying both strings into the table.  An existing header
+   * with the same key is replaced.
+   */
+  void set(const char* key, uint32_t keySize, const char* value, uint32_t valueSize);
+
+  void set(const std::string& key, const std::string& value) {
+    set(key.data(), static_cast<uint32_t>(key.size()),
+        value.data(), static_cast<uint32_t>(value.size()));
+  }
+
+  /**
+   * Removes all headers.  A table that referenced a frame is detached from
+   * it.
+   */
+  void clear();
+
+  /**
+   * Clears the table and makes it reference strings inside frame, which
+   * must outlive the entries added with add().
+   */
+  void reset(const uint8_t* frame);
+
+  /**
+   * Adds a header whose key and value are at the given offsets into the
+   * frame passed to reset().
+   */
+  void add(uint32_t keyOffset, uint32_t keySize, uint32_t valueOffset, uint32_t valueSize);
+
+private:
+  struct Entry {
+    uint32_t keyOffset;
+    uint32_t keySize;
+    uint32_t valueOffset;
+    uint32_t valueSize;
+  };
+
+  const char* base() const { return frame_ ? frame_ : strings_.data(); }
+
+  Entry* entries() { return overflow_.empty() ? inline_ : &overflow_[0]; }
+  const Entry* entries() const { return overflow_.empty() ? inline_ : &overflow_[0]; }
+
+  void push(const Entry& entry);
+
+  const char* frame_;
+  std::string strings_;
+  uint32_t size_;
+  Entry inline_[INLINE_HEADERS];
+  std::vector<Entry> overflow_;
+};
+
 /**
  * Header transport. All writes go into an in-memory buffer until flush is
  * called, at which point the transport writes the length of the entire
@@ -80,8 +195,11 @@ public:
       clientType(THRIFT_HEADER_CLIENT_TYPE),
       seqId(0),
       flags(0),
+      readHeadersValid_(true),
       tBufSize_(0),
-      tBuf_(nullptr) {
+      tBuf_(nullptr),
+      uBufSize_(0),
+      uBuf_(nullptr) {
     if (!transport_) throw std::invalid_argument("transport is empty");
     initBuffers();
   }
@@ -95,8 +213,11 @@ public:
       clientType(THRIFT_HEADER_CLIENT_TYPE),
       seqId(0),
       flags(0),
+      readHeadersValid_(true),
       tBufSize_(0),
-      tBuf_(nullptr) {
+      tBuf_(nullptr),
+      uBufSize_(0),
+      uBuf_(nullptr) {
     if (!transport_) throw std::invalid_argument("inTransport is empty");
     if (!outTransport_) throw std::invalid_argument("outTransport is empty");
     initBuffers();
@@ -151,23 +272,60 @@ public:
   typedef std::map<std::string, std::string> StringToStringMap;
 
   // these work with write headers
-  void setHeader(const std::string& key, const std::string& value);
+  void setHeader(const std::string& key, const std::string& value) {
+    writeHeaderTable_.set(key, value);
+  }
+
+  void setHeader(const char* key, uint32_t keySize, const char* value, uint32_t valueSize) {
+    writeHeaderTable_.set(key, keySize, value, valueSize);
+  }
 
   void clearHeaders();
 
-  StringToStringMap& getWriteHeaders() { return writeHeaders_; }
+  /**
+   * Headers to send with the next message, serialised straight from the
+   * table by flush().
+   */
+  const THeaderTable& getWriteHeaderTable() const { return writeHeaderTable_; }
+
+  /**
+   * Map of the headers to send with the next message, which may be modified.
+   * This moves the headers set so far into a map; prefer setHeader() and
+   * getWriteHeaderTable(), which do not allocate per header.
+   */
+  StringToStringMap& getWriteHeaders();
 
   // these work with read headers
-  const StringToStringMap& getHeaders() const { return readHeaders_; }
+
+  /**
+   * Headers of the last frame read.  The strings point into the frame and
+   * are only valid until the next frame is read.
+   */
+  const THeaderTable& getHeaderTable() const { return readHeaderTable_; }
+
+  /**
+   * Copy of the headers of the last frame read, built on first use.  Prefer
+   * getHeaderTable(), which does not allocate.
+   */
+  const StringToStringMap& getHeaders() const;
 
   // accessors for seqId
   int32_t getSequenceNumber() const { return seqId; }
   void setSequenceNumber(int32_t seqId) { this->seqId = seqId; }
 
+  // 0x02 - 0x04 are taken by transforms other implementations define
   enum TRANSFORMS {
     ZLIB_TRANSFORM = 0x01,
+    ZSTD_TRANSFORM = 0x05,
+    LZ4_TRANSFORM = 0x06,
   };
 
+  /**
+   * Whether this build can apply the transform.  zstd and LZ4 are only
+   * available when the library was built with them.
+   */
+  static bool isTransformSupported(uint16_t transId);
+
 protected:
   /**
    * Reads a frame of input from the underlying stream.
@@ -202,8 +360,12 @@ protected:
   std::vector<uint16_t> readTrans_;
   std::vector<uint16_t> writeTrans_;
 
-  // Map to use for headers
-  StringToStringMap readHeaders_;
+  // Info headers.  readHeaders_ and writeHeaders_ only back the map
+  // accessors; flush() sends writeHeaders_ before writeHeaderTable_.
+  THeaderTable readHeaderTable_;
+  THeaderTable writeHeaderTable_;
+  mutable StringToStringMap readHeaders_;
+  mutable bool readHeadersValid_;
   StringToStringMap writeHeaders_;
 
   /**
@@ -223,9 +385,24 @@ protected:
   uint32_t tBufSize_;
   std::unique_ptr<uint8_t[]> tBuf_;
 
-  void readString(uint8_t*& ptr, /* out */ std::string& str, uint8_t const* headerBoundary);
+  // Holds untransformed frames, grown to the largest seen
+  uint32_t uBufSize_;
+  std::unique_ptr<uint8_t[]> uBuf_;
+
+  void resizeUntransformBuffer(uint32_t size, uint32_t keep);
+
+  // Compression contexts, created on first use and reset for every message
+  struct Codecs;
+  struct CodecsDeleter {
+    void operator()(Codecs* codecs) const;
+  };
+  std::unique_ptr<Codecs, CodecsDeleter> codecs_;
+
+  Codecs& getCodecs();
+
+  THeaderString readString(uint8_t*& ptr, uint8_t const* headerBoundary);
 
-  void writeString(uint8_t*& ptr, const std::string& str);
+  void writeString(uint8_t*& ptr, const char* str, uint32_t len);
 
   // Varint utils
   /**
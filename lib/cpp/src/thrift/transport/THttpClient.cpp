@@ -113,9 +113,10 @@ void THttpClient::flush() {
 
   if (header.size() > (std::numeric_limits<uint32_t>::max)())
     throw TTransportException("Header too big");
-  // Write the header, then the data, then flush
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
+  // Write the header and the data together, then flush
+  TIOBuffer bufs[] = {{(const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size())},
+                      {buf, len}};
+  transport_->writev(bufs, 2);
   transport_->flush();
 
   // Reset the buffer and header variables
@@ -129,10 +129,11 @@ void THttpServer::flush() {
   // Construct the HTTP header
   string header = getHeader(len);
 
-  // Write the header, then the data, then flush
+  // Write the header and the data together, then flush
   // cast should be fine, because none of "header" is under attacker control
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
+  TIOBuffer bufs[] = {{(const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size())},
+                      {buf, len}};
+  transport_->writev(bufs, 2);
   transport_->flush();
 
   // Reset the buffer and header variables
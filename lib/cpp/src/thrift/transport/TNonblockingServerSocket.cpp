@@ -101,6 +101,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -116,6 +117,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, in
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -132,6 +134,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int po
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -148,6 +151,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -353,6 +357,19 @@ void TNonblockingServerSocket::_setup_tcp_sockopts() {
   }
 #endif
 
+#ifdef SO_REUSEPORT
+  if (reusePort_) {
+    if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT, cast_sockopt(&one), sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      TOutput::instance().perror("TNonblockingServerSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not set SO_REUSEPORT",
+                                errno_copy);
+    }
+  }
+#endif
+
 } // _setup_tcp_sockopts()
 
 void TNonblockingServerSocket::listen() {
@@ -533,6 +550,32 @@ void TNonblockingServerSocket::listen() {
   listening_ = true;
 }
 
+shared_ptr<TNonblockingServerTransport> TNonblockingServerSocket::listenSharedPort() {
+#ifdef SO_REUSEPORT
+  if (!reusePort_ || !listening_ || isUnixDomainSocket()) {
+    return shared_ptr<TNonblockingServerTransport>();
+  }
+
+  // Bind to the port actually in use, which differs from port_ if that is 0
+  shared_ptr<TNonblockingServerSocket> listener = createListener(address_, listenPort_);
+  listener->acceptBacklog_ = acceptBacklog_;
+  listener->sendTimeout_ = sendTimeout_;
+  listener->recvTimeout_ = recvTimeout_;
+  listener->retryLimit_ = retryLimit_;
+  listener->retryDelay_ = retryDelay_;
+  listener->tcpSendBuffer_ = tcpSendBuffer_;
+  listener->tcpRecvBuffer_ = tcpRecvBuffer_;
+  listener->keepAlive_ = keepAlive_;
+  listener->reusePort_ = true;
+  listener->listenCallback_ = listenCallback_;
+  listener->acceptCallback_ = acceptCallback_;
+  listener->listen();
+  return listener;
+#else
+  return shared_ptr<TNonblockingServerTransport>();
+#endif
+}
+
 int TNonblockingServerSocket::getPort() {
   return port_;
 }
@@ -611,6 +654,11 @@ shared_ptr<TSocket> TNonblockingServerSocket::createSocket(THRIFT_SOCKET clientS
   return std::make_shared<TSocket>(clientSocket);
 }
 
+shared_ptr<TNonblockingServerSocket> TNonblockingServerSocket::createListener(const string& address,
+                                                                              int port) {
+  return std::make_shared<TNonblockingServerSocket>(address, port);
+}
+
 void TNonblockingServerSocket::close() {
   if (serverSocket_ != THRIFT_INVALID_SOCKET) {
     shutdown(serverSocket_, THRIFT_SHUT_RDWR);
@@ -85,6 +85,8 @@ public:
 
   void setKeepAlive(bool keepAlive) { keepAlive_ = keepAlive; }
 
+  void setReusePort(bool reusePort) override { reusePort_ = reusePort; }
+
   void setTcpSendBuffer(int tcpSendBuffer);
   void setTcpRecvBuffer(int tcpRecvBuffer);
 
@@ -110,12 +112,20 @@ public:
   bool isUnixDomainSocket() const;
 
   void listen() override;
+  std::shared_ptr<TNonblockingServerTransport> listenSharedPort() override;
   void close() override;
 
 protected:
   std::shared_ptr<TSocket> acceptImpl() override;
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
 
+  /**
+   * Creates the server socket listenSharedPort() opens.  Subclasses that
+   * override createSocket() should override this too.
+   */
+  virtual std::shared_ptr<TNonblockingServerSocket> createListener(const std::string& address,
+                                                                   int port);
+
 private:
   void _setup_sockopts();
   void _setup_unixdomain_sockopts();
@@ -134,6 +144,7 @@ private:
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
   bool keepAlive_;
+  bool reusePort_;
   bool listening_;
 
   socket_func_t listenCallback_;
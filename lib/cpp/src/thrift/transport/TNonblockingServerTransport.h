@@ -45,6 +45,25 @@ public:
    */
   virtual void listen() {}
 
+  /**
+   * Lets other listeners bind to the same port (SO_REUSEPORT).  Must be
+   * called before listen(); transports that cannot share their port ignore
+   * it.
+   */
+  virtual void setReusePort(bool) {}
+
+  /**
+   * Opens another transport, configured like this one, that listens on the
+   * same port.  The kernel spreads incoming connections among all such
+   * listeners, so that each can be served by a thread of its own.  Requires
+   * setReusePort(true) before listen().
+   *
+   * @return the new, listening transport or nullptr if this transport cannot
+   *         share its port
+   * @throws TTransportException if the new listener could not be opened
+   */
+  virtual std::shared_ptr<TNonblockingServerTransport> listenSharedPort() { return nullptr; }
+
   /**
    * Gets a new dynamically allocated transport object and passes it to the
    * caller. Note that it is the explicit duty of the caller to free the
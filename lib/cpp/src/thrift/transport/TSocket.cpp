@@ -48,6 +48,9 @@
 #include <unistd.h>
 #endif
 #include <fcntl.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/transport/TSocket.h>
@@ -67,6 +70,10 @@
 #include <thrift/windows/TWinsockSingleton.h>
 #endif
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define THRIFT_HAVE_ZEROCOPY 1
+#endif
+
 template <class T>
 inline const SOCKOPT_CAST_T* const_cast_sockopt(const T* v) {
   return reinterpret_cast<const SOCKOPT_CAST_T*>(v);
@@ -101,7 +108,12 @@ TSocket::TSocket(const string& host, int port, std::shared_ptr<TConfiguration> c
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopyProbed_(false),
+    zeroCopyEnabled_(false),
+    zeroCopySent_(0),
+    zeroCopyDone_(0) {
 }
 
 TSocket::TSocket(const string& path, std::shared_ptr<TConfiguration> config)
@@ -117,7 +129,12 @@ TSocket::TSocket(const string& path, std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopyProbed_(false),
+    zeroCopyEnabled_(false),
+    zeroCopySent_(0),
+    zeroCopyDone_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 }
 
@@ -133,7 +150,12 @@ TSocket::TSocket(std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopyProbed_(false),
+    zeroCopyEnabled_(false),
+    zeroCopySent_(0),
+    zeroCopyDone_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 }
 
@@ -149,7 +171,12 @@ TSocket::TSocket(THRIFT_SOCKET socket, std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopyProbed_(false),
+    zeroCopyEnabled_(false),
+    zeroCopySent_(0),
+    zeroCopyDone_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 #ifdef SO_NOSIGPIPE
   {
@@ -173,7 +200,12 @@ TSocket::TSocket(THRIFT_SOCKET socket, std::shared_ptr<THRIFT_SOCKET> interruptL
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopyProbed_(false),
+    zeroCopyEnabled_(false),
+    zeroCopySent_(0),
+    zeroCopyDone_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 #ifdef SO_NOSIGPIPE
   {
@@ -510,6 +542,9 @@ void TSocket::close() {
     ::THRIFT_CLOSESOCKET(socket_);
   }
   socket_ = THRIFT_INVALID_SOCKET;
+  zeroCopyProbed_ = false;
+  zeroCopyEnabled_ = false;
+  zeroCopySent_ = zeroCopyDone_ = 0;
 }
 
 void TSocket::setSocketFD(THRIFT_SOCKET socket) {
@@ -517,6 +552,9 @@ void TSocket::setSocketFD(THRIFT_SOCKET socket) {
     close();
   }
   socket_ = socket;
+  zeroCopyProbed_ = false;
+  zeroCopyEnabled_ = false;
+  zeroCopySent_ = zeroCopyDone_ = 0;
 }
 
 uint32_t TSocket::read(uint8_t* buf, uint32_t len) {
@@ -647,7 +685,8 @@ void TSocket::write(const uint8_t* buf, uint32_t len) {
   uint32_t sent = 0;
 
   while (sent < len) {
-    uint32_t b = write_partial(buf + sent, len - sent);
+    // The caller may reuse buf as soon as this returns, so it is copied
+    uint32_t b = send_partial(buf + sent, len - sent, false);
     if (b == 0) {
       // This should only happen if the timeout set with SO_SNDTIMEO expired.
       // Raise an exception.
@@ -658,6 +697,10 @@ void TSocket::write(const uint8_t* buf, uint32_t len) {
 }
 
 uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
+  return send_partial(buf, len, true);
+}
+
+uint32_t TSocket::send_partial(const uint8_t* buf, uint32_t len, bool mayZeroCopy) {
   if (socket_ == THRIFT_INVALID_SOCKET) {
     throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
   }
@@ -671,7 +714,25 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
   flags |= MSG_NOSIGNAL;
 #endif // ifdef MSG_NOSIGNAL
 
+  bool zeroCopy = mayZeroCopy && useZeroCopy(len);
+#ifdef THRIFT_HAVE_ZEROCOPY
+  if (zeroCopy) {
+    flags |= MSG_ZEROCOPY;
+  }
+#endif
+
   int b = static_cast<int>(send(socket_, const_cast_sockopt(buf + sent), len - sent, flags));
+#ifdef THRIFT_HAVE_ZEROCOPY
+  if (zeroCopy && b < 0 && THRIFT_GET_SOCKET_ERROR == ENOBUFS) {
+    // Out of memory to pin the pages: copy this one
+    zeroCopy = false;
+    flags &= ~MSG_ZEROCOPY;
+    b = static_cast<int>(send(socket_, const_cast_sockopt(buf + sent), len - sent, flags));
+  }
+#endif
+  if (zeroCopy && b > 0) {
+    zeroCopySent_++;
+  }
 
   if (b < 0) {
     if (THRIFT_GET_SOCKET_ERROR == THRIFT_EWOULDBLOCK || THRIFT_GET_SOCKET_ERROR == THRIFT_EAGAIN) {
@@ -696,6 +757,133 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return b;
 }
 
+void TSocket::writev(const TIOBuffer* bufs, uint32_t count) {
+#if defined(_WIN32) || !defined(HAVE_SYS_SOCKET_H)
+  TTransport::writev(bufs, count);
+#else
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif // ifdef MSG_NOSIGNAL
+
+  // bufs[next] has been sent up to offset
+  uint32_t next = 0;
+  uint32_t offset = 0;
+  const int maxIov = 64;
+  struct iovec iov[maxIov];
+  while (true) {
+    while (next < count && offset == bufs[next].size) {
+      next++;
+      offset = 0;
+    }
+    if (next == count) {
+      break;
+    }
+
+    int iovCount = 0;
+    for (uint32_t i = next; i < count && iovCount < maxIov; i++) {
+      uint32_t skip = i == next ? offset : 0;
+      if (bufs[i].size > skip) {
+        iov[iovCount].iov_base = const_cast<uint8_t*>(bufs[i].data + skip);
+        iov[iovCount].iov_len = bufs[i].size - skip;
+        iovCount++;
+      }
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovCount;
+
+    ssize_t b = sendmsg(socket_, &msg, flags);
+    if (b < 0) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (errno_copy == THRIFT_EWOULDBLOCK || errno_copy == THRIFT_EAGAIN) {
+        // This should only happen if the timeout set with SO_SNDTIMEO expired.
+        throw TTransportException(TTransportException::TIMED_OUT, "send timeout expired");
+      }
+      TOutput::instance().perror("TSocket::writev() sendmsg() " + getSocketInfo(), errno_copy);
+      if (errno_copy == THRIFT_EPIPE || errno_copy == THRIFT_ECONNRESET
+          || errno_copy == THRIFT_ENOTCONN) {
+        throw TTransportException(TTransportException::NOT_OPEN, "writev() sendmsg()", errno_copy);
+      }
+      throw TTransportException(TTransportException::UNKNOWN, "writev() sendmsg()", errno_copy);
+    }
+    if (b == 0) {
+      throw TTransportException(TTransportException::NOT_OPEN, "Socket sendmsg returned 0.");
+    }
+
+    auto sent = static_cast<size_t>(b);
+    while (sent > 0) {
+      uint32_t left = bufs[next].size - offset;
+      if (sent < left) {
+        offset += static_cast<uint32_t>(sent);
+        break;
+      }
+      sent -= left;
+      next++;
+      offset = 0;
+    }
+  }
+#endif
+}
+
+bool TSocket::useZeroCopy(uint32_t len) {
+#ifdef THRIFT_HAVE_ZEROCOPY
+  if (zeroCopyThreshold_ == 0 || len < zeroCopyThreshold_) {
+    return false;
+  }
+  if (!zeroCopyProbed_) {
+    zeroCopyProbed_ = true;
+    int one = 1;
+    zeroCopyEnabled_ = setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+  }
+  return zeroCopyEnabled_;
+#else
+  (void)len;
+  return false;
+#endif
+}
+
+uint32_t TSocket::reapZeroCopyCompletions() {
+  uint32_t count = 0;
+#ifdef THRIFT_HAVE_ZEROCOPY
+  while (getZeroCopyPending() > 0) {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      break;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVERR)
+          && !(cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      struct sock_extended_err err;
+      memcpy(&err, CMSG_DATA(cm), sizeof(err));
+      if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // The notification covers the sends numbered ee_info to ee_data
+      zeroCopyDone_ += err.ee_data - err.ee_info + 1;
+      if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        // The kernel had to copy anyway, e.g. over loopback, so pinning the
+        // pages only costs time
+        zeroCopyEnabled_ = false;
+      }
+      count++;
+    }
+  }
+#endif
+  return count;
+}
+
 std::string TSocket::getHost() const {
   return host_;
 }
@@ -136,6 +136,12 @@ public:
    */
   virtual uint32_t write_partial(const uint8_t* buf, uint32_t len);
 
+  /**
+   * Writes all the buffers to the underlying socket with as few sendmsg()
+   * calls as possible.  Loops until done or fail.
+   */
+  void writev(const TIOBuffer* bufs, uint32_t count) override;
+
   /**
    * Get the host that the socket is connected to
    *
@@ -228,6 +234,29 @@ public:
    */
   void setKeepAlive(bool keepAlive);
 
+  /**
+   * Sends of at least threshold bytes use MSG_ZEROCOPY where the socket
+   * supports it, so that the kernel sends straight from the caller's pages
+   * instead of copying them.  Only write_partial() does so, after which the
+   * caller must leave the data alone until getZeroCopyPending() is 0;
+   * write() and writev() always copy.  0, the default, disables zero copy.
+   */
+  void setZeroCopyThreshold(uint32_t threshold) { zeroCopyThreshold_ = threshold; }
+
+  uint32_t getZeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+  /**
+   * Number of zero copy sends whose pages the kernel may still be using.
+   */
+  uint32_t getZeroCopyPending() const { return zeroCopySent_ - zeroCopyDone_; }
+
+  /**
+   * Reads the zero copy completions queued on the socket, without blocking.
+   *
+   * @return number of completion notifications read
+   */
+  uint32_t reapZeroCopyCompletions();
+
   /**
    * Get socket information formatted as a string <Host: x Port: x>
    */
@@ -366,9 +395,28 @@ protected:
   /** Whether to use low minimum TCP retransmission timeout */
   static bool useLowMinRto_;
 
+  /** Smallest send that uses MSG_ZEROCOPY, 0 if none does */
+  uint32_t zeroCopyThreshold_;
+
+  /** Whether SO_ZEROCOPY has been set on the socket, or failed to */
+  bool zeroCopyProbed_;
+
+  /** Whether sends may use MSG_ZEROCOPY */
+  bool zeroCopyEnabled_;
+
+  /** Zero copy sends issued and completed, as counted by the kernel */
+  uint32_t zeroCopySent_;
+  uint32_t zeroCopyDone_;
+
 private:
   void unix_open();
   void local_open();
+
+  /** True if a send of len bytes should use MSG_ZEROCOPY */
+  bool useZeroCopy(uint32_t len);
+
+  /** write_partial(), copying the data unless mayZeroCopy */
+  uint32_t send_partial(const uint8_t* buf, uint32_t len, bool mayZeroCopy);
 };
 }
 }
@@ -49,6 +49,14 @@ uint32_t readAll(Transport_& trans, uint8_t* buf, uint32_t len) {
   return have;
 }
 
+/**
+ * One of the buffers handed to TTransport::writev().
+ */
+struct TIOBuffer {
+  const uint8_t* data;
+  uint32_t size;
+};
+
 /**
  * Generic interface for a method of transporting data. A TTransport may be
  * capable of either reading or writing, but not necessarily both.
@@ -166,6 +174,24 @@ public:
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot write.");
   }
 
+  /**
+   * Writes count buffers in order, as if each of them was passed to write().
+   * Transports that can send several buffers with one system call, such as
+   * TSocket, override this so that a header and its payload do not have to
+   * be copied together first.
+   *
+   * @param bufs  The buffers to write out
+   * @param count Number of buffers
+   * @throws TTransportException if an error occurs
+   */
+  virtual void writev(const TIOBuffer* bufs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (bufs[i].size > 0) {
+        write(bufs[i].data, bufs[i].size);
+      }
+    }
+  }
+
   /**
    * Called when write is completed.
    * This can be over-ridden to perform a transport-specific action
@@ -188,6 +214,19 @@ public:
     // default behaviour is to do nothing
   }
 
+  /**
+   * Hint that len more bytes are about to be written, so that buffered
+   * transports can grow their write buffer once instead of while the
+   * message is written.  Typically called with the serializedSize() of
+   * the message.
+   *
+   * @param len  Number of bytes about to be written
+   * @throws TTransportException if the room cannot be made
+   */
+  virtual void reserve(uint32_t /* len */) {
+    // default behaviour is to do nothing
+  }
+
   /**
    * Attempts to return a pointer to \c len bytes, possibly copied into \c buf.
    * Does not consume the bytes read (i.e.: a later read will return the same
@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <vector>
 
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/protocol/TCompactProtocol.h>
@@ -45,3 +46,66 @@ BOOST_AUTO_TEST_CASE(test_little_binary_protocol) {
 BOOST_AUTO_TEST_CASE(test_compact_protocol) {
   testProtocol<TCompactProtocol>("TCompactProtocol");
 }
+
+BOOST_AUTO_TEST_CASE(test_compact_varint_lengths) {
+  // Values are written back to back so that most reads see a full word of
+  // borrowed data, with the last few left to the byte-at-a-time path.
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocolT<TMemoryBuffer> protocol(buffer);
+
+  std::vector<int64_t> values;
+  for (int shift = 0; shift < 64; shift++) {
+    uint64_t bit = 1ULL << shift;
+    values.push_back(static_cast<int64_t>(bit));
+    values.push_back(static_cast<int64_t>(bit - 1));
+    values.push_back(-static_cast<int64_t>(bit));
+  }
+
+  for (int64_t value : values) {
+    uint32_t expected = 1;
+    for (uint64_t zz = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+         zz >= 0x80;
+         zz >>= 7) {
+      expected++;
+    }
+    BOOST_CHECK_EQUAL(protocol.writeI64(value), expected);
+    protocol.writeI32(static_cast<int32_t>(value));
+  }
+
+  for (int64_t value : values) {
+    int64_t i64;
+    int32_t i32;
+    protocol.readI64(i64);
+    BOOST_CHECK_EQUAL(i64, value);
+    protocol.readI32(i32);
+    BOOST_CHECK_EQUAL(i32, static_cast<int32_t>(value));
+  }
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_overlong_varint32) {
+  // An i32 of 1 (zigzag 2) padded out to ten bytes, as a 64-bit encoder
+  // might produce it, followed by a second value to keep the buffer full.
+  uint8_t wire[] = {0x82, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00,
+                    0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(wire, sizeof(wire)));
+  TCompactProtocolT<TMemoryBuffer> protocol(buffer);
+
+  int32_t value;
+  BOOST_CHECK_EQUAL(protocol.readI32(value), 10u);
+  BOOST_CHECK_EQUAL(value, 1);
+  BOOST_CHECK_EQUAL(protocol.readI32(value), 1u);
+  BOOST_CHECK_EQUAL(value, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_skip_overlong_varint) {
+  // list<i32> of 9 elements whose second element never terminates.
+  uint8_t wire[24] = {0x95, 0x02};
+  for (int i = 2; i < 24; i++) {
+    wire[i] = 0x80;
+  }
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(wire, sizeof(wire)));
+  TCompactProtocolT<TMemoryBuffer> protocol(buffer);
+
+  BOOST_CHECK_THROW(protocol.skip(T_LIST), TProtocolException);
+}
@@ -21,6 +21,7 @@
 #define _THRIFT_TEST_GENERICPROTOCOLTEST_TCC_ 1
 
 #include <limits>
+#include <vector>
 
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/transport/TBufferTransports.h>
@@ -126,6 +127,170 @@ void testMessage() {
   }
 }
 
+template <typename TProto, typename Val>
+void testArray(const std::vector<Val>& values,
+               uint32_t (TProtocol::*writeOne)(const Val),
+               uint32_t (TProtocol::*writeArray)(const Val*, const uint32_t),
+               uint32_t (TProtocol::*readArray)(Val*, const uint32_t)) {
+  shared_ptr<TMemoryBuffer> bulk(new TMemoryBuffer());
+  shared_ptr<TMemoryBuffer> single(new TMemoryBuffer());
+  shared_ptr<TProtocol> bulkProtocol(new TProto(bulk));
+  shared_ptr<TProtocol> singleProtocol(new TProto(single));
+
+  uint32_t count = static_cast<uint32_t>(values.size());
+  uint32_t bulkSize = ((*bulkProtocol).*writeArray)(values.data(), count);
+  uint32_t singleSize = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    singleSize += ((*singleProtocol).*writeOne)(values[i]);
+  }
+
+  // The bulk encoding must be identical to writing the values one by one.
+  if (bulkSize != singleSize || bulk->getBufferAsString() != single->getBufferAsString()) {
+    THRIFT_SNPRINTF(errorMessage, ERR_LEN, "Invalid array write (type: %s)",
+                    ClassNames::getName<Val>());
+    throw TException(errorMessage);
+  }
+
+  std::vector<Val> out(values.size());
+  if (((*bulkProtocol).*readArray)(out.data(), count) != bulkSize || out != values) {
+    THRIFT_SNPRINTF(errorMessage, ERR_LEN, "Invalid array read (type: %s)",
+                    ClassNames::getName<Val>());
+    throw TException(errorMessage);
+  }
+}
+
+template <typename TProto>
+void testArrays() {
+  std::vector<int8_t> bytes;
+  std::vector<int16_t> i16s;
+  std::vector<int32_t> i32s;
+  std::vector<int64_t> i64s;
+  std::vector<double> doubles;
+  for (int i = 0; i < 2000; i++) {
+    int64_t value = static_cast<int64_t>(1ULL << (i % 64)) - (i % 3);
+    if (i % 2) {
+      value = -value;
+    }
+    bytes.push_back(static_cast<int8_t>(value));
+    i16s.push_back(static_cast<int16_t>(value));
+    i32s.push_back(static_cast<int32_t>(value));
+    i64s.push_back(value);
+    doubles.push_back(static_cast<double>(value) / 3);
+  }
+
+  testArray<TProto, int8_t>(bytes, &TProtocol::writeByte, &TProtocol::writeByteArray,
+                            &TProtocol::readByteArray);
+  testArray<TProto, int16_t>(i16s, &TProtocol::writeI16, &TProtocol::writeI16Array,
+                             &TProtocol::readI16Array);
+  testArray<TProto, int32_t>(i32s, &TProtocol::writeI32, &TProtocol::writeI32Array,
+                             &TProtocol::readI32Array);
+  testArray<TProto, int64_t>(i64s, &TProtocol::writeI64, &TProtocol::writeI64Array,
+                             &TProtocol::readI64Array);
+  testArray<TProto, double>(doubles, &TProtocol::writeDouble, &TProtocol::writeDoubleArray,
+                            &TProtocol::readDoubleArray);
+  testArray<TProto, int32_t>(std::vector<int32_t>(), &TProtocol::writeI32,
+                             &TProtocol::writeI32Array, &TProtocol::readI32Array);
+}
+
+template <typename TProto>
+uint32_t writeSkipStruct(TProtocol& protocol) {
+  uint32_t wsize = 0;
+  wsize += protocol.writeStructBegin("skipped");
+
+  wsize += protocol.writeFieldBegin("flag", T_BOOL, 1);
+  wsize += protocol.writeBool(true);
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldBegin("number", T_I64, 2);
+  wsize += protocol.writeI64(-1234567890123LL);
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldBegin("text", T_STRING, 3);
+  wsize += protocol.writeString(std::string(3000, 'x'));
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldBegin("numbers", T_LIST, 4);
+  wsize += protocol.writeListBegin(T_I64, 1000);
+  for (int64_t i = 0; i < 1000; i++) {
+    wsize += protocol.writeI64(i * i * i * (i % 2 ? -1 : 1));
+  }
+  wsize += protocol.writeListEnd();
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldBegin("weights", T_MAP, 5);
+  wsize += protocol.writeMapBegin(T_I32, T_DOUBLE, 100);
+  for (int32_t i = 0; i < 100; i++) {
+    wsize += protocol.writeI32(i);
+    wsize += protocol.writeDouble(i / 7.0);
+  }
+  wsize += protocol.writeMapEnd();
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldBegin("groups", T_MAP, 6);
+  wsize += protocol.writeMapBegin(T_STRING, T_SET, 2);
+  for (int32_t i = 0; i < 2; i++) {
+    wsize += protocol.writeString(i ? "odd" : "even");
+    wsize += protocol.writeSetBegin(T_BOOL, 3);
+    for (int32_t j = 0; j < 3; j++) {
+      wsize += protocol.writeBool(j == i);
+    }
+    wsize += protocol.writeSetEnd();
+  }
+  wsize += protocol.writeMapEnd();
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldBegin("nested", T_STRUCT, 7);
+  wsize += protocol.writeStructBegin("nested");
+  wsize += protocol.writeFieldBegin("id", T_UUID, 1);
+  wsize += protocol.writeUUID(TUuid("5e2ab188-1726-4e75-a04f-1ed9a6a89c4c"));
+  wsize += protocol.writeFieldEnd();
+  wsize += protocol.writeFieldBegin("pairs", T_MAP, 2);
+  wsize += protocol.writeMapBegin(T_I16, T_I32, 50);
+  for (int16_t i = 0; i < 50; i++) {
+    wsize += protocol.writeI16(i);
+    wsize += protocol.writeI32(-i * 100000);
+  }
+  wsize += protocol.writeMapEnd();
+  wsize += protocol.writeFieldEnd();
+  wsize += protocol.writeFieldStop();
+  wsize += protocol.writeStructEnd();
+  wsize += protocol.writeFieldEnd();
+
+  wsize += protocol.writeFieldStop();
+  wsize += protocol.writeStructEnd();
+  return wsize;
+}
+
+template <typename TProto>
+void testSkip() {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TProto writer(buffer);
+  uint32_t structSize = writeSkipStruct<TProto>(writer);
+  writer.writeI32(0x5a5a5a5a);
+  std::string wire = buffer->getBufferAsString();
+
+  // Once with the data fully buffered, once through a small read buffer
+  // that cannot lend the larger fields.
+  for (int buffered = 0; buffered < 2; buffered++) {
+    shared_ptr<TTransport> transport(new TMemoryBuffer(
+        reinterpret_cast<uint8_t*>(const_cast<char*>(wire.data())),
+        static_cast<uint32_t>(wire.size())));
+    if (buffered) {
+      transport.reset(new TBufferedTransport(transport, 64));
+    }
+    TProto reader(transport);
+
+    int32_t marker = 0;
+    if (reader.skip(T_STRUCT) != structSize) {
+      throw TException("skip returned the wrong size.");
+    }
+    reader.readI32(marker);
+    if (marker != 0x5a5a5a5a) {
+      throw TException("skip did not land on the next value.");
+    }
+  }
+}
+
 template <typename TProto>
 void testProtocol(const char* protoname) {
   try {
@@ -219,6 +384,10 @@ void testProtocol(const char* protoname) {
 
     testMessage<TProto>();
 
+    testArrays<TProto>();
+
+    testSkip<TProto>();
+
     printf("%s => OK\n", protoname);
   } catch (const TException &e) {
     THRIFT_SNPRINTF(errorMessage, ERR_LEN, "%s => Test FAILED: %s", protoname, e.what());
@@ -17,11 +17,14 @@
  * under the License.
  */
 
+#include <cstring>
 #include <boost/test/unit_test.hpp>
 #include <thrift/protocol/TBase64Utils.h>
 
 using apache::thrift::protocol::base64_encode;
 using apache::thrift::protocol::base64_decode;
+using apache::thrift::protocol::base64_encode_block;
+using apache::thrift::protocol::base64_decode_block;
 
 BOOST_AUTO_TEST_SUITE(Base64Test)
 
@@ -71,4 +74,43 @@ BOOST_AUTO_TEST_CASE(test_Base64_Encode_Decode) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_Base64_Block_Encode_Decode) {
+  // Cover the vector loops and every tail length after them
+  uint8_t testInput[300];
+  uint8_t expected[400];
+  uint8_t testOutput[400];
+  for (int i = 0; i < 300; i++) {
+    testInput[i] = (uint8_t)(i * 37 + (i >> 3));
+  }
+
+  for (uint32_t len = 0; len <= 300; len++) {
+    uint32_t expectedLen = 0;
+    for (uint32_t pos = 0; pos < len; pos += 3) {
+      uint32_t n = len - pos < 3 ? len - pos : 3;
+      base64_encode(testInput + pos, n, expected + expectedLen);
+      expectedLen += n + 1;
+    }
+
+    uint32_t encodedLen = base64_encode_block(testInput, len, testOutput);
+    BOOST_CHECK_EQUAL(encodedLen, expectedLen);
+    BOOST_CHECK(0 == memcmp(testOutput, expected, encodedLen));
+
+    BOOST_CHECK_EQUAL(base64_decode_block(testOutput, encodedLen), len);
+    BOOST_CHECK(0 == memcmp(testInput, testOutput, len));
+  }
+
+  // Characters outside the alphabet fall back to the table lookup
+  uint8_t mixed[64];
+  uint8_t reference[64];
+  memset(mixed, 'Q', sizeof(mixed));
+  mixed[40] = '!';
+  memcpy(reference, mixed, sizeof(mixed));
+  for (uint32_t pos = 0; pos < 64; pos += 4) {
+    base64_decode(reference + pos, 4);
+    memmove(reference + pos / 4 * 3, reference + pos, 3);
+  }
+  BOOST_CHECK_EQUAL(base64_decode_block(mixed, 64), 48u);
+  BOOST_CHECK(0 == memcmp(mixed, reference, 48));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
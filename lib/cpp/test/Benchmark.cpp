@@ -25,6 +25,8 @@
 #include <math.h>
 #include <memory>
 #include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/protocol/TJSONProtocol.h"
 #include "thrift/transport/TBufferTransports.h"
 #include "gen-cpp/DebugProtoTest_types.h"
 
@@ -156,6 +158,64 @@ int main() {
     cout << " Read big endian: " << num / (1000 * elapsed) << " kHz" << '\n';
   }
 
+  {
+    buf->resetBuffer();
+    TCompactProtocolT<TMemoryBuffer> prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      ooe.write(&prot);
+    }
+    elapsed = timer.frame();
+    cout << "Write compact: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TCompactProtocolT<TMemoryBuffer> prot(buf2);
+    OneOfEach ooe2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      ooe2.read(&prot);
+    }
+    elapsed = timer.frame();
+    cout << " Read compact: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->resetBuffer();
+    TJSONProtocol prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      ooe.write(&prot);
+    }
+    elapsed = timer.frame();
+    cout << "Write JSON: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TJSONProtocol prot(buf2);
+    OneOfEach ooe2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      ooe2.read(&prot);
+    }
+    elapsed = timer.frame();
+    cout << " Read JSON: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
 
   data = nullptr;
   datasize = 0;
@@ -239,6 +299,103 @@ int main() {
     cout << " Double read big endian: " << num / (1000 * elapsed) << " kHz" << '\n';
   }
 
+  data = nullptr;
+  datasize = 0;
+  num = 1000000;
+
+  ListStringPerf listStringPerf;
+  listStringPerf.field.reserve(num);
+  for (int x = 0; x < num; ++x)
+    listStringPerf.field.push_back(std::string(64, static_cast<char>('a' + x % 26)));
+
+  buf.reset(new TMemoryBuffer(num * 100));
+
+  {
+    buf->resetBuffer();
+    TCompactProtocolT<TMemoryBuffer> prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    listStringPerf.write(&prot);
+    elapsed = timer.frame();
+    cout << "String write compact: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TCompactProtocolT<TMemoryBuffer> prot(buf2);
+    ListStringPerf listStringPerf2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    listStringPerf2.read(&prot);
+    elapsed = timer.frame();
+    cout << " String read compact: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->resetBuffer();
+    TJSONProtocol prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    listStringPerf.write(&prot);
+    elapsed = timer.frame();
+    cout << "String write JSON: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TJSONProtocol prot(buf2);
+    ListStringPerf listStringPerf2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    listStringPerf2.read(&prot);
+    elapsed = timer.frame();
+    cout << " String read JSON: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  num = 50;
+  OneOfEach binaryOoe;
+  binaryOoe.base64.resize(4 * 1024 * 1024);
+  for (size_t i = 0; i < binaryOoe.base64.size(); i++) {
+    binaryOoe.base64[i] = static_cast<char>(i * 7 + (i >> 8));
+  }
+  double binaryMB = num * (binaryOoe.base64.size() / (1024.0 * 1024.0));
+
+  {
+    buf->resetBuffer();
+    TJSONProtocol prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      binaryOoe.write(&prot);
+    }
+    elapsed = timer.frame();
+    cout << "Binary write JSON: " << binaryMB / elapsed << " MB/s" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TJSONProtocol prot(buf2);
+    OneOfEach binaryOoe2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      binaryOoe2.read(&prot);
+    }
+    elapsed = timer.frame();
+    cout << " Binary read JSON: " << binaryMB / elapsed << " MB/s" << '\n';
+  }
 
   return 0;
 }
@@ -0,0 +1,157 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/TContainers.h>
+#include <thrift/TToString.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/ContainersTest_types.h"
+
+// Struct keys need an ordering, which the generator only declares
+bool containers_test::Point::operator<(const Point& other) const {
+  return x < other.x || (x == other.x && y < other.y);
+}
+
+BOOST_AUTO_TEST_SUITE(ContainersTest)
+
+using apache::thrift::TFlatMap;
+using apache::thrift::TFlatSet;
+using apache::thrift::THash;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::T_I32;
+using apache::thrift::protocol::T_MAP;
+using apache::thrift::protocol::T_STRING;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace containers_test;
+
+BOOST_AUTO_TEST_CASE(test_flat_map) {
+  TFlatMap<std::string, int> map;
+  map["c"] = 3;
+  map["a"] = 1;
+  BOOST_CHECK(map.insert(std::make_pair(std::string("b"), 2)).second);
+  BOOST_CHECK(!map.insert(std::make_pair(std::string("b"), 5)).second);
+  BOOST_CHECK_EQUAL(map.size(), 3u);
+  BOOST_CHECK_EQUAL(map.begin()->first, "a");
+  BOOST_CHECK_EQUAL(map.at("b"), 2);
+  BOOST_CHECK(map.find("d") == map.end());
+  BOOST_CHECK_THROW(map.at("d"), std::out_of_range);
+  BOOST_CHECK_EQUAL(map.erase("a"), 1u);
+  BOOST_CHECK_EQUAL(map.count("a"), 0u);
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(map), "{b: 2, c: 3}");
+
+  // Bulk loading keeps the last value of a key, sorted or not
+  map.clear();
+  map.appendUnsorted("z") = 1;
+  map.appendUnsorted("x") = 2;
+  map.appendUnsorted("z") = 3;
+  map.appendUnsorted("y") = 4;
+  map.sortAppended();
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(map), "{x: 2, y: 4, z: 3}");
+  map.appendUnsorted("z") = 5;
+  map.sortAppended();
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(map), "{x: 2, y: 4, z: 5}");
+}
+
+BOOST_AUTO_TEST_CASE(test_flat_set) {
+  TFlatSet<int> set;
+  for (int i = 10; i > 0; i--) {
+    set.appendUnsorted(i % 4);
+  }
+  set.sortAppended();
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(set), "{0, 1, 2, 3}");
+  BOOST_CHECK(!set.insert(2).second);
+  BOOST_CHECK(set.insert(7).second);
+  BOOST_CHECK_EQUAL(set.count(7), 1u);
+  BOOST_CHECK_EQUAL(set.erase(0), 1u);
+  BOOST_CHECK_EQUAL(*set.begin(), 1);
+  BOOST_CHECK(set == TFlatSet<int>(set));
+}
+
+BOOST_AUTO_TEST_CASE(test_hash) {
+  BOOST_CHECK_EQUAL(THash<Color::type>()(Color::GREEN), std::hash<int>()(2));
+  BOOST_CHECK_EQUAL(THash<std::string>()("a"), std::hash<std::string>()("a"));
+}
+
+static Containers makeContainers() {
+  Containers c;
+  for (int i = 0; i < 50; i++) {
+    c.flatMap["key" + std::to_string(i)] = i;
+    c.flatSet.insert(1000 - i);
+    c.ordered[i] = "v";
+  }
+  c.byColor[Color::RED] = "red";
+  c.byColor[Color::BLUE] = "blue";
+  c.names.insert("one");
+  c.names.insert("two");
+  c.nested.resize(2);
+  c.nested[1][3]["hits"] = 7;
+  c.__isset.nested = true;
+  return c;
+}
+
+template <class Protocol_>
+static void testRoundTrip() {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ protocol(buffer);
+  Containers sent = makeContainers();
+  sent.write(&protocol);
+
+  Containers received;
+  received.read(&protocol);
+  BOOST_CHECK(received == sent);
+  BOOST_CHECK_EQUAL(received.flatMap.size(), 52u);
+  BOOST_CHECK_EQUAL(received.nested[1].at(3).at("hits"), 7);
+  BOOST_CHECK_EQUAL(received.byColor.at(Color::BLUE), "blue");
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_round_trip) {
+  testRoundTrip<TBinaryProtocol>();
+  testRoundTrip<TCompactProtocol>();
+
+  Containers defaults;
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(defaults.flatMap), "{a: 1, b: 2}");
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_unsorted_input) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  protocol.writeStructBegin("Containers");
+  protocol.writeFieldBegin("flatMap", T_MAP, 1);
+  protocol.writeMapBegin(T_STRING, T_I32, 4);
+  const char* keys[] = {"d", "b", "d", "a"};
+  for (int i = 0; i < 4; i++) {
+    protocol.writeString(std::string(keys[i]));
+    protocol.writeI32(i);
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+
+  Containers received;
+  received.read(&protocol);
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(received.flatMap), "{a: 3, b: 1, d: 2}");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
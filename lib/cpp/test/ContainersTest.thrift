@@ -0,0 +1,48 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp containers_test
+
+// Generated with cpp:containers=flat, to test ContainersTest.cpp
+enum Color
+{
+  RED = 1,
+  GREEN = 2,
+  BLUE = 3,
+}
+
+struct Point
+{
+  1: i32 x,
+  2: i32 y,
+}
+
+typedef map<string, i64> Counters
+
+struct Containers
+{
+  1: map<string, i32> flatMap = {"b": 2, "a": 1},
+  2: set<i64> flatSet,
+  3: map<Color, string> (cpp.containers = "unordered") byColor,
+  4: set<string> (cpp.containers = "unordered") names,
+  5: map<i32, string> (cpp.containers = "ordered") ordered,
+  6: list<map<i16, Counters>> nested,
+  // Not hashable, so it stays a std::map
+  7: map<Point, i32> (cpp.containers = "unordered") byPoint,
+}
@@ -0,0 +1,117 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/FieldMaskTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(FieldMaskTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TFieldMask;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace field_mask_test;
+
+static Record makeRecord() {
+  Record record;
+  record.__set_id(1234567890123LL);
+  record.__set_key("record-key");
+  record.tags.push_back("a");
+  record.tags.push_back("b");
+  record.__isset.tags = true;
+  record.inner.__set_value(42);
+  record.inner.__set_name("inner");
+  record.__isset.inner = true;
+  record.counters["hits"] = 3;
+  record.__isset.counters = true;
+  record.__set_score(0.5);
+  return record;
+}
+
+template <class Protocol_>
+static void testProjection() {
+  Record record = makeRecord();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ protocol(buffer);
+  record.write(&protocol);
+  record.write(&protocol);
+
+  // The required key is outside the mask, so its absence is not an error.
+  Record projected;
+  uint32_t size = projected.read(&protocol, TFieldMask{1, 4});
+  BOOST_CHECK_EQUAL(projected.id, record.id);
+  BOOST_CHECK(projected.inner == record.inner);
+  BOOST_CHECK(projected.__isset.id);
+  BOOST_CHECK(projected.__isset.inner);
+  BOOST_CHECK(!projected.__isset.tags);
+  BOOST_CHECK(!projected.__isset.counters);
+  BOOST_CHECK(!projected.__isset.score);
+  BOOST_CHECK(projected.key.empty());
+  BOOST_CHECK(projected.tags.empty());
+  BOOST_CHECK(projected.counters.empty());
+
+  // Skipped fields are fully consumed: the next record reads normally.
+  Record full;
+  BOOST_CHECK_EQUAL(full.read(&protocol), size);
+  BOOST_CHECK(full == record);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_projection) {
+  testProjection<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_projection) {
+  testProjection<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_required_field_in_mask) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  for (int i = 0; i < 2; i++) {
+    protocol.writeStructBegin("Record");
+    protocol.writeFieldStop();
+    protocol.writeStructEnd();
+  }
+
+  Record record;
+  record.read(&protocol, TFieldMask{1});
+  BOOST_CHECK_THROW(record.read(&protocol, TFieldMask{1, 2}),
+                    apache::thrift::protocol::TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(test_mask_contains) {
+  TFieldMask mask{1, 64, 200, -1, -70};
+  BOOST_CHECK(mask.contains(1));
+  BOOST_CHECK(mask.contains(64));
+  BOOST_CHECK(mask.contains(200));
+  BOOST_CHECK(mask.contains(-1));
+  BOOST_CHECK(mask.contains(-70));
+  BOOST_CHECK(!mask.contains(0));
+  BOOST_CHECK(!mask.contains(2));
+  BOOST_CHECK(!mask.contains(-2));
+  BOOST_CHECK(!mask.contains(32767));
+  BOOST_CHECK(!mask.contains(-32768));
+  BOOST_CHECK(mask.add(-32768).contains(-32768));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -20,6 +20,7 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <thrift/protocol/TJSONProtocol.h>
 #include <memory>
@@ -402,3 +403,56 @@ BOOST_AUTO_TEST_CASE(test_json_base64_padding_validation) {
   test_base64_padding("===");
   test_base64_padding("====");
 }
+
+BOOST_AUTO_TEST_CASE(test_json_number_limits) {
+  OneOfEach ooe;
+  ooe.a_bite = -128;
+  ooe.integer16 = -32768;
+  ooe.integer32 = -2147483647 - 1;
+  ooe.integer64 = (std::numeric_limits<int64_t>::min)();
+  ooe.double_precision = -5e-324;
+  ooe.some_characters = std::string(300, 'x') + "\\\"\x1f" + std::string(300, 'y');
+  const std::string json(apache::thrift::ThriftJSONString(ooe));
+
+  // Read back both from a buffer that lends its bytes and one byte at a time
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(
+    (uint8_t*)(json.c_str()), static_cast<uint32_t>(json.size())));
+  std::shared_ptr<apache::thrift::transport::TTransport> buffered(
+    new apache::thrift::transport::TBufferedTransport(
+      std::shared_ptr<TMemoryBuffer>(new TMemoryBuffer(
+        (uint8_t*)(json.c_str()), static_cast<uint32_t>(json.size()))), 1));
+  OneOfEach ooe2;
+  ooe2.read(std::shared_ptr<TJSONProtocol>(new TJSONProtocol(buffer)).get());
+  BOOST_CHECK(ooe == ooe2);
+  OneOfEach ooe3;
+  ooe3.read(std::shared_ptr<TJSONProtocol>(new TJSONProtocol(buffered)).get());
+  BOOST_CHECK(ooe == ooe3);
+
+  ooe.integer64 = (std::numeric_limits<int64_t>::max)();
+  ooe.double_precision = 1.7976931348623157e308;
+  BOOST_CHECK(apache::thrift::ThriftJSONString(ooe).find(
+    "{\"i64\":9223372036854775807},\"7\":{\"dbl\":1.7976931348623157e+308}")
+    != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_invalid_numbers) {
+  auto test_invalid_number = [](const std::string& field) {
+    std::string json_string = "{" + field + "}";
+    std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(
+      (uint8_t*)(json_string.c_str()), static_cast<uint32_t>(json_string.size())));
+    std::shared_ptr<TJSONProtocol> proto(new TJSONProtocol(buffer));
+
+    OneOfEach ooe;
+    BOOST_CHECK_THROW(ooe.read(proto.get()),
+      apache::thrift::protocol::TProtocolException);
+  };
+
+  test_invalid_number("\"4\":{\"i16\":32768}");
+  test_invalid_number("\"5\":{\"i32\":-2147483649}");
+  test_invalid_number("\"6\":{\"i64\":9223372036854775808}");
+  test_invalid_number("\"6\":{\"i64\":1-2}");
+  test_invalid_number("\"6\":{\"i64\":}");
+  test_invalid_number("\"1\":{\"tf\":2}");
+  test_invalid_number("\"7\":{\"dbl\":1.5.2}");
+  test_invalid_number("\"7\":{\"dbl\":-}");
+}
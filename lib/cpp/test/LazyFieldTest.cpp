@@ -0,0 +1,154 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(LazyFieldTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using namespace thrift::test::debug;
+
+static Nesting makeNesting() {
+  Nesting nesting;
+  nesting.my_bonk.type = 31337;
+  nesting.my_bonk.message = "I am a bonk... xor!";
+  nesting.my_ooe.im_true = true;
+  nesting.my_ooe.integer16 = 27000;
+  nesting.my_ooe.integer32 = 1 << 24;
+  nesting.my_ooe.integer64 = 6000000000LL;
+  nesting.my_ooe.double_precision = 3.25;
+  nesting.my_ooe.some_characters = "Debug THIS!";
+  nesting.my_ooe.byte_list.push_back(3);
+  nesting.my_ooe.i16_list.push_back(-7);
+  return nesting;
+}
+
+template <class Protocol_>
+static std::string serialize(const Nesting& nesting) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ protocol(buffer);
+  nesting.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+static std::shared_ptr<TMemoryBuffer> bufferOf(const std::string& encoded) {
+  return std::make_shared<TMemoryBuffer>(reinterpret_cast<uint8_t*>(const_cast<char*>(encoded.data())),
+                                         static_cast<uint32_t>(encoded.size()),
+                                         TMemoryBuffer::COPY);
+}
+
+template <class Protocol_>
+static void testPassThrough() {
+  Nesting nesting = makeNesting();
+  std::string encoded = serialize<Protocol_>(nesting);
+
+  std::shared_ptr<TMemoryBuffer> in = bufferOf(encoded);
+  Protocol_ inProtocol(in);
+  LazyNesting lazy;
+  lazy.read(&inProtocol);
+  BOOST_CHECK(lazy.my_ooe.isEncoded());
+  BOOST_CHECK_EQUAL(lazy.my_bonk.message, nesting.my_bonk.message);
+
+  // Written back untouched, the field is copied verbatim.
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  Protocol_ outProtocol(out);
+  lazy.write(&outProtocol);
+  BOOST_CHECK(lazy.my_ooe.isEncoded());
+  BOOST_CHECK(out->getBufferAsString() == encoded);
+
+  BOOST_CHECK(lazy.my_ooe.get() == nesting.my_ooe);
+  BOOST_CHECK(!lazy.my_ooe.isEncoded());
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_pass_through) {
+  testPassThrough<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_pass_through) {
+  testPassThrough<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_protocol_change_decodes) {
+  Nesting nesting = makeNesting();
+  std::shared_ptr<TMemoryBuffer> in = bufferOf(serialize<TCompactProtocol>(nesting));
+  TCompactProtocol inProtocol(in);
+  LazyNesting lazy;
+  lazy.read(&inProtocol);
+  BOOST_CHECK(lazy.my_ooe.isEncoded());
+
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  TBinaryProtocol outProtocol(out);
+  lazy.write(&outProtocol);
+  BOOST_CHECK(out->getBufferAsString() == serialize<TBinaryProtocol>(nesting));
+}
+
+BOOST_AUTO_TEST_CASE(test_modified_field_is_reencoded) {
+  Nesting nesting = makeNesting();
+  std::shared_ptr<TMemoryBuffer> in = bufferOf(serialize<TBinaryProtocol>(nesting));
+  TBinaryProtocol inProtocol(in);
+  LazyNesting lazy;
+  lazy.read(&inProtocol);
+
+  lazy.my_ooe.getMutable().integer32 = 42;
+  nesting.my_ooe.integer32 = 42;
+
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  TBinaryProtocol outProtocol(out);
+  lazy.write(&outProtocol);
+  BOOST_CHECK(out->getBufferAsString() == serialize<TBinaryProtocol>(nesting));
+
+  lazy.__set_my_ooe(OneOfEach());
+  BOOST_CHECK(!lazy.my_ooe.isEncoded());
+  BOOST_CHECK_EQUAL(lazy.my_ooe.get().integer32, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_eager_fallback) {
+  Nesting nesting = makeNesting();
+
+  // TJSONProtocol cannot pass values through.
+  std::shared_ptr<TMemoryBuffer> json = bufferOf(serialize<TJSONProtocol>(nesting));
+  TJSONProtocol jsonProtocol(json);
+  LazyNesting lazy;
+  lazy.read(&jsonProtocol);
+  BOOST_CHECK(!lazy.my_ooe.isEncoded());
+  BOOST_CHECK(lazy.my_ooe.get() == nesting.my_ooe);
+
+  // Nor can a transport that does not hold the whole value in its buffer.
+  std::shared_ptr<TTransport> buffered(
+      new TBufferedTransport(bufferOf(serialize<TBinaryProtocol>(nesting)), 16));
+  TBinaryProtocol binaryProtocol(buffered);
+  LazyNesting lazy2;
+  lazy2.read(&binaryProtocol);
+  BOOST_CHECK(!lazy2.my_ooe.isEncoded());
+  BOOST_CHECK(lazy2.my_ooe.get() == nesting.my_ooe);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE PmrTest
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/PmrService.h"
+
+BOOST_AUTO_TEST_SUITE(PmrTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace pmr_test;
+
+// Counts what is allocated from it, and hands out the default resource's memory
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t allocations = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    return std::pmr::get_default_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    std::pmr::get_default_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// Longer than any small string buffer, so that it has to be allocated
+static const std::pmr::string longText(100, 'x');
+
+static Outer makeOuter() {
+  Outer outer;
+  outer.__set_title("title " + longText);
+  std::pmr::string payload("\0\1\2binary\xff", 10);
+  outer.__set_payload(payload + longText);
+  outer.tags.emplace_back("tag " + longText);
+  outer.tags.emplace_back("");
+  outer.__isset.tags = true;
+  Inner inner;
+  inner.__set_name("inner " + longText);
+  inner.values.push_back(7);
+  outer.inners.emplace("key " + longText, inner);
+  outer.__isset.inners = true;
+  outer.labels.insert("label " + longText);
+  outer.__isset.labels = true;
+  outer.__set_inner(inner);
+  return outer;
+}
+
+template <class Protocol_>
+static void testRoundTrip() {
+  const Outer sent = makeOuter();
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ protocol(buffer);
+  uint32_t written = sent.write(&protocol);
+  BOOST_CHECK_EQUAL(written, buffer->available_read());
+
+  CountingResource resource;
+  Outer received(&resource);
+  BOOST_CHECK_EQUAL(received.read(&protocol), written);
+  BOOST_CHECK(received == sent);
+  BOOST_CHECK(!received.__isset.comment);
+
+  // Every string read, down to the container elements and nested structs,
+  // takes its memory from the struct's resource
+  BOOST_CHECK(received.title.get_allocator().resource() == &resource);
+  BOOST_CHECK(received.tags[0].get_allocator().resource() == &resource);
+  BOOST_CHECK(received.inners.begin()->first.get_allocator().resource() == &resource);
+  BOOST_CHECK(received.inners.begin()->second.name.get_allocator().resource() == &resource);
+  BOOST_CHECK(received.labels.begin()->get_allocator().resource() == &resource);
+  BOOST_CHECK(received.inner.name.get_allocator().resource() == &resource);
+  BOOST_CHECK_GE(resource.allocations, 7u);
+}
+
+BOOST_AUTO_TEST_CASE(test_struct_round_trip) {
+  testRoundTrip<TBinaryProtocol>();
+  testRoundTrip<TCompactProtocol>();
+  // Reads a std::string first and copies it
+  testRoundTrip<TJSONProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_read_without_borrow) {
+  // A transport that cannot lend the string makes the protocol read straight
+  // into the resized pmr string
+  const Outer sent = makeOuter();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol writer(buffer);
+  sent.write(&writer);
+
+  std::shared_ptr<apache::thrift::transport::TBufferedTransport> buffered(
+      new apache::thrift::transport::TBufferedTransport(buffer, 16));
+  TBinaryProtocol reader(buffered);
+  CountingResource resource;
+  Outer received(&resource);
+  received.read(&reader);
+  BOOST_CHECK(received == sent);
+  BOOST_CHECK(received.payload.get_allocator().resource() == &resource);
+}
+
+class EchoHandler : public PmrServiceIf {
+public:
+  bool argumentsInArena = false;
+
+  void echo(Outer& _return, const Outer& value) override {
+    // The processor reads each call into an arena of its own
+    argumentsInArena
+        = value.title.get_allocator().resource() != std::pmr::get_default_resource()
+          && value.tags[0].get_allocator().resource() == value.title.get_allocator().resource();
+    _return = value;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(test_service_round_trip) {
+  std::shared_ptr<TMemoryBuffer> requests(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> replies(new TMemoryBuffer());
+  std::shared_ptr<TBinaryProtocol> requestProtocol(new TBinaryProtocol(requests));
+  std::shared_ptr<TBinaryProtocol> replyProtocol(new TBinaryProtocol(replies));
+
+  std::shared_ptr<EchoHandler> handler(new EchoHandler());
+  PmrServiceProcessor processor(handler);
+  PmrServiceClient client(replyProtocol, requestProtocol);
+
+  const Outer sent = makeOuter();
+  client.send_echo(sent);
+  BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+  BOOST_CHECK(handler->argumentsInArena);
+
+  Outer received;
+  client.recv_echo(received);
+  BOOST_CHECK(received == sent);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
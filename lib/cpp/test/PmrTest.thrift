@@ -0,0 +1,41 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp pmr_test
+
+// Generated with cpp:pmr by PmrTest.cpp
+
+struct Inner {
+  1: string name
+  2: list<i32> values
+}
+
+struct Outer {
+  1: string title
+  2: binary payload
+  3: optional string comment
+  4: list<string> tags
+  5: map<string, Inner> inners
+  6: set<string> labels
+  7: Inner inner
+}
+
+service PmrService {
+  Outer echo(1: Outer value)
+}
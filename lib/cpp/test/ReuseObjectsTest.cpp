@@ -0,0 +1,201 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/ReuseService.h"
+
+BOOST_AUTO_TEST_SUITE(ReuseObjectsTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace reuse_objects_test;
+
+namespace {
+
+class RecordingHandler : public ReuseServiceIf {
+public:
+  int32_t total(const Batch& batch) override {
+    seen.push_back(batch);
+    address = &batch;
+    if (nested) {
+      std::function<void()> call;
+      call.swap(nested);
+      call();
+    }
+    if (batch.__isset.tag && batch.tag == "reject") {
+      Rejected rejected;
+      rejected.reason = "rejected";
+      throw rejected;
+    }
+    return static_cast<int32_t>(batch.items.size());
+  }
+
+  void names(std::vector<std::string>& _return, const Batch& batch) override {
+    for (const Item& item : batch.items) {
+      _return.push_back(item.name);
+    }
+  }
+
+  std::vector<Batch> seen;
+  const Batch* address = nullptr;
+  std::function<void()> nested;
+};
+
+struct Fixture {
+  Fixture()
+    : handler(new RecordingHandler()),
+      processor(handler),
+      in(new TMemoryBuffer()),
+      out(new TMemoryBuffer()),
+      inProto(new TBinaryProtocol(in)),
+      outProto(new TBinaryProtocol(out)),
+      client(outProto, inProto) {}
+
+  void process() { BOOST_CHECK(processor.process(inProto, outProto, nullptr)); }
+
+  std::shared_ptr<RecordingHandler> handler;
+  ReuseServiceProcessor processor;
+  std::shared_ptr<TMemoryBuffer> in;
+  std::shared_ptr<TMemoryBuffer> out;
+  std::shared_ptr<TProtocol> inProto;
+  std::shared_ptr<TProtocol> outProto;
+  ReuseServiceClient client;
+};
+
+Batch makeBatch(int items) {
+  Batch batch;
+  for (int i = 0; i < items; i++) {
+    Item item;
+    item.id = i;
+    item.name = "item" + std::to_string(i);
+    item.__set_values(std::vector<int64_t>(3, i));
+    batch.items.push_back(item);
+  }
+  batch.__set_tag("full");
+  batch.counts["b"] = 2;
+  return batch;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_clear) {
+  Batch batch = makeBatch(10);
+  batch.first.name = "changed";
+  const Item* items = batch.items.data();
+
+  batch.__clear();
+  BOOST_CHECK(batch == Batch());
+  BOOST_CHECK(batch.items.empty());
+  BOOST_CHECK_EQUAL(batch.items.data(), items);
+  BOOST_CHECK_EQUAL(batch.first.id, 7);
+  BOOST_CHECK_EQUAL(batch.first.name, "unnamed");
+  BOOST_CHECK(!batch.__isset.tag);
+  BOOST_CHECK(batch.__isset.first);
+  BOOST_CHECK_EQUAL(batch.counts.size(), 1u);
+  BOOST_CHECK_EQUAL(batch.counts["a"], 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_processor_reuses_args, Fixture) {
+  client.send_total(makeBatch(3));
+  process();
+  BOOST_CHECK_EQUAL(client.recv_total(), 3);
+
+  // Nothing of the first call leaks into the second one
+  Batch empty;
+  client.send_total(empty);
+  process();
+  BOOST_CHECK_EQUAL(client.recv_total(), 0);
+
+  BOOST_REQUIRE_EQUAL(handler->seen.size(), 2u);
+  BOOST_CHECK_EQUAL(handler->seen[0].items.size(), 3u);
+  BOOST_CHECK(handler->seen[0].items[2].__isset.values);
+  BOOST_CHECK(handler->seen[1] == empty);
+  BOOST_CHECK(!handler->seen[1].__isset.tag);
+  const Batch* first = handler->address;
+
+  client.send_total(makeBatch(1));
+  process();
+  BOOST_CHECK_EQUAL(client.recv_total(), 1);
+  BOOST_CHECK_EQUAL(handler->address, first);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_processor_reuses_result, Fixture) {
+  Batch reject;
+  reject.__set_tag("reject");
+  client.send_total(reject);
+  process();
+  BOOST_CHECK_THROW(client.recv_total(), Rejected);
+
+  // The exception is not sent again with the next result
+  client.send_total(makeBatch(2));
+  process();
+  BOOST_CHECK_EQUAL(client.recv_total(), 2);
+
+  std::vector<std::string> names;
+  client.send_names(makeBatch(4));
+  process();
+  client.recv_names(names);
+  BOOST_CHECK_EQUAL(names.size(), 4u);
+
+  client.send_names(makeBatch(1));
+  process();
+  client.recv_names(names);
+  BOOST_REQUIRE_EQUAL(names.size(), 1u);
+  BOOST_CHECK_EQUAL(names[0], "item0");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_processor_nested_call, Fixture) {
+  // A handler calling into the processor again gets args and a result of
+  // its own, those of the call around it are left alone
+  std::shared_ptr<TMemoryBuffer> nestedIn(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> nestedOut(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> nestedInProto(new TBinaryProtocol(nestedIn));
+  std::shared_ptr<TProtocol> nestedOutProto(new TBinaryProtocol(nestedOut));
+  ReuseServiceClient nestedClient(nestedOutProto, nestedInProto);
+  const Batch* kept = nullptr;
+  handler->nested = [&]() {
+    kept = handler->address;
+    nestedClient.send_total(makeBatch(5));
+    BOOST_CHECK(processor.process(nestedInProto, nestedOutProto, nullptr));
+    BOOST_CHECK_EQUAL(nestedClient.recv_total(), 5);
+  };
+
+  Batch outer = makeBatch(3);
+  client.send_total(outer);
+  process();
+  BOOST_CHECK_EQUAL(client.recv_total(), 3);
+  BOOST_REQUIRE_EQUAL(handler->seen.size(), 2u);
+  BOOST_CHECK(handler->seen[0] == outer);
+  BOOST_CHECK_EQUAL(handler->seen[1].items.size(), 5u);
+  BOOST_CHECK(handler->address != kept);
+
+  // The next call gets the objects kept by the thread again
+  client.send_total(makeBatch(1));
+  process();
+  BOOST_CHECK_EQUAL(client.recv_total(), 1);
+  BOOST_CHECK_EQUAL(handler->address, kept);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
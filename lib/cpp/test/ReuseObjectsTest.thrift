@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp reuse_objects_test
+
+// Generated with cpp:reuse_objects, to test ReuseObjectsTest.cpp
+struct Item
+{
+  1: i32 id,
+  2: string name = "unnamed",
+  3: optional list<i64> values,
+}
+
+struct Batch
+{
+  1: list<Item> items,
+  2: Item first = {"id": 7},
+  3: optional string tag,
+  4: map<string, i32> counts = {"a": 1},
+}
+
+exception Rejected
+{
+  1: string reason,
+}
+
+service ReuseService
+{
+  i32 total(1: Batch batch) throws (1: Rejected rejected),
+  list<string> names(1: Batch batch),
+}
@@ -0,0 +1,67 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp serialized_size_test
+
+// Generated with cpp:templates,serialized_size, to test serializedSize()
+enum Kind
+{
+  ONE = 1,
+  FIVE = 5,
+}
+
+struct Item
+{
+  1: string name,
+  2: i8 small,
+  3: i32 number,
+  4: i64 big,
+  5: double real,
+  6: uuid id,
+}
+
+struct Nesting
+{
+  1: string name,
+  2: optional list<Item> items,
+  3: list<map<set<i32>, map<Kind, set<string>>>> nested,
+  4: binary blob,
+}
+
+// The implicit id is negative, so field 15 does not get the short compact
+// field header; neither do the jumps of more than 15
+struct Gaps
+{
+  string implicit_id,
+  15: i32 fifteen,
+  40: i32 forty,
+  45: optional i32 skipped,
+  70: i32 seventy,
+}
+
+struct Bools
+{
+  1: bool yes,
+  2: bool no,
+}
+
+service SizeService
+{
+  list<string> getStrings(),
+}
@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE StringViewTest
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/StringViewTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(StringViewTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace string_view_test;
+
+static bool pointsInto(std::string_view view, const uint8_t* begin, uint32_t size) {
+  const auto* data = reinterpret_cast<const uint8_t*>(view.data());
+  return data >= begin && data + view.size() <= begin + size;
+}
+
+template <class Protocol_>
+static void testRoundTrip() {
+  const std::string name("a name that is not kept in a std::string member");
+  const std::string payload("\0\1\2binary\xff", 10);
+
+  Borrowed sent;
+  sent.__set_name(name);
+  sent.__set_payload(payload);
+  sent.__set_id(42);
+  sent.tags.push_back("tag");
+  sent.owned.__set_label("owned");
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ protocol(buffer);
+  uint32_t written = sent.write(&protocol);
+
+  uint8_t* frame;
+  uint32_t frameSize;
+  buffer->getBuffer(&frame, &frameSize);
+  BOOST_CHECK_EQUAL(written, frameSize);
+
+  Borrowed received;
+  BOOST_CHECK_EQUAL(received.read(&protocol), written);
+  BOOST_CHECK(received == sent);
+  BOOST_CHECK_EQUAL(received.name, name);
+  BOOST_CHECK_EQUAL(received.payload.size(), 10u);
+  BOOST_CHECK(!received.__isset.comment);
+  BOOST_CHECK_EQUAL(received.owned.label, "owned");
+
+  // The views borrow the frame instead of owning a copy
+  BOOST_CHECK(pointsInto(received.name, frame, frameSize));
+  BOOST_CHECK(pointsInto(received.payload, frame, frameSize));
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_round_trip) {
+  testRoundTrip<TBinaryProtocol>();
+  testRoundTrip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_optional_view) {
+  Borrowed sent;
+  sent.__set_comment(std::string_view("note"));
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocol protocol(buffer);
+  sent.write(&protocol);
+
+  Borrowed received;
+  received.read(&protocol);
+  BOOST_CHECK(received.__isset.comment);
+  BOOST_CHECK_EQUAL(received.comment, "note");
+  BOOST_CHECK(received.name.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_escaping_protocol) {
+  // Protocols that escape strings still write views, but cannot lend them back
+  Borrowed sent;
+  sent.__set_name("quoted \"name\"");
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol protocol(buffer);
+  sent.write(&protocol);
+  BOOST_CHECK(buffer->getBufferAsString().find("quoted \\\"name\\\"") != std::string::npos);
+
+  Borrowed received;
+  BOOST_CHECK_THROW(received.read(&protocol), TProtocolException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
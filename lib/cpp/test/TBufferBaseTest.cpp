@@ -519,6 +519,24 @@ BOOST_AUTO_TEST_CASE( test_FramedTransport_Write ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( test_FramedTransport_Reserve ) {
+  init_data();
+
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+  TFramedTransport trans(buffer, 16);
+
+  // Reserving in the middle of a frame keeps what was written so far.
+  trans.write(data, 10);
+  trans.reserve((1<<15) - 10);
+  trans.write(&data[10], (1<<15) - 10);
+  trans.flush();
+
+  int32_t frame_size = -1;
+  buffer->read(reinterpret_cast<uint8_t*>(&frame_size), sizeof(frame_size));
+  BOOST_CHECK_EQUAL((int32_t)ntohl((uint32_t)frame_size), 1<<15);
+  BOOST_CHECK_EQUAL(data_str, buffer->getBufferAsString());
+}
+
 BOOST_AUTO_TEST_CASE( test_FramedTransport_Read ) {
   init_data();
 
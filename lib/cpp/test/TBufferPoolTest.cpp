@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <string>
+#include <thrift/transport/TBufferPool.h>
+#include <thrift/transport/TBufferTransports.h>
+
+BOOST_AUTO_TEST_SUITE(TBufferPoolTest)
+
+using apache::thrift::transport::TBufferPool;
+using apache::thrift::transport::TMemoryBuffer;
+
+BOOST_AUTO_TEST_CASE(test_size_classes) {
+  TBufferPool pool(0, 100);
+  uint32_t capacity;
+
+  uint8_t* small = pool.allocate(10, &capacity);
+  BOOST_CHECK_EQUAL(capacity, 128u);
+  pool.release(small, capacity);
+
+  uint8_t* large = pool.allocate(1000, &capacity);
+  BOOST_CHECK_EQUAL(capacity, 1024u);
+  BOOST_CHECK_EQUAL(pool.getBytesInUse(), 1024u);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 128u);
+  pool.release(large, capacity);
+
+  // Released buffers are lent again to the next allocation of their class
+  BOOST_CHECK(pool.allocate(100, &capacity) == small);
+  BOOST_CHECK(pool.allocate(513, &capacity) == large);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 0u);
+  pool.release(small, 128);
+  pool.release(large, 1024);
+}
+
+BOOST_AUTO_TEST_CASE(test_budget) {
+  TBufferPool pool(4096, 1024);
+  uint32_t capacity;
+
+  uint8_t* first = pool.allocate(2048, &capacity);
+  uint8_t* second = pool.allocate(1024, &capacity);
+  pool.release(second, 1024);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 1024u);
+
+  // Kept buffers are freed to make room
+  uint8_t* third = pool.allocate(2048, &capacity);
+  BOOST_CHECK(third != nullptr);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 0u);
+  BOOST_CHECK_EQUAL(pool.getBytesInUse(), 4096u);
+  BOOST_CHECK_EQUAL(pool.getNumOverBudget(), 0u);
+
+  // By default the pool goes over budget, and gets back under it on release
+  uint8_t* fourth = pool.allocate(1024, &capacity);
+  BOOST_CHECK(fourth != nullptr);
+  BOOST_CHECK_EQUAL(pool.getNumOverBudget(), 1u);
+  pool.release(fourth, capacity);
+  BOOST_CHECK_EQUAL(pool.getBytesInUse(), 4096u);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 0u);
+
+  pool.setOverBudgetAction(TBufferPool::OVER_BUDGET_FAIL);
+  BOOST_CHECK(pool.allocate(1024, &capacity) == nullptr);
+  BOOST_CHECK_EQUAL(pool.getNumOverBudget(), 2u);
+
+  pool.release(first, 2048);
+  pool.release(third, 2048);
+  BOOST_CHECK_EQUAL(pool.getBytesInUse(), 0u);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 4096u);
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_buffer_round_trip) {
+  TBufferPool pool;
+  uint32_t capacity;
+  uint8_t* buffer = pool.allocate(16, &capacity);
+
+  // A memory buffer may grow a pooled buffer before it is given back
+  TMemoryBuffer memoryBuffer(nullptr, 0);
+  memoryBuffer.resetBuffer(buffer, capacity, TMemoryBuffer::TAKE_OWNERSHIP);
+  memoryBuffer.resetBuffer();
+  std::string data(1000, 'x');
+  memoryBuffer.write(reinterpret_cast<const uint8_t*>(data.data()),
+                     static_cast<uint32_t>(data.size()));
+  BOOST_CHECK_EQUAL(memoryBuffer.readAsString(1000), data);
+
+  uint32_t grown;
+  buffer = memoryBuffer.releaseBuffer(&grown);
+  BOOST_CHECK_EQUAL(grown, 1024u);
+  BOOST_CHECK_EQUAL(memoryBuffer.getBufferSize(), 0u);
+  pool.resized(capacity, grown);
+  pool.release(buffer, grown);
+  BOOST_CHECK_EQUAL(pool.getBytesInUse(), 0u);
+  BOOST_CHECK_EQUAL(pool.getBytesCached(), 1024u);
+
+  uint32_t size;
+  BOOST_CHECK(memoryBuffer.releaseBuffer(&size) == nullptr);
+  BOOST_CHECK_EQUAL(size, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,228 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TChainedBuffer.h>
+#include <thrift/transport/TSocket.h>
+
+BOOST_AUTO_TEST_SUITE(TChainedBufferTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::transport::TChainedBuffer;
+using apache::thrift::transport::TIOBuffer;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+
+namespace {
+
+// Records every writev() call made to it
+class TRecordingTransport : public TMemoryBuffer {
+public:
+  void writev(const TIOBuffer* bufs, uint32_t count) override {
+    writevCalls++;
+    TMemoryBuffer::writev(bufs, count);
+  }
+
+  int writevCalls = 0;
+};
+
+std::string readAll(TChainedBuffer& chain) {
+  std::string result(chain.size(), '\0');
+  if (!result.empty()) {
+    chain.readAll(reinterpret_cast<uint8_t*>(&result[0]), static_cast<uint32_t>(result.size()));
+  }
+  return result;
+}
+
+void write(TTransport& trans, const std::string& data) {
+  trans.write(reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+}
+
+void appendReference(TChainedBuffer& chain, const std::string& data) {
+  chain.appendReference(reinterpret_cast<const uint8_t*>(data.data()),
+                        static_cast<uint32_t>(data.size()));
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_across_blocks) {
+  TChainedBuffer chain(nullptr, 16);
+  std::string expected;
+  for (int i = 0; i < 20; i++) {
+    std::string piece(static_cast<size_t>(i), static_cast<char>('a' + i));
+    write(chain, piece);
+    expected += piece;
+  }
+  BOOST_CHECK_EQUAL(chain.size(), expected.size());
+
+  // Partial reads keep the rest of the chain
+  uint8_t head[5];
+  BOOST_CHECK_EQUAL(chain.read(head, 5), 5u);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<char*>(head), 5), expected.substr(0, 5));
+  BOOST_CHECK_EQUAL(readAll(chain), expected.substr(5));
+  BOOST_CHECK_EQUAL(chain.size(), 0u);
+
+  // The blocks are reused once everything has been read
+  write(chain, "again");
+  BOOST_CHECK_EQUAL(readAll(chain), "again");
+}
+
+BOOST_AUTO_TEST_CASE(test_references) {
+  TChainedBuffer chain;
+  std::string big(100, 'x');
+  write(chain, "head");
+  appendReference(chain, big);
+  write(chain, "tail");
+
+  std::vector<TIOBuffer> bufs;
+  chain.getBuffers(bufs);
+  BOOST_REQUIRE_EQUAL(bufs.size(), 3u);
+  BOOST_CHECK(bufs[1].data == reinterpret_cast<const uint8_t*>(big.data()));
+
+  // Referenced memory is read when the chain is, not when it is written
+  big[0] = 'y';
+  BOOST_CHECK_EQUAL(readAll(chain), "head" + big + "tail");
+
+  // write() copies whatever its size, its caller may reuse the buffer
+  std::string copied(100, 'c');
+  write(chain, copied);
+  copied[0] = 'd';
+  BOOST_CHECK_EQUAL(readAll(chain), std::string(100, 'c'));
+
+  std::shared_ptr<std::string> owned(new std::string("owned by the chain"));
+  chain.appendReference(reinterpret_cast<const uint8_t*>(owned->data()),
+                        static_cast<uint32_t>(owned->size()), owned);
+  std::weak_ptr<std::string> weak = owned;
+  owned.reset();
+  BOOST_CHECK(!weak.expired());
+  BOOST_CHECK_EQUAL(readAll(chain), "owned by the chain");
+  BOOST_CHECK(weak.expired());
+}
+
+BOOST_AUTO_TEST_CASE(test_prepend) {
+  TChainedBuffer chain(nullptr, 8);
+  write(chain, "payload that spans blocks");
+  chain.prepend(reinterpret_cast<const uint8_t*>("HDR:"), 4);
+  BOOST_CHECK_EQUAL(readAll(chain), "HDR:payload that spans blocks");
+
+  write(chain, "0123456789");
+  uint8_t skip[3];
+  chain.read(skip, 3);
+  chain.prepend(reinterpret_cast<const uint8_t*>("<"), 1);
+  BOOST_CHECK_EQUAL(readAll(chain), "<3456789");
+}
+
+BOOST_AUTO_TEST_CASE(test_protocol_round_trip) {
+  std::shared_ptr<TChainedBuffer> chain(new TChainedBuffer());
+  TBinaryProtocol proto(chain);
+  std::string blob(64 * 1024, 'b');
+  proto.writeI32(42);
+  proto.writeBinary(blob);
+  proto.writeString(std::string("short"));
+
+  int32_t i32;
+  std::string readBlob;
+  std::string readString;
+  proto.readI32(i32);
+  proto.readBinary(readBlob);
+  proto.readString(readString);
+  BOOST_CHECK_EQUAL(i32, 42);
+  BOOST_CHECK(readBlob == blob);
+  BOOST_CHECK_EQUAL(readString, "short");
+}
+
+BOOST_AUTO_TEST_CASE(test_json_round_trip) {
+  // TJSONProtocol encodes binary in chunks written from one stack buffer
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  std::shared_ptr<TChainedBuffer> chain(new TChainedBuffer(out));
+  TJSONProtocol writer(chain);
+  std::string blob;
+  for (int i = 0; i < 9000; i++) {
+    blob.push_back(static_cast<char>(i * 7));
+  }
+  writer.writeBinary(blob);
+  chain->flush();
+
+  TJSONProtocol reader(out);
+  std::string readBlob;
+  reader.readBinary(readBlob);
+  BOOST_CHECK(readBlob == blob);
+}
+
+BOOST_AUTO_TEST_CASE(test_flush_writes_once) {
+  std::shared_ptr<TRecordingTransport> out(new TRecordingTransport());
+  TChainedBuffer chain(out, 16);
+  std::string big(1000, 'z');
+  write(chain, "first");
+  appendReference(chain, big);
+  write(chain, "more than one block of copied data");
+  chain.flush();
+
+  BOOST_CHECK_EQUAL(out->writevCalls, 1);
+  BOOST_CHECK_EQUAL(out->getBufferAsString(), "first" + big + "more than one block of copied data");
+  BOOST_CHECK_EQUAL(chain.size(), 0u);
+
+  // An empty chain only flushes the underlying transport
+  chain.flush();
+  BOOST_CHECK_EQUAL(out->writevCalls, 1);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(test_socket_writev) {
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  TSocket writer(fds[0]);
+  TSocket reader(fds[1]);
+
+  // More buffers than one sendmsg() takes, some of them empty
+  std::vector<std::string> pieces;
+  std::vector<TIOBuffer> bufs;
+  std::string expected;
+  for (int i = 0; i < 200; i++) {
+    pieces.push_back(std::string(static_cast<size_t>(i % 7 == 0 ? 0 : i), static_cast<char>(i)));
+  }
+  for (const std::string& piece : pieces) {
+    TIOBuffer buf = {reinterpret_cast<const uint8_t*>(piece.data()),
+                     static_cast<uint32_t>(piece.size())};
+    bufs.push_back(buf);
+    expected += piece;
+  }
+  writer.writev(bufs.data(), static_cast<uint32_t>(bufs.size()));
+
+  std::string received(expected.size(), '\0');
+  reader.readAll(reinterpret_cast<uint8_t*>(&received[0]), static_cast<uint32_t>(received.size()));
+  BOOST_CHECK(received == expected);
+
+  writer.close();
+  reader.close();
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THeaderTransport.h>
+
+#define BOOST_TEST_MODULE THeaderTransportTest
+#include <boost/test/unit_test.hpp>
+
+using apache::thrift::transport::THeaderString;
+using apache::thrift::transport::THeaderTable;
+using apache::thrift::transport::THeaderTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+
+static std::string makePayload(uint32_t size, bool compressible) {
+  std::string payload(size, 'a');
+  uint32_t state = 12345;
+  for (uint32_t i = 0; i < size; i++) {
+    state = state * 1103515245 + 12345;
+    payload[i] = compressible ? static_cast<char>('a' + (i / 64) % 4)
+                              : static_cast<char>(state >> 16);
+  }
+  return payload;
+}
+
+static void checkRoundTrip(uint16_t transId, const std::vector<std::string>& payloads) {
+  std::shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+  THeaderTransport writer(wire);
+  THeaderTransport reader(wire);
+  writer.setTransform(transId);
+
+  // The same transport handles several messages with the same contexts
+  for (const std::string& payload : payloads) {
+    writer.write(reinterpret_cast<const uint8_t*>(payload.data()),
+                 static_cast<uint32_t>(payload.size()));
+    writer.flush();
+  }
+  for (const std::string& payload : payloads) {
+    std::string received(payload.size(), '\0');
+    reader.readAll(reinterpret_cast<uint8_t*>(&received[0]),
+                   static_cast<uint32_t>(received.size()));
+    BOOST_CHECK(received == payload);
+  }
+}
+
+static std::vector<std::string> makePayloads() {
+  std::vector<std::string> payloads;
+  payloads.push_back("x");
+  payloads.push_back(makePayload(200, true));
+  // Larger than the write buffer and not compressible at all
+  payloads.push_back(makePayload(256 * 1024, false));
+  // Expands far beyond twice its compressed size
+  payloads.push_back(makePayload(4 * 1024 * 1024, true));
+  payloads.push_back(makePayload(100, false));
+  return payloads;
+}
+
+BOOST_AUTO_TEST_CASE(test_zlib_round_trip) {
+  checkRoundTrip(THeaderTransport::ZLIB_TRANSFORM, makePayloads());
+}
+
+BOOST_AUTO_TEST_CASE(test_zstd_round_trip) {
+  if (THeaderTransport::isTransformSupported(THeaderTransport::ZSTD_TRANSFORM)) {
+    checkRoundTrip(THeaderTransport::ZSTD_TRANSFORM, makePayloads());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_lz4_round_trip) {
+  if (THeaderTransport::isTransformSupported(THeaderTransport::LZ4_TRANSFORM)) {
+    checkRoundTrip(THeaderTransport::LZ4_TRANSFORM, makePayloads());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown_transform) {
+  BOOST_CHECK(THeaderTransport::isTransformSupported(THeaderTransport::ZLIB_TRANSFORM));
+  BOOST_CHECK(!THeaderTransport::isTransformSupported(0x7f));
+
+  std::shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+  THeaderTransport writer(wire);
+  writer.setTransform(0x7f);
+  writer.write(reinterpret_cast<const uint8_t*>("abc"), 3);
+  BOOST_CHECK_THROW(writer.flush(), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_header_table) {
+  THeaderTable table;
+  THeaderString value;
+  BOOST_CHECK(table.empty());
+  BOOST_CHECK(!table.find("a", value));
+
+  // Grows past the inline entries and keeps replacing existing keys
+  for (int i = 0; i < 20; i++) {
+    table.set("key" + std::to_string(i), "value" + std::to_string(i));
+  }
+  table.set("key3", "three");
+  table.set(std::string(), std::string());
+  BOOST_CHECK_EQUAL(table.size(), 21u);
+  BOOST_CHECK(table.find("key3", value));
+  BOOST_CHECK_EQUAL(value.str(), "three");
+  BOOST_CHECK(table.find("key19", value));
+  BOOST_CHECK_EQUAL(value.str(), "value19");
+  BOOST_CHECK(table.find("", value));
+  BOOST_CHECK_EQUAL(value.size, 0u);
+  BOOST_CHECK_EQUAL(table.key(0).str(), "key0");
+
+  // A value taken from the table itself
+  BOOST_CHECK(table.find("key5", value));
+  table.set("key6", 4, value.data, value.size);
+  BOOST_CHECK(table.find("key6", value));
+  BOOST_CHECK_EQUAL(value.str(), "value5");
+
+  table.clear();
+  BOOST_CHECK(table.empty());
+  BOOST_CHECK(!table.find("key3", value));
+}
+
+BOOST_AUTO_TEST_CASE(test_info_headers) {
+  std::shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+  THeaderTransport writer(wire);
+  THeaderTransport reader(wire);
+
+  // Headers are sent with the next message only
+  writer.setHeader("trace", "1234");
+  writer.setHeader("deadline", "50ms");
+  writer.setHeader("trace", "5678");
+  writer.write(reinterpret_cast<const uint8_t*>("abc"), 3);
+  writer.flush();
+  BOOST_CHECK(writer.getWriteHeaderTable().empty());
+
+  // Through the map, and more than fit inline
+  writer.getWriteHeaders()["legacy"] = "yes";
+  std::string big(70000, 'x');
+  for (int i = 0; i < 10; i++) {
+    writer.setHeader("h" + std::to_string(i), big.substr(0, 1000));
+  }
+  writer.write(reinterpret_cast<const uint8_t*>("def"), 3);
+  writer.flush();
+
+  uint8_t buf[3];
+  THeaderString value;
+  reader.readAll(buf, 3);
+  BOOST_CHECK_EQUAL(reader.getHeaderTable().size(), 2u);
+  BOOST_CHECK(reader.getHeaderTable().find("trace", value));
+  BOOST_CHECK_EQUAL(value.str(), "5678");
+  BOOST_CHECK_EQUAL(reader.getHeaders().size(), 2u);
+  BOOST_CHECK_EQUAL(reader.getHeaders().at("deadline"), "50ms");
+
+  reader.readAll(buf, 3);
+  BOOST_CHECK_EQUAL(reader.getHeaderTable().size(), 11u);
+  BOOST_CHECK(!reader.getHeaderTable().find("trace", value));
+  BOOST_CHECK(reader.getHeaderTable().find("h9", value));
+  BOOST_CHECK_EQUAL(value.size, 1000u);
+  BOOST_CHECK_EQUAL(reader.getHeaders().size(), 11u);
+  BOOST_CHECK_EQUAL(reader.getHeaders().at("legacy"), "yes");
+
+  // More than the header section can hold
+  writer.setHeader("big", big);
+  writer.write(reinterpret_cast<const uint8_t*>("ghi"), 3);
+  BOOST_CHECK_THROW(writer.flush(), TTransportException);
+}
@@ -23,16 +23,24 @@
 #include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <map>
 #include <numeric>
+#include <set>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <vector>
 
+#include "gen-cpp/SerializedSizeTest_types.h"
 #include "gen-cpp/ThriftTest_types.h"
 
 BOOST_AUTO_TEST_SUITE(TMemoryBufferTest)
 
 using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
 using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TTransportException;
 using std::shared_ptr;
@@ -409,4 +417,119 @@ BOOST_AUTO_TEST_CASE(test_memory_buffer_to_get_sizeof_objects)
   BOOST_CHECK_EQUAL(47, size);
 }
 
+template <typename Protocol_>
+void check_binary_view_read() {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TProtocol> protocol(new Protocol_(buffer));
+
+  protocol->writeBinary("zero copy");
+  protocol->writeString("");
+
+  uint8_t* bufPtr;
+  uint32_t bufSize;
+  buffer->getBuffer(&bufPtr, &bufSize);
+
+  const uint8_t* data = nullptr;
+  uint32_t size = 0;
+  protocol->readBinaryView(data, size);
+  BOOST_CHECK_EQUAL("zero copy", string(reinterpret_cast<const char*>(data), size));
+
+  // The view points into the memory buffer instead of a copy
+  BOOST_CHECK(data >= bufPtr && data + size <= bufPtr + bufSize);
+
+  protocol->readStringView(data, size);
+  BOOST_CHECK_EQUAL(0u, size);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_view_read) {
+  check_binary_view_read<TBinaryProtocol>();
+  check_binary_view_read<TCompactProtocol>();
+}
+
+static serialized_size_test::Nesting make_nesting() {
+  serialized_size_test::Item item;
+  item.name = string(300, 'x');
+  item.small = -1;
+  item.number = INT32_MIN;
+  item.big = 5000000000LL;
+  item.real = 0.5;
+
+  serialized_size_test::Nesting crazy;
+  crazy.name = "crazy";
+  crazy.__set_items(std::vector<serialized_size_test::Item>(20, item));
+  std::map<std::set<int32_t>, std::map<serialized_size_test::Kind::type, std::set<string> > > nested;
+  nested[std::set<int32_t>{-1, 200000}][serialized_size_test::Kind::FIVE] = {"value", string(200, 'v')};
+  crazy.nested.assign(16, nested);
+  crazy.blob = string(1000, '\0');
+  return crazy;
+}
+
+template <typename Protocol_, typename Struct_>
+uint32_t check_serialized_size(const Struct_& crazy) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(1));
+  Protocol_ protocol(buffer);
+  uint32_t size = crazy.serializedSize(&protocol);
+
+  // One exact allocation, which the write then fits into.
+  buffer->reserve(size);
+  BOOST_CHECK_EQUAL(size, buffer->getBufferSize());
+  uint32_t written = crazy.write(&protocol);
+  BOOST_CHECK_EQUAL(written, buffer->available_read());
+  BOOST_CHECK_EQUAL(size, buffer->getBufferSize());
+  return size;
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size_reserve) {
+  serialized_size_test::Nesting crazy = make_nesting();
+
+  typedef apache::thrift::protocol::TBinaryProtocolT<TMemoryBuffer> BinaryProtocol;
+  typedef apache::thrift::protocol::TCompactProtocolT<TMemoryBuffer> CompactProtocol;
+  BOOST_CHECK_EQUAL(check_serialized_size<BinaryProtocol>(crazy),
+                    crazy.write(std::make_shared<TBinaryProtocol>(std::make_shared<TMemoryBuffer>()).get()));
+  BOOST_CHECK_GE(check_serialized_size<CompactProtocol>(crazy),
+                 crazy.write(std::make_shared<TCompactProtocol>(std::make_shared<TMemoryBuffer>()).get()));
+
+  // Without bools the compact size is exact, whatever the field ids
+  serialized_size_test::Gaps gaps;
+  BOOST_CHECK_EQUAL(check_serialized_size<CompactProtocol>(gaps),
+                    gaps.write(std::make_shared<TCompactProtocol>(std::make_shared<TMemoryBuffer>()).get()));
+  gaps.__set_skipped(1);
+  BOOST_CHECK_EQUAL(check_serialized_size<CompactProtocol>(gaps),
+                    gaps.write(std::make_shared<TCompactProtocol>(std::make_shared<TMemoryBuffer>()).get()));
+
+  serialized_size_test::Bools bools;
+  BOOST_CHECK_EQUAL(bools.serializedSize(std::make_shared<BinaryProtocol>(std::make_shared<TMemoryBuffer>()).get()),
+                    bools.write(std::make_shared<TBinaryProtocol>(std::make_shared<TMemoryBuffer>()).get()));
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size_virtual) {
+  serialized_size_test::Nesting crazy = make_nesting();
+
+  // Through a plain TProtocol the sizes still come from the concrete protocol
+  shared_ptr<TProtocol> binary(new TBinaryProtocol(std::make_shared<TMemoryBuffer>()));
+  BOOST_CHECK_EQUAL(crazy.serializedSize(binary.get()), crazy.write(binary.get()));
+  shared_ptr<TProtocol> compact(new TCompactProtocol(std::make_shared<TMemoryBuffer>()));
+  BOOST_CHECK_GE(crazy.serializedSize(compact.get()), crazy.write(compact.get()));
+
+  // and a protocol without known sizes reserves nothing
+  shared_ptr<TProtocol> json(new TJSONProtocol(std::make_shared<TMemoryBuffer>()));
+  BOOST_CHECK_EQUAL(crazy.serializedSize(json.get()), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_reserve) {
+  TMemoryBuffer buffer(16);
+  uint8_t data[100] = {0};
+  buffer.write(data, 10);
+  buffer.reserve(4);
+  BOOST_CHECK_EQUAL(16u, buffer.getBufferSize());
+  buffer.reserve(90);
+  BOOST_CHECK_EQUAL(100u, buffer.getBufferSize());
+  buffer.write(data, 90);
+  BOOST_CHECK_EQUAL(100u, buffer.getBufferSize());
+  BOOST_CHECK_EQUAL(100u, buffer.available_read());
+
+  TMemoryBuffer observer(data, sizeof(data));
+  BOOST_CHECK_THROW(observer.reserve(1), TTransportException);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/processor/TMultiplexedProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TMultiplexedProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+BOOST_AUTO_TEST_SUITE(TMultiplexedProcessorTest)
+
+using apache::thrift::TException;
+using apache::thrift::TMultiplexedProcessor;
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TMultiplexedProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::T_CALL;
+using apache::thrift::protocol::T_STRUCT;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+class RecordingProcessor : public TProcessor {
+public:
+  RecordingProcessor() : seqid(0), calls(0) {}
+
+  bool process(std::shared_ptr<TProtocol> in,
+               std::shared_ptr<TProtocol> out,
+               void* connectionContext) override {
+    (void)out;
+    (void)connectionContext;
+    TMessageType type;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(T_STRUCT);
+    in->readMessageEnd();
+    calls++;
+    return true;
+  }
+
+  std::string name;
+  int32_t seqid;
+  int calls;
+};
+
+void writeCall(TProtocol& proto, const std::string& name, int32_t seqid) {
+  proto.writeMessageBegin(name, T_CALL, seqid);
+  proto.writeStructBegin("args");
+  proto.writeFieldStop();
+  proto.writeStructEnd();
+  proto.writeMessageEnd();
+}
+
+struct Fixture {
+  Fixture()
+    : in(new TMemoryBuffer()),
+      out(new TMemoryBuffer()),
+      inProto(new TBinaryProtocol(in)),
+      outProto(new TBinaryProtocol(out)) {}
+
+  bool process() { return multiplexer.process(inProto, outProto, nullptr); }
+
+  std::shared_ptr<TMemoryBuffer> in;
+  std::shared_ptr<TMemoryBuffer> out;
+  std::shared_ptr<TProtocol> inProto;
+  std::shared_ptr<TProtocol> outProto;
+  TMultiplexedProcessor multiplexer;
+};
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_dispatch, Fixture) {
+  std::vector<std::shared_ptr<RecordingProcessor> > services;
+  for (int i = 0; i < 20; i++) {
+    services.push_back(std::make_shared<RecordingProcessor>());
+    multiplexer.registerProcessor("Service" + std::to_string(i), services.back());
+  }
+
+  for (int i = 0; i < 20; i++) {
+    TMultiplexedProtocol client(inProto, "Service" + std::to_string(i));
+    writeCall(client, "method" + std::to_string(i), i);
+    writeCall(client, "other", i);
+  }
+  for (int i = 0; i < 20; i++) {
+    BOOST_CHECK(process());
+    BOOST_CHECK_EQUAL(services[i]->name, "method" + std::to_string(i));
+    BOOST_CHECK_EQUAL(services[i]->seqid, i);
+    BOOST_CHECK(process());
+    BOOST_CHECK_EQUAL(services[i]->name, "other");
+    BOOST_CHECK_EQUAL(services[i]->calls, 2);
+  }
+
+  // Registering a name again replaces its processor
+  auto replacement = std::make_shared<RecordingProcessor>();
+  multiplexer.registerProcessor("Service3", replacement);
+  writeCall(*inProto, "Service3:ping", 1);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(replacement->name, "ping");
+  BOOST_CHECK_EQUAL(services[3]->calls, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_names, Fixture) {
+  auto service = std::make_shared<RecordingProcessor>();
+  auto fallback = std::make_shared<RecordingProcessor>();
+  multiplexer.registerProcessor("Calc", service);
+
+  // Empty tokens are skipped
+  writeCall(*inProto, "Calc::add:", 1);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(service->name, "add");
+
+  writeCall(*inProto, "ping", 2);
+  BOOST_CHECK_THROW(process(), TException);
+
+  multiplexer.registerDefault(fallback);
+  writeCall(*inProto, ":ping", 3);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(fallback->name, "ping");
+
+  writeCall(*inProto, "Calcu:add", 4);
+  BOOST_CHECK_THROW(process(), TException);
+  writeCall(*inProto, "Calc:add:more", 5);
+  BOOST_CHECK_THROW(process(), TException);
+  BOOST_CHECK_EQUAL(service->calls, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
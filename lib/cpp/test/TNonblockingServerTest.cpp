@@ -19,14 +19,21 @@
 
 #define BOOST_TEST_MODULE TNonblockingServerTest
 #include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <thread>
+#include <sys/socket.h>
 
 #include "thrift/concurrency/Monitor.h"
 #include "thrift/concurrency/Thread.h"
+#include "thrift/concurrency/ThreadManager.h"
+#include "thrift/protocol/TBinaryProtocol.h"
 #include "thrift/server/TNonblockingServer.h"
 #include "thrift/transport/TNonblockingServerSocket.h"
 
 #include "gen-cpp/ParentService.h"
+#include "gen-cpp/SizeService.h"
 
 #include <event.h>
 
@@ -37,6 +44,7 @@ using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::Thread;
 using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::server::TServerEventHandler;
 using std::make_shared;
 using std::shared_ptr;
@@ -57,11 +65,26 @@ struct Handler : public test::ParentServiceIf {
   void unexpectedExceptionWait(const std::string&) override {}
 };
 
+struct SizeHandler : public serialized_size_test::SizeServiceIf {
+  void getStrings(std::vector<std::string>& _return) override {
+    _return.assign(8, std::string(300, 'x'));
+  }
+};
+
+struct SleepingHandler : public Handler {
+  // keeps a worker busy for length milliseconds
+  void getDataWait(std::string& _return, const int32_t length) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(length));
+    _return = "done";
+  }
+};
+
 class Fixture {
 private:
   struct ListenEventHandler : public TServerEventHandler {
     public:
-      ListenEventHandler(Mutex* mutex) : listenMonitor_(mutex), ready_(false) {}
+      ListenEventHandler(Mutex* mutex)
+        : listenMonitor_(mutex), ready_(false), specializedProtocols_(false) {}
 
       void preServe() override /* override */ {
         Guard g(listenMonitor_.mutex());
@@ -69,21 +92,45 @@ private:
         listenMonitor_.notify();
       }
 
+      void* createContext(shared_ptr<protocol::TProtocol> input,
+                          shared_ptr<protocol::TProtocol> output) override {
+        typedef protocol::TBinaryProtocolT<transport::TMemoryBuffer> SpecializedProtocol;
+        specializedProtocols_ = dynamic_cast<SpecializedProtocol*>(input.get())
+                                && dynamic_cast<SpecializedProtocol*>(output.get());
+        return nullptr;
+      }
+
       Monitor listenMonitor_;
       bool ready_;
+      bool specializedProtocols_;
   };
 
   struct Runner : public Runnable {
     int port;
     shared_ptr<event_base> userEventBase;
     shared_ptr<TProcessor> processor;
+    shared_ptr<ThreadManager> threadManager;
     shared_ptr<server::TNonblockingServer> server;
     shared_ptr<ListenEventHandler> listenHandler;
     shared_ptr<transport::TNonblockingServerSocket> socket;
+    bool specializeProtocols;
+    uint32_t zeroCopyThreshold;
+    size_t numIOThreads;
+    bool reusePort;
+    shared_ptr<server::TIOThreadSelector> ioThreadSelector;
+    size_t pipelineDepth;
+    shared_ptr<transport::TBufferPool> bufferPool;
+    size_t connectionStackLimit;
     Mutex mutex_;
 
     Runner() {
       port = 0;
+      specializeProtocols = false;
+      zeroCopyThreshold = 0;
+      numIOThreads = 1;
+      reusePort = false;
+      pipelineDepth = 1;
+      connectionStackLimit = 0;
       listenHandler.reset(new ListenEventHandler(&mutex_));
     }
 
@@ -106,6 +153,19 @@ private:
         socket.reset(new transport::TNonblockingServerSocket(port));
         server.reset(new server::TNonblockingServer(processor, socket));
         server->setServerEventHandler(listenHandler);
+        server->setSpecializeProtocols(specializeProtocols);
+        server->setZeroCopyThreshold(zeroCopyThreshold);
+        server->setNumIOThreads(numIOThreads);
+        server->setReusePort(reusePort);
+        server->setIOThreadSelector(ioThreadSelector);
+        server->setPipelineDepth(pipelineDepth);
+        server->setBufferPool(bufferPool);
+        if (connectionStackLimit) {
+          server->setConnectionStackLimit(connectionStackLimit);
+        }
+        if (threadManager) {
+          server->setThreadManager(threadManager);
+        }
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -126,7 +186,14 @@ private:
   };
 
 protected:
-  Fixture() : processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
+  Fixture()
+    : processor(new test::ParentServiceProcessor(make_shared<Handler>())),
+      specializeProtocols(false),
+      zeroCopyThreshold(0),
+      numIOThreads(1),
+      reusePort(false),
+      pipelineDepth(1),
+      connectionStackLimit(0) {}
 
   ~Fixture() {
     if (server) {
@@ -145,7 +212,16 @@ protected:
     shared_ptr<Runner> runner(new Runner);
     runner->port = port;
     runner->processor = processor;
+    runner->threadManager = threadManager;
     runner->userEventBase = userEventBase_;
+    runner->specializeProtocols = specializeProtocols;
+    runner->zeroCopyThreshold = zeroCopyThreshold;
+    runner->numIOThreads = numIOThreads;
+    runner->reusePort = reusePort;
+    runner->ioThreadSelector = ioThreadSelector;
+    runner->pipelineDepth = pipelineDepth;
+    runner->bufferPool = bufferPool;
+    runner->connectionStackLimit = connectionStackLimit;
 
     shared_ptr<ThreadFactory> threadFactory(
         new ThreadFactory(false));
@@ -154,6 +230,7 @@ protected:
     runner->readyBarrier();
 
     server = runner->server;
+    listenHandler = runner->listenHandler;
     return runner->port;
   }
 
@@ -170,8 +247,18 @@ protected:
 
 private:
   shared_ptr<event_base> userEventBase_;
-  shared_ptr<test::ParentServiceProcessor> processor;
 protected:
+  shared_ptr<TProcessor> processor;
+  shared_ptr<ThreadManager> threadManager;
+  bool specializeProtocols;
+  uint32_t zeroCopyThreshold;
+  size_t numIOThreads;
+  bool reusePort;
+  shared_ptr<server::TIOThreadSelector> ioThreadSelector;
+  size_t pipelineDepth;
+  shared_ptr<transport::TBufferPool> bufferPool;
+  size_t connectionStackLimit;
+  shared_ptr<ListenEventHandler> listenHandler;
   shared_ptr<server::TNonblockingServer> server;
 private:
   shared_ptr<apache::thrift::concurrency::Thread> thread;
@@ -212,4 +299,333 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(specialized_protocols, Fixture) {
+  typedef protocol::TBinaryProtocolT<transport::TMemoryBuffer> SpecializedProtocol;
+  processor.reset(new test::ParentServiceProcessorT<SpecializedProtocol>(make_shared<Handler>()));
+  specializeProtocols = true;
+  startServer(0);
+
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+  BOOST_CHECK(listenHandler->specializedProtocols_);
+}
+
+BOOST_AUTO_TEST_CASE(specialized_processor_reserves_reply) {
+  typedef protocol::TBinaryProtocolT<transport::TMemoryBuffer> SpecializedProtocol;
+  serialized_size_test::SizeServiceProcessorT<SpecializedProtocol> proc(
+      make_shared<SizeHandler>());
+
+  auto input = make_shared<transport::TMemoryBuffer>();
+  serialized_size_test::SizeServiceClientT<SpecializedProtocol> client(
+      make_shared<SpecializedProtocol>(input));
+  client.send_getStrings();
+
+  // a one byte buffer grows to exactly the reserved reply size, not to
+  // the next power of two
+  auto output = make_shared<transport::TMemoryBuffer>(1);
+  BOOST_CHECK(proc.process(make_shared<SpecializedProtocol>(input),
+                           make_shared<SpecializedProtocol>(output), nullptr));
+  BOOST_CHECK_GT(output->available_read(), 2400u);
+  BOOST_CHECK_EQUAL(output->getBufferSize(), output->available_read());
+}
+
+BOOST_FIXTURE_TEST_CASE(default_protocols, Fixture) {
+  startServer(0);
+
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+  BOOST_CHECK(!listenHandler->specializedProtocols_);
+}
+
+BOOST_FIXTURE_TEST_CASE(worker_threads, Fixture) {
+  threadManager = ThreadManager::newSimpleThreadManager(4);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_REQUIRE(canCommunicate(port));
+
+  // Several workers finish tasks at once and queue their connections for
+  // the IO thread in batches
+  std::vector<std::shared_ptr<std::thread>> clients;
+  std::atomic<int> failures(0);
+  for (int i = 0; i < 8; i++) {
+    clients.push_back(std::make_shared<std::thread>([port, &failures] {
+      shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+      socket->open();
+      test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+          make_shared<transport::TFramedTransport>(socket)));
+      for (int j = 0; j < 200; j++) {
+        std::vector<std::string> strings;
+        client.getStrings(strings);
+        if (strings.size() != 1 || strings[0] != "foo") {
+          ++failures;
+        }
+      }
+    }));
+  }
+  for (auto& client : clients) {
+    client->join();
+  }
+  BOOST_CHECK_EQUAL(failures.load(), 0);
+
+  server->stop();
+  threadManager->stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(reuse_port_listeners, Fixture) {
+  numIOThreads = 4;
+  reusePort = true;
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_REQUIRE(canCommunicate(port));
+
+  // Whichever IO thread's listener the kernel picks serves the connection
+  for (int i = 0; i < 32; i++) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    std::vector<std::string> strings;
+    client.getStrings(strings);
+    BOOST_CHECK(strings.size() == 1 && strings[0] == "foo");
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(least_connections_selector, Fixture) {
+  numIOThreads = 4;
+  ioThreadSelector = make_shared<server::TLeastConnectionsIOThreadSelector>();
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_REQUIRE(canCommunicate(port));
+
+  // canCommunicate()'s connection may not have been closed yet, so open
+  // enough connections to fill every thread up past it
+  std::vector<shared_ptr<test::ParentServiceClient> > clients;
+  for (int i = 0; i < 8; i++) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    clients.push_back(make_shared<test::ParentServiceClient>(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket))));
+    std::vector<std::string> strings;
+    clients.back()->getStrings(strings);
+  }
+
+  size_t connections = 0;
+  for (const auto& ioThread : server->getIOThreads()) {
+    BOOST_CHECK_GE(ioThread->getNumConnections(), 2u);
+    BOOST_CHECK_LE(ioThread->getNumConnections(), 3u);
+    BOOST_CHECK_GT(ioThread->getNumRequests(), 0u);
+    BOOST_CHECK_GT(ioThread->getNumBytesRead(), 0u);
+    BOOST_CHECK_GT(ioThread->getNumBytesWritten(), 0u);
+    connections += ioThread->getNumConnections();
+  }
+  BOOST_CHECK_GE(connections, 8u);
+}
+
+BOOST_FIXTURE_TEST_CASE(pipelined_requests, Fixture) {
+  processor.reset(new test::ParentServiceProcessor(make_shared<SleepingHandler>()));
+  threadManager = ThreadManager::newSimpleThreadManager(4);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  pipelineDepth = 16;
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_REQUIRE(canCommunicate(port));
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+  socket->open();
+  test::ParentServiceConcurrentClient client(
+      make_shared<protocol::TBinaryProtocol>(make_shared<transport::TFramedTransport>(socket)),
+      make_shared<async::TConcurrentClientSyncInfo>());
+
+  // A slow call does not hold up the calls sent after it on the same
+  // connection, their responses overtake its one
+  std::atomic<bool> slowDone(false);
+  std::thread slow([&client, &slowDone] {
+    std::string data;
+    client.getDataWait(data, 1000);
+    slowDone = data == "done";
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::vector<std::shared_ptr<std::thread>> clients;
+  std::atomic<int> failures(0);
+  for (int i = 0; i < 4; i++) {
+    clients.push_back(std::make_shared<std::thread>([&client, &failures] {
+      for (int j = 0; j < 50; j++) {
+        std::vector<std::string> strings;
+        client.getStrings(strings);
+        if (strings.size() != 1 || strings[0] != "foo") {
+          ++failures;
+        }
+      }
+    }));
+  }
+  for (auto& client : clients) {
+    client->join();
+  }
+  BOOST_CHECK(!slowDone);
+  BOOST_CHECK_EQUAL(failures.load(), 0);
+
+  slow.join();
+  BOOST_CHECK(slowDone);
+
+  server->stop();
+  threadManager->stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(pipelined_half_close, Fixture) {
+  processor.reset(new test::ParentServiceProcessor(make_shared<SleepingHandler>()));
+  threadManager = ThreadManager::newSimpleThreadManager(4);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  pipelineDepth = 16;
+  startServer(0);
+
+  shared_ptr<transport::TSocket> socket(
+      new transport::TSocket("localhost", server->getListenPort()));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+
+  // The client is done sending while its requests are still running; the
+  // server answers all of them before it closes the connection
+  for (int i = 0; i < 3; i++) {
+    client.send_getDataWait(200);
+  }
+  BOOST_REQUIRE_EQUAL(::shutdown(socket->getSocketFD(), SHUT_WR), 0);
+  for (int i = 0; i < 3; i++) {
+    std::string data;
+    client.recv_getDataWait(data);
+    BOOST_CHECK_EQUAL(data, "done");
+  }
+  BOOST_CHECK(!socket->peek());
+
+  server->stop();
+  threadManager->stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(zero_copy_responses, Fixture) {
+  zeroCopyThreshold = 64 * 1024;
+  startServer(0);
+
+  shared_ptr<transport::TSocket> socket(
+      new transport::TSocket("localhost", server->getListenPort()));
+  socket->setZeroCopyThreshold(zeroCopyThreshold);
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+
+  // Each response is pinned until the kernel is done with it, while the
+  // connection goes on serving the next requests
+  std::vector<std::string> expected;
+  for (int i = 0; i < 4; i++) {
+    expected.push_back(std::string(256 * 1024, static_cast<char>('a' + i)));
+    client.addString(expected.back());
+    std::vector<std::string> strings;
+    client.getStrings(strings);
+    BOOST_CHECK(strings == expected);
+  }
+  // write() always copies, it never leaves the caller's data pinned
+  BOOST_CHECK_EQUAL(socket->getZeroCopyPending(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(zero_copy_close_while_sending, Fixture) {
+  zeroCopyThreshold = 64 * 1024;
+  startServer(0);
+  int port = server->getListenPort();
+
+  // The clients go away while their large responses are being sent; the
+  // server keeps the buffers until the kernel lets go of them
+  for (int i = 0; i < 4; i++) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    client.addString(std::string(1024 * 1024, 'z'));
+    client.send_getStrings();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    socket->close();
+  }
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+  client.addString("foo");
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 5u);
+  BOOST_CHECK_EQUAL(strings.back(), "foo");
+}
+
+BOOST_FIXTURE_TEST_CASE(pooled_buffers, Fixture) {
+  bufferPool = make_shared<transport::TBufferPool>(1024 * 1024);
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_REQUIRE(canCommunicate(port));
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+
+  // Frames larger than the buffers kept so far borrow a larger class, and
+  // the connection gives everything back between calls
+  std::string large(64 * 1024, 'x');
+  client.addString(large);
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 2u);
+  BOOST_CHECK(strings[1] == large);
+
+  // The write buffer goes back just after the response is sent
+  for (int i = 0; i < 100 && bufferPool->getBytesInUse() > 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_CHECK_EQUAL(bufferPool->getBytesInUse(), 0u);
+  BOOST_CHECK_GT(bufferPool->getBytesCached(), 0u);
+
+  // Over budget, the connection that needs a buffer is closed
+  bufferPool->setOverBudgetAction(transport::TBufferPool::OVER_BUDGET_FAIL);
+  std::string tooLarge(2 * 1024 * 1024, 'y');
+  BOOST_CHECK_THROW(client.addString(tooLarge), transport::TTransportException);
+  BOOST_CHECK_GT(bufferPool->getNumOverBudget(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(pooled_buffers_refused_connection_deleted, Fixture) {
+  bufferPool = make_shared<transport::TBufferPool>(64 * 1024);
+  bufferPool->setOverBudgetAction(transport::TBufferPool::OVER_BUDGET_FAIL);
+  connectionStackLimit = 1;
+  startServer(0);
+  int port = server->getListenPort();
+
+  // Fill the connection stack, so that the next connection closed is
+  // deleted rather than kept
+  shared_ptr<transport::TSocket> idle(new transport::TSocket("localhost", port));
+  idle->open();
+  test::ParentServiceClient idleClient(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(idle)));
+  std::vector<std::string> strings;
+  idleClient.getStrings(strings);
+  idle->close();
+  for (int i = 0; i < 100 && server->getNumIdleConnections() < 1; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_REQUIRE_EQUAL(server->getNumIdleConnections(), 1u);
+
+  // A frame the pool refuses to buffer closes, and deletes, the connection
+  // while it is reading
+  for (int i = 0; i < 4; i++) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    BOOST_CHECK_THROW(client.addString(std::string(256 * 1024, 'x')),
+                      transport::TTransportException);
+  }
+
+  BOOST_CHECK_GT(bufferPool->getNumOverBudget(), 0u);
+  BOOST_CHECK(canCommunicate(port));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -33,6 +33,7 @@
 #include <thrift/server/TNonblockingServer.h>
 #include <thrift/server/TSimpleServer.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TNonblockingServerSocket.h>
 
 #include "EventLog.h"
@@ -851,6 +852,71 @@ void testUnexpectedError() {
   checkNoEvents(log);
 }
 
+bool isUnknownMethod(const TApplicationException& x) {
+  return x.getType() == TApplicationException::UNKNOWN_METHOD;
+}
+
+/**
+ * Test the generated dispatchCall() without a server: the child's own
+ * methods, the fallback to the parent's, and names that neither knows.
+ */
+template <typename TemplateTraits>
+void testDispatch() {
+  typedef typename TemplateTraits::Protocol Protocol;
+  std::shared_ptr<TMemoryBuffer> requests(new TMemoryBuffer);
+  std::shared_ptr<TMemoryBuffer> replies(new TMemoryBuffer);
+  std::shared_ptr<Protocol> requestProtocol(new Protocol(requests));
+  std::shared_ptr<Protocol> replyProtocol(new Protocol(replies));
+
+  std::shared_ptr<ChildHandler> handler(new ChildHandler(std::make_shared<EventLog>()));
+  typename TemplateTraits::ChildProcessor processor(handler);
+  typename TemplateTraits::ChildClient client(replyProtocol, requestProtocol);
+
+  // setValue and getValue have the same length and differ in the first byte
+  client.send_setValue(7);
+  BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+  BOOST_CHECK_EQUAL(client.recv_setValue(), 0);
+  client.send_getValue();
+  BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+  BOOST_CHECK_EQUAL(client.recv_getValue(), 7);
+
+  // Parent methods are found through the parent's dispatchCall()
+  client.send_incrementGeneration();
+  BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+  BOOST_CHECK_EQUAL(client.recv_incrementGeneration(), 1);
+  client.send_addString("parent");
+  BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+  client.recv_addString();
+  client.send_getStrings();
+  BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+  vector<string> strings;
+  client.recv_getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 1u);
+
+  // Unknown names: one of a child method's length, one of a parent
+  // method's length, one of no known length and the empty name
+  const char* unknown[] = {"getValux", "getGenerathon", "noSuchMethod", ""};
+  for (const char* name : unknown) {
+    requestProtocol->writeMessageBegin(name, T_CALL, 0);
+    requestProtocol->writeStructBegin("args");
+    requestProtocol->writeFieldStop();
+    requestProtocol->writeStructEnd();
+    requestProtocol->writeMessageEnd();
+    BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr));
+    BOOST_CHECK_EXCEPTION(client.recv_getValue(), TApplicationException, isUnknownMethod);
+  }
+  BOOST_CHECK_EQUAL(requests->available_read(), 0u);
+  BOOST_CHECK_EQUAL(replies->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(Templated_dispatch) {
+  testDispatch<TemplatedTraits>();
+}
+
+BOOST_AUTO_TEST_CASE(Untemplated_dispatch) {
+  testDispatch<UntemplatedTraits>();
+}
+
 // Macro to define simple tests that can be used with all server types
 #define DEFINE_SIMPLE_TESTS(Server, Template)                                                      \
   BOOST_AUTO_TEST_CASE(Server##_##Template##_basicService) {                                       \
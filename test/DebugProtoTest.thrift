@@ -393,3 +393,12 @@ struct TupleProtocolTestStruct {
 struct ListDoublePerf {
   1: list<double> field;
 }
+
+struct ListStringPerf {
+  1: list<string> field;
+}
+
+struct LazyNesting {
+  1: Bonk my_bonk,
+  2: OneOfEach my_ooe (cpp.lazy = "1"),
+}